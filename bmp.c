@@ -15,6 +15,861 @@
 #include "utils.h"
 #include "bmp.h"
 
+// Block buffer for bulk reads of the pixel data section
+static unsigned char bmp_read_buffer[BMP_READ_BUFFER_SIZE];
+static unsigned int bmp_read_pos;	// Next unread byte in the block buffer
+static unsigned int bmp_read_len;	// Number of valid bytes in the block buffer
+
+// A single decoded row, for rows which need clipping or are decoded out of order
+static unsigned char bmp_row_buffer[BMP_ROW_BUFFER_SIZE];
+
+// Preallocated decode buffers, handed out by bmp_PoolAcquire()
+static unsigned char bmp_pool[BMP_POOL_BUFFERS][BMP_POOL_BUFFER_SIZE];
+static unsigned char bmp_pool_used[BMP_POOL_BUFFERS];
+
+// Palette remap and pixel expansion tables, rebuilt for each image that is decoded
+static unsigned char	bmp_remap[256];		// Colour table index to new palette entry
+static unsigned char	bmp_remap_identity;	// Set if bmp_remap[] does not change any pixels
+static unsigned short	bmp_expand4[256];	// One byte of 4bpp pixels to two remapped 8bpp pixels
+static unsigned int	bmp_expand1[256][2];	// One byte of 1bpp pixels to eight remapped 8bpp pixels
+
+// Fixed palette and inverse colour table for quantizing 16bpp and 24bpp images
+static unsigned char	bmp_quant_lut[32768];	// 5-5-5 RGB to fixed palette entry
+static unsigned char	bmp_quant_ready;		// Set once bmp_quant_lut[] has been built
+static unsigned char	bmp_dither = 1;		// Use ordered dithering when quantizing
+static int			bmp_max_colours = BMP_MAX_COLOURS;	// Colour tables larger than this are reduced
+static int			bmp_dither_r[16];		// Per-channel dither offsets for each position of the 4x4 matrix
+static int			bmp_dither_g[16];
+static int			bmp_dither_b[16];
+static unsigned char	*bmp_used;			// If set, marked with every pixel value written to the destination surface
+static const unsigned char bmp_bayer[16] = {
+	0,	8,	2,	10,
+	12,	4,	14,	6,
+	3,	11,	1,	9,
+	15,	7,	13,	5
+};
+
+static void bmp_BuildRemap(bmpdata_t *bmpdata){
+	// Build the remap and expansion tables for the colour table of bmpdata,
+	// so that pixels are written to the pixel buffer already pointing at
+	// their new palette entries.
+	//
+	// Tables are stored as they will be laid out in (little-endian) memory; 
+	// the leftmost pixel of each source byte is in the lowest output byte.
+	
+	int i, j;
+	unsigned int lo, hi;
+	
+	bmp_remap_identity = 1;
+	for (i = 0; i < 256; i++){
+		if (i < bmpdata->colours){
+			bmp_remap[i] = bmpdata->palette[i].new_palette_entry;
+		} else {
+			bmp_remap[i] = i;
+		}
+		if (bmp_remap[i] != i){
+			bmp_remap_identity = 0;
+		}
+	}
+	
+	if (bmpdata->bpp == BMP_4BPP){
+		for (i = 0; i < 256; i++){
+			bmp_expand4[i] = bmp_remap[i >> 4] | (bmp_remap[i & 0x0F] << 8);
+		}
+	}
+	
+	if (bmpdata->bpp == BMP_1BPP){
+		for (i = 0; i < 256; i++){
+			lo = 0;
+			hi = 0;
+			for (j = 0; j < 4; j++){
+				lo |= bmp_remap[(i >> (7 - j)) & 0x01] << (j * 8);
+				hi |= bmp_remap[(i >> (3 - j)) & 0x01] << (j * 8);
+			}
+			bmp_expand1[i][0] = lo;
+			bmp_expand1[i][1] = hi;
+		}
+	}
+}
+
+static void bmp_BuildQuant(){
+	// Build the inverse colour table which maps every 5-5-5 RGB value 
+	// to the nearest entry of the fixed quantizer palette.
+	//
+	// The fixed palette is a 6x8x4 RGB colour cube followed by a ramp of greys;
+	// the nearest cube entry can be found directly for each channel, so only 
+	// the cube and grey candidates need comparing, rather than all entries.
+	
+	int c, i;
+	int r, g, b;
+	int cr, cg, cb;
+	int grey;
+	int dr, dg, db;
+	int cube_err, grey_err;
+	
+	if (bmp_quant_ready){
+		return;
+	}
+	
+	for (c = 0; c < 32768; c++){
+		r = (c >> 10) & 0x1F;
+		g = (c >> 5) & 0x1F;
+		b = c & 0x1F;
+		r = (r << 3) | (r >> 2);
+		g = (g << 3) | (g >> 2);
+		b = (b << 3) | (b >> 2);
+		
+		// Nearest colour cube entry
+		cr = ((r * (BMP_QUANT_R_LEVELS - 1)) + 127) / 255;
+		cg = ((g * (BMP_QUANT_G_LEVELS - 1)) + 127) / 255;
+		cb = ((b * (BMP_QUANT_B_LEVELS - 1)) + 127) / 255;
+		dr = r - ((cr * 255) / (BMP_QUANT_R_LEVELS - 1));
+		dg = g - ((cg * 255) / (BMP_QUANT_G_LEVELS - 1));
+		db = b - ((cb * 255) / (BMP_QUANT_B_LEVELS - 1));
+		cube_err = (dr * dr) + (dg * dg) + (db * db);
+		
+		// Nearest grey entry
+		grey = (((r + g + b) / 3) * (BMP_QUANT_GREYS - 1) + 127) / 255;
+		dr = r - ((grey * 255) / (BMP_QUANT_GREYS - 1));
+		dg = g - ((grey * 255) / (BMP_QUANT_GREYS - 1));
+		db = b - ((grey * 255) / (BMP_QUANT_GREYS - 1));
+		grey_err = (dr * dr) + (dg * dg) + (db * db);
+		
+		if (grey_err < cube_err){
+			bmp_quant_lut[c] = BMP_QUANT_CUBE_SIZE + grey;
+		} else {
+			bmp_quant_lut[c] = (((cr * BMP_QUANT_G_LEVELS) + cg) * BMP_QUANT_B_LEVELS) + cb;
+		}
+	}
+	
+	// Dither offsets span one step of the colour cube in each channel
+	for (i = 0; i < 16; i++){
+		bmp_dither_r[i] = (((2 * bmp_bayer[i]) - 15) * (255 / (BMP_QUANT_R_LEVELS - 1))) / 32;
+		bmp_dither_g[i] = (((2 * bmp_bayer[i]) - 15) * (255 / (BMP_QUANT_G_LEVELS - 1))) / 32;
+		bmp_dither_b[i] = (((2 * bmp_bayer[i]) - 15) * (255 / (BMP_QUANT_B_LEVELS - 1))) / 32;
+	}
+	bmp_quant_ready = 1;
+}
+
+static void bmp_QuantPalette(bmpdata_t *bmpdata){
+	// Fill the palette of a 16bpp or 24bpp image with the fixed quantizer palette
+	
+	int i;
+	int r, g, b;
+	
+	i = 0;
+	for (r = 0; r < BMP_QUANT_R_LEVELS; r++){
+		for (g = 0; g < BMP_QUANT_G_LEVELS; g++){
+			for (b = 0; b < BMP_QUANT_B_LEVELS; b++){
+				bmpdata->palette[i].r = (r * 255) / (BMP_QUANT_R_LEVELS - 1);
+				bmpdata->palette[i].g = (g * 255) / (BMP_QUANT_G_LEVELS - 1);
+				bmpdata->palette[i].b = (b * 255) / (BMP_QUANT_B_LEVELS - 1);
+				bmpdata->palette[i].new_palette_entry = i;
+				i++;
+			}
+		}
+	}
+	for (g = 0; g < BMP_QUANT_GREYS; g++){
+		bmpdata->palette[i].r = (g * 255) / (BMP_QUANT_GREYS - 1);
+		bmpdata->palette[i].g = bmpdata->palette[i].r;
+		bmpdata->palette[i].b = bmpdata->palette[i].r;
+		bmpdata->palette[i].new_palette_entry = i;
+		i++;
+	}
+	bmpdata->colours = BMP_QUANT_COLOURS;
+}
+
+static pal_entry_t *bmp_cut_palette;	// Colour table being sorted by bmp_CutCompare()
+static int bmp_cut_axis;			// Channel being sorted on; 0 = r, 1 = g, 2 = b
+
+static int bmp_CutChannel(pal_entry_t *entry, int axis){
+	
+	if (axis == 0){
+		return entry->r;
+	}
+	if (axis == 1){
+		return entry->g;
+	}
+	return entry->b;
+}
+
+static int bmp_CutCompare(const void *a, const void *b){
+	// qsort() comparison of two colour table indices, on one channel
+	
+	return bmp_CutChannel(&bmp_cut_palette[*(unsigned char *) a], bmp_cut_axis) - bmp_CutChannel(&bmp_cut_palette[*(unsigned char *) b], bmp_cut_axis);
+}
+
+static void bmp_CutRange(bmpdata_t *bmpdata, unsigned char *order, int count, unsigned char *axis, unsigned char *range){
+	// Find the channel with the widest range of values in one box of colours
+	
+	int lo[3], hi[3];
+	int i, k, c;
+	
+	lo[0] = lo[1] = lo[2] = 255;
+	hi[0] = hi[1] = hi[2] = 0;
+	for (i = 0; i < count; i++){
+		for (k = 0; k < 3; k++){
+			c = bmp_CutChannel(&bmpdata->palette[order[i]], k);
+			if (c < lo[k]){
+				lo[k] = c;
+			}
+			if (c > hi[k]){
+				hi[k] = c;
+			}
+		}
+	}
+	*axis = 0;
+	*range = 0;
+	for (k = 0; k < 3; k++){
+		if ((hi[k] - lo[k]) > *range){
+			*axis = k;
+			*range = hi[k] - lo[k];
+		}
+	}
+}
+
+static void bmp_ReducePalette(bmpdata_t *bmpdata, int max_colours){
+	// Reduce the colour table of an indexed image to at most max_colours, by median cut.
+	//
+	// The colour table is split into boxes, always splitting the box with the 
+	// widest range on any one channel at its median, until there are enough boxes
+	// (or no box has more than one colour). Every colour table entry is then 
+	// pointed at the nearest of the box averages, and given that colour, so 
+	// the pixels are remapped by bmp_BuildRemap() as they are decoded.
+	
+	unsigned char	order[256];			// Colour table indices, grouped by box
+	unsigned short	box_start[256];		// First index in order[] of each box
+	unsigned short	box_count[256];		// Number of entries in each box
+	unsigned char	box_axis[256];		// Widest channel of each box
+	unsigned char	box_range[256];		// and its range of values
+	unsigned char	reduced[256][3];		// Average colour of each box
+	int			boxes;
+	int			i, j, k;
+	int			best;
+	int			sum[3];
+	int			d, dr, dg, db, best_d;
+	
+	for (i = 0; i < bmpdata->colours; i++){
+		order[i] = i;
+	}
+	box_start[0] = 0;
+	box_count[0] = bmpdata->colours;
+	bmp_CutRange(bmpdata, order, box_count[0], &box_axis[0], &box_range[0]);
+	boxes = 1;
+	
+	while (boxes < max_colours){
+		// Find the box with the widest channel
+		best = 0;
+		for (i = 1; i < boxes; i++){
+			if (box_range[i] > box_range[best]){
+				best = i;
+			}
+		}
+		if (box_range[best] == 0){
+			// Every box is a single colour
+			break;
+		}
+		
+		// Sort it on that channel and split it in two at the median
+		bmp_cut_palette = bmpdata->palette;
+		bmp_cut_axis = box_axis[best];
+		qsort(&order[box_start[best]], box_count[best], 1, bmp_CutCompare);
+		box_start[boxes] = box_start[best] + (box_count[best] / 2);
+		box_count[boxes] = box_count[best] - (box_count[best] / 2);
+		box_count[best] = box_count[best] / 2;
+		bmp_CutRange(bmpdata, &order[box_start[best]], box_count[best], &box_axis[best], &box_range[best]);
+		bmp_CutRange(bmpdata, &order[box_start[boxes]], box_count[boxes], &box_axis[boxes], &box_range[boxes]);
+		boxes++;
+	}
+	
+	for (i = 0; i < boxes; i++){
+		sum[0] = sum[1] = sum[2] = 0;
+		for (j = box_start[i]; j < (box_start[i] + box_count[i]); j++){
+			sum[0] += bmpdata->palette[order[j]].r;
+			sum[1] += bmpdata->palette[order[j]].g;
+			sum[2] += bmpdata->palette[order[j]].b;
+		}
+		for (k = 0; k < 3; k++){
+			reduced[i][k] = (sum[k] + (box_count[i] / 2)) / box_count[i];
+		}
+	}
+	
+	// Nearest reduced colour for each colour table entry
+	for (i = 0; i < bmpdata->colours; i++){
+		best = 0;
+		best_d = (3 * 255 * 255) + 1;
+		for (j = 0; j < boxes; j++){
+			dr = bmpdata->palette[i].r - reduced[j][0];
+			dg = bmpdata->palette[i].g - reduced[j][1];
+			db = bmpdata->palette[i].b - reduced[j][2];
+			d = (dr * dr) + (dg * dg) + (db * db);
+			if (d < best_d){
+				best = j;
+				best_d = d;
+			}
+		}
+		bmpdata->palette[i].new_palette_entry = best;
+	}
+	for (i = 0; i < bmpdata->colours; i++){
+		j = bmpdata->palette[i].new_palette_entry;
+		bmpdata->palette[i].r = reduced[j][0];
+		bmpdata->palette[i].g = reduced[j][1];
+		bmpdata->palette[i].b = reduced[j][2];
+	}
+	
+	if (BMP_VERBOSE){
+		printf("%s.%d\t Reduced %d colour table entries to %d colours\n", __FILE__, __LINE__, bmpdata->colours, boxes);
+	}
+}
+
+static unsigned char bmp_DitherPixel(int r, int g, int b, int d){
+	// Quantize one 8-8-8 RGB pixel, offset by position 'd' of the dither matrix
+	
+	r += bmp_dither_r[d];
+	g += bmp_dither_g[d];
+	b += bmp_dither_b[d];
+	if (r < 0) r = 0; else if (r > 255) r = 255;
+	if (g < 0) g = 0; else if (g > 255) g = 255;
+	if (b < 0) b = 0; else if (b > 255) b = 255;
+	return bmp_quant_lut[((r >> 3) << 10) | ((g >> 3) << 5) | (b >> 3)];
+}
+
+static void bmp_Expand8(unsigned char *src, unsigned char *dst, unsigned int width){
+	// Copy one row of 8bpp pixels, remapping them to their new palette entries
+	
+	if (bmp_remap_identity){
+		memcpy(dst, src, width);
+	} else {
+		while (width--){
+			*dst++ = bmp_remap[*src++];
+		}
+	}
+}
+
+static void bmp_Expand4(unsigned char *src, unsigned char *dst, unsigned int width){
+	// Unpack one row of 4bpp pixels to remapped 8bpp pixels, one source byte at a time
+	
+	unsigned int i;
+	
+	for (i = width >> 1; i > 0; i--){
+		memcpy(dst, &bmp_expand4[*src++], 2);
+		dst += 2;
+	}
+	// Odd width; the last pixel is in the high nibble
+	if (width & 0x01){
+		*dst = bmp_remap[*src >> 4];
+	}
+}
+
+static void bmp_Expand1(unsigned char *src, unsigned char *dst, unsigned int width){
+	// Unpack one row of 1bpp pixels to remapped 8bpp pixels, one source byte at a time
+	
+	unsigned int i;
+	unsigned char b;
+	
+	for (i = width >> 3; i > 0; i--){
+		memcpy(dst, bmp_expand1[*src], 8);
+		src++;
+		dst += 8;
+	}
+	// Any remaining pixels come from the high bits of the last byte
+	if (width & 0x07){
+		b = *src;
+		for (i = width & 0x07; i > 0; i--){
+			*dst++ = bmp_remap[b >> 7];
+			b <<= 1;
+		}
+	}
+}
+
+static void bmp_Expand16(unsigned char *src, unsigned char *dst, unsigned int width, unsigned int row, unsigned char rgb565){
+	// Quantize one row of 5-5-5 (or 5-6-5) 16bpp pixels to the fixed palette
+	
+	unsigned int i;
+	unsigned int p;
+	unsigned char *d;
+	int r, g, b;
+	
+	d = dst;
+	if (bmp_dither){
+		row = (row & 0x03) << 2;
+		for (i = 0; i < width; i++){
+			p = src[0] | (src[1] << 8);
+			if (rgb565){
+				r = (p >> 11) & 0x1F;
+				g = (p >> 5) & 0x3F;
+				g = (g << 2) | (g >> 4);
+			} else {
+				r = (p >> 10) & 0x1F;
+				g = (p >> 5) & 0x1F;
+				g = (g << 3) | (g >> 2);
+			}
+			b = p & 0x1F;
+			*d++ = bmp_DitherPixel((r << 3) | (r >> 2), g, (b << 3) | (b >> 2), row | (i & 0x03));
+			src += 2;
+		}
+	} else if (rgb565){
+		for (i = width; i > 0; i--){
+			p = src[0] | (src[1] << 8);
+			*d++ = bmp_quant_lut[((p >> 1) & 0x7FE0) | (p & 0x1F)];
+			src += 2;
+		}
+	} else {
+		for (i = width; i > 0; i--){
+			*d++ = bmp_quant_lut[(src[0] | (src[1] << 8)) & 0x7FFF];
+			src += 2;
+		}
+	}
+	if (!bmp_remap_identity){
+		for (i = width; i > 0; i--){
+			*dst = bmp_remap[*dst];
+			dst++;
+		}
+	}
+}
+
+static void bmp_Expand24(unsigned char *src, unsigned char *dst, unsigned int width, unsigned int row){
+	// Quantize one row of 24bpp (stored as b,g,r) pixels to the fixed palette
+	
+	unsigned int i;
+	unsigned char *d;
+	
+	d = dst;
+	if (bmp_dither){
+		row = (row & 0x03) << 2;
+		for (i = 0; i < width; i++){
+			*d++ = bmp_DitherPixel(src[2], src[1], src[0], row | (i & 0x03));
+			src += 3;
+		}
+	} else {
+		for (i = width; i > 0; i--){
+			*d++ = bmp_quant_lut[((src[2] >> 3) << 10) | ((src[1] >> 3) << 5) | (src[0] >> 3)];
+			src += 3;
+		}
+	}
+	if (!bmp_remap_identity){
+		for (i = width; i > 0; i--){
+			*dst = bmp_remap[*dst];
+			dst++;
+		}
+	}
+}
+
+static int bmp_ReadByte(FILE *bmp_image){
+	// Return the next byte of the data section, refilling the block buffer
+	// from the file as needed. Returns -1 at the end of the file.
+	
+	if (bmp_read_pos >= bmp_read_len){
+		bmp_read_len = fread(bmp_read_buffer, 1, BMP_READ_BUFFER_SIZE, bmp_image);
+		bmp_read_pos = 0;
+		if (bmp_read_len < 1){
+			return -1;
+		}
+	}
+	return bmp_read_buffer[bmp_read_pos++];
+}
+
+static int bmp_ScaledWidth(bmpdata_t *bmpdata, bmpdest_t *dest){
+	// Width of the image once written to a destination surface
+	
+	if (dest->scale > 1){
+		return bmpdata->width / dest->scale;
+	}
+	return bmpdata->width;
+}
+
+static int bmp_RowVisible(bmpdest_t *dest, unsigned int row){
+	// Is a (scaled) row of the image within the vertical clip of the destination
+	
+	return (((dest->y + (int) row) >= dest->clip_y1) && ((dest->y + (int) row) <= dest->clip_y2));
+}
+
+static void bmp_MarkUsed(unsigned char *src, int width, int step){
+	// Note the values of 'width' pixels written to the destination surface, 
+	// taking every 'step'th pixel of src
+	
+	int x;
+	
+	for (x = 0; x < width; x++){
+		bmp_used[*src] = 1;
+		src += step;
+	}
+}
+
+static void bmp_PutRow(bmpdata_t *bmpdata, bmpdest_t *dest, unsigned int row, unsigned char *src){
+	// Copy one row of decoded 8bpp pixels to the destination surface, 
+	// clipped to the destination clip rectangle.
+	// 'row' is the row number of the image, counting down from the top.
+	//
+	// When the destination is scaled down, only every n'th row and 
+	// every n'th pixel of those rows is written (nearest neighbour).
+	
+	unsigned char	*dst;
+	int y;
+	int x1, x2;
+	int scale;
+	
+	scale = dest->scale;
+	if (scale > 1){
+		// Any leftover rows past a whole multiple of the scale are dropped
+		if (((row % scale) != 0) || (row >= ((bmpdata->height / scale) * scale))){
+			return;
+		}
+		row = row / scale;
+	} else {
+		scale = 1;
+	}
+	
+	y = dest->y + row;
+	if ((y < dest->clip_y1) || (y > dest->clip_y2)){
+		return;
+	}
+	
+	x1 = dest->x;
+	x2 = dest->x + bmp_ScaledWidth(bmpdata, dest) - 1;
+	if (x1 < dest->clip_x1){
+		src += (dest->clip_x1 - x1) * scale;
+		x1 = dest->clip_x1;
+	}
+	if (x2 > dest->clip_x2){
+		x2 = dest->clip_x2;
+	}
+	if (x2 < x1){
+		return;
+	}
+	if (bmp_used != NULL){
+		bmp_MarkUsed(src, (x2 - x1) + 1, scale);
+	}
+	dst = dest->buffer + (y * dest->pitch) + x1;
+	if (scale > 1){
+		for (; x1 <= x2; x1++){
+			*dst++ = *src;
+			src += scale;
+		}
+	} else {
+		memcpy(dst, src, (x2 - x1) + 1);
+	}
+}
+
+static unsigned int bmp_RLENextRows(bmpdata_t *bmpdata, bmpdest_t *dest, unsigned char *row, unsigned int y, unsigned int rows){
+	// Write out the RLE row being decoded and move down 'rows' lines. 
+	// Any whole lines passed over on the way are written as colour 0, and
+	// the row buffer is left cleared to colour 0 for the next line.
+	// Returns the new line number.
+	
+	unsigned int i;
+	
+	if (y < bmpdata->height){
+		bmp_PutRow(bmpdata, dest, bmpdata->height - 1 - y, row);
+	}
+	memset(row, bmp_remap[0], bmpdata->width);
+	for (i = 1; (i < rows) && ((y + i) < bmpdata->height); i++){
+		bmp_PutRow(bmpdata, dest, bmpdata->height - 1 - (y + i), row);
+	}
+	return y + rows;
+}
+
+static int bmp_ReadRLE(FILE *bmp_image, bmpdata_t *bmpdata, bmpdest_t *dest){
+	// Decode an RLE8 or RLE4 compressed data section onto a destination surface.
+	// The file must already be positioned at the start of the data section, and 
+	// the remap table must already have been built for this image.
+	//
+	// Each line is decoded into the row buffer and written out once it is complete.
+	// Pixels skipped by a delta or early end-of-line escape, and any lines skipped
+	// by a delta or left after an early end-of-bitmap, are written as colour 0.
+	
+	unsigned char	*row;		// The row buffer
+	unsigned int	x, y;		// Position of the next pixel to be decoded
+	int			count;		// Run length, or zero for an escape
+	int			value;		// Run colour(s), or the escape code
+	int			dx, dy;		// Delta escape offsets
+	int			pixel;		// A single decoded pixel
+	int			i;
+	
+	bmp_read_pos = 0;
+	bmp_read_len = 0;
+	
+	x = 0;
+	y = 0;
+	pixel = 0;
+	row = bmp_row_buffer;
+	memset(row, bmp_remap[0], bmpdata->width);
+	
+	// Compressed images are always stored bottom-up, so y counts up from the 
+	// last row of the image
+	while (y < bmpdata->height){
+		count = bmp_ReadByte(bmp_image);
+		value = bmp_ReadByte(bmp_image);
+		if (value < 0){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Unexpected end of RLE data at row %d\n", __FILE__, __LINE__, y);
+			}
+			return BMP_ERR_READ;
+		}
+		
+		if (count > 0){
+			// Encoded run of 'count' pixels
+			if ((x + count) > bmpdata->width){
+				// Runs spilling off the right hand edge are clipped
+				if (x < bmpdata->width){
+					count = bmpdata->width - x;
+				} else {
+					count = 0;
+				}
+			}
+			if (bmpdata->compressed == BMP_RLE8){
+				memset(row + x, bmp_remap[value], count);
+			} else {
+				// RLE4 runs alternate between the high and low nibble
+				for (i = 0; i < count; i++){
+					if (i & 0x01){
+						row[x + i] = bmp_remap[value & 0x0F];
+					} else {
+						row[x + i] = bmp_remap[value >> 4];
+					}
+				}
+			}
+			x += count;
+			
+		} else if (value == BMP_RLE_EOL){
+			y = bmp_RLENextRows(bmpdata, dest, row, y, 1);
+			x = 0;
+			
+		} else if (value == BMP_RLE_EOB){
+			// The rest of the image is left as colour 0
+			bmp_RLENextRows(bmpdata, dest, row, y, bmpdata->height - y);
+			return BMP_OK;
+			
+		} else if (value == BMP_RLE_DELTA){
+			dx = bmp_ReadByte(bmp_image);
+			dy = bmp_ReadByte(bmp_image);
+			if (dy < 0){
+				return BMP_ERR_READ;
+			}
+			if (dy > 0){
+				y = bmp_RLENextRows(bmpdata, dest, row, y, dy);
+			}
+			x += dx;
+			
+		} else {
+			// Absolute mode; 'value' literal pixels follow, padded to a 16bit boundary
+			if (bmpdata->compressed == BMP_RLE8){
+				for (i = 0; i < value; i++){
+					pixel = bmp_ReadByte(bmp_image);
+					if (pixel < 0){
+						return BMP_ERR_READ;
+					}
+					if (x < bmpdata->width){
+						row[x] = bmp_remap[pixel];
+					}
+					x++;
+				}
+				count = value;
+			} else {
+				for (i = 0; i < value; i++){
+					if ((i & 0x01) == 0){
+						pixel = bmp_ReadByte(bmp_image);
+						if (pixel < 0){
+							return BMP_ERR_READ;
+						}
+					}
+					if (x < bmpdata->width){
+						if (i & 0x01){
+							row[x] = bmp_remap[pixel & 0x0F];
+						} else {
+							row[x] = bmp_remap[pixel >> 4];
+						}
+					}
+					x++;
+				}
+				count = (value + 1) >> 1;
+			}
+			// Skip the padding byte after an odd number of data bytes
+			if (count & 0x01){
+				bmp_ReadByte(bmp_image);
+			}
+		}
+	}
+	// Some encoders stop at the last end-of-line, without an end-of-bitmap
+	return BMP_OK;
+}
+
+static int bmp_ReadPixels(FILE *bmp_image, bmpdata_t *bmpdata, bmpdest_t *dest){
+	// Decode the pixel data section of an image onto a destination surface.
+	// The header (and palette, for indexed images) must already have been read.
+	
+	unsigned char	*block_ptr;		// Represents which row of the read block we are decoding
+	unsigned char	*dest_ptr;		// Represents where the decoded row is written
+	unsigned char	clipped;		// Set if rows must be clipped horizontally
+	unsigned char	visible;		// Set if the current row is written to the surface
+	unsigned int	row;			// Row number of the image, from the top
+	int			i;				// A loop counter
+	int			rows_per_block;	// Number of padded rows which fit in the read block buffer
+	int			rows_remaining;	// Number of rows still to be read from the file
+	int			rows;			// Number of rows in the current block
+	int			status;
+	
+	if (bmpdata->width > BMP_ROW_BUFFER_SIZE){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Image width of %d is larger than the row buffer\n", __FILE__, __LINE__, bmpdata->width);
+		}
+		return BMP_ERR_SIZE;
+	}
+	
+	// Pixels are remapped to any new palette entries as they are decoded
+	bmp_BuildRemap(bmpdata);
+	if (bmpdata->bpp > BMP_8BPP){
+		bmp_BuildQuant();
+	}
+	
+	// Seek to start of data section in file
+	status = fseek(bmp_image, bmpdata->offset, SEEK_SET);
+	if (status != 0){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Error seeking to data section\n", __FILE__, __LINE__);
+		}
+		return BMP_ERR_READ;
+	}
+	
+	if ((bmpdata->compressed == BMP_RLE8) || (bmpdata->compressed == BMP_RLE4)){
+		// Compressed images are decoded in a single pass, straight from the file
+		return bmp_ReadRLE(bmp_image, bmpdata, dest);
+	}
+	
+	// Rows are read in blocks of as many padded rows as will fit in the read buffer, 
+	// rather than an fread (and fseek over the padding) for every single row
+	rows_per_block = BMP_READ_BUFFER_SIZE / bmpdata->row_padded;
+	if (rows_per_block < 1){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Padded row size of %d bytes is larger than the read buffer\n", __FILE__, __LINE__, bmpdata->row_padded);
+		}
+		return BMP_ERR_SIZE;
+	}
+	
+	// Rows which are only partly on the destination surface, or which are
+	// scaled down, are decoded via the row buffer; all others are decoded
+	// straight onto the surface
+	if ((dest->scale > 1) || (dest->x < dest->clip_x1) || ((dest->x + bmp_ScaledWidth(bmpdata, dest) - 1) > dest->clip_x2)){
+		clipped = 1;
+	} else {
+		clipped = 0;
+	}
+	
+	if (BMP_VERBOSE){
+		printf("%s.%d\t Reading %d rows per %d byte block\n", __FILE__, __LINE__, rows_per_block, BMP_READ_BUFFER_SIZE);
+	}
+	
+	// For every block of rows in the image...
+	rows_remaining = bmpdata->height;
+	while (rows_remaining > 0){
+		
+		if (rows_remaining < rows_per_block){
+			rows = rows_remaining;
+		} else {
+			rows = rows_per_block;
+		}
+		
+		status = fread(bmp_read_buffer, 1, rows * bmpdata->row_padded, bmp_image);
+		// Some encoders leave the padding off the very last row, so only the pixels themselves must be present
+		if (status < (((rows - 1) * bmpdata->row_padded) + bmpdata->row_unpadded)){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error reading file at pos %u\n", __FILE__, __LINE__, (unsigned int) ftell(bmp_image));
+				printf("%s.%d\t Error reading %d bytes, got %d\n", __FILE__, __LINE__, rows * bmpdata->row_padded, status);
+			}
+			return BMP_ERR_READ;	
+		}
+		
+		// Expand each row, minus its padding, into place on the destination surface
+		block_ptr = bmp_read_buffer;
+		for (i = 0; i < rows; i++){
+			
+			// Rows are stored bottom to top, unless the header said otherwise
+			if (bmpdata->top_down){
+				row = bmpdata->height - rows_remaining;
+			} else {
+				row = rows_remaining - 1;
+			}
+			
+			// Rows outside of the clip rectangle, or dropped by scaling, are never expanded
+			if (dest->scale > 1){
+				if (((row % dest->scale) != 0) || (row >= ((bmpdata->height / dest->scale) * dest->scale))){
+					visible = 0;
+				} else {
+					visible = bmp_RowVisible(dest, row / dest->scale);
+				}
+			} else {
+				visible = bmp_RowVisible(dest, row);
+			}
+			if (visible){
+				if (clipped){
+					dest_ptr = bmp_row_buffer;
+				} else {
+					dest_ptr = dest->buffer + ((dest->y + row) * dest->pitch) + dest->x;
+				}
+				if (bmpdata->bpp == BMP_8BPP){
+					bmp_Expand8(block_ptr, dest_ptr, bmpdata->width);
+				} else if (bmpdata->bpp == BMP_4BPP){
+					bmp_Expand4(block_ptr, dest_ptr, bmpdata->width);
+				} else if (bmpdata->bpp == BMP_16BPP){
+					bmp_Expand16(block_ptr, dest_ptr, bmpdata->width, row, bmpdata->rgb565);
+				} else if (bmpdata->bpp == BMP_24BPP){
+					bmp_Expand24(block_ptr, dest_ptr, bmpdata->width, row);
+				} else {
+					bmp_Expand1(block_ptr, dest_ptr, bmpdata->width);
+				}
+				if (clipped){
+					bmp_PutRow(bmpdata, dest, row, bmp_row_buffer);
+				} else if (bmp_used != NULL){
+					bmp_MarkUsed(dest_ptr, bmpdata->width, 1);
+				}
+			}
+			block_ptr += bmpdata->row_padded;
+			rows_remaining--;
+		}
+	}
+	return BMP_OK;
+}
+
+static void bmp_FreePixels(bmpdata_t *bmpdata){
+	// Free the pixel buffer of an image, or hand it back to the pool
+	
+	if (bmpdata->pixels != NULL){
+		if (bmpdata->pooled){
+			bmp_PoolRelease(bmpdata->pixels);
+		} else {
+			free(bmpdata->pixels);
+		}
+	}
+	bmpdata->pixels = NULL;
+	bmpdata->pooled = 0;
+}
+
+static int bmp_DecodePixels(FILE *bmp_image, bmpdata_t *bmpdata){
+	// Decode the pixel data into the image's own pixel buffer, 
+	// as a surface of exactly the same size as the image
+	
+	bmpdest_t	dest;
+	int			status;
+	
+	dest.buffer = bmpdata->pixels;
+	dest.pitch = bmpdata->width;
+	dest.x = 0;
+	dest.y = 0;
+	dest.clip_x1 = 0;
+	dest.clip_y1 = 0;
+	dest.clip_x2 = bmpdata->width - 1;
+	dest.clip_y2 = bmpdata->height - 1;
+	dest.scale = 1;
+	status = bmp_ReadPixels(bmp_image, bmpdata, &dest);
+	if (status != BMP_OK){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Error decoding pixel data\n", __FILE__, __LINE__);
+		}
+		bmp_FreePixels(bmpdata);
+	}
+	return status;
+}
+
 int bmp_ReadImage(FILE *bmp_image, bmpdata_t *bmpdata, unsigned char header, unsigned char palette, unsigned char data){
 	/* 
 		bmp_image 	== open file handle to your bmp file
@@ -35,11 +890,11 @@ int bmp_ReadImage(FILE *bmp_image, bmpdata_t *bmpdata, unsigned char header, uns
 		fclose(f);
 	*/
 	
-	unsigned char	*bmp_ptr, *bmp_ptr_old;	// Represents which row of pixels we are reading at any time
 	int 				i;			// A loop counter
 	int				status;		// Generic status for calls from fread/fseek etc.
 	unsigned char 	pixel;		// A single pixel
 	unsigned char	r,g,b,a;
+	unsigned int	masks[3];	// Red, green and blue bitfields of 16bpp images
 
 	if (header){
 		// Seek to dataoffset position in header
@@ -47,460 +902,975 @@ int bmp_ReadImage(FILE *bmp_image, bmpdata_t *bmpdata, unsigned char header, uns
 		status = fseek(bmp_image, DATA_OFFSET_OFFSET, SEEK_SET);
 		if (status != 0){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error seeking data offset in header\n", __FILE__, __LINE__);
+				printf("%s.%d\t Error seeking data offset in header\n", __FILE__, __LINE__);
+			}
+			return BMP_ERR_READ;
+		}
+		// Read data offset value
+		status = fread(&bmpdata->offset, 4, 1, bmp_image);
+		if (status < 1){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error reading %d records at data offset header pos, got %d\n", __FILE__, __LINE__, 4, status);
+			}
+			return BMP_ERR_READ;
+		}
+		
+		// Seek to DIB header size field
+		status = fseek(bmp_image, DIB_HEADER_OFFSET, SEEK_SET);
+		if (status != 0){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error seeking DIB header in header\n", __FILE__, __LINE__);
+			}
+			return BMP_ERR_READ;
+		}
+		// Read size value
+		status = fread(&bmpdata->dib_size, 4, 1, bmp_image);
+		if (status < 1){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error reading %d records at DIB header pos, got %d\n", __FILE__, __LINE__, 4, status);
+			}
+			return BMP_ERR_READ;
+		}
+		bmpdata->colours_offset = DIB_HEADER_OFFSET + bmpdata->dib_size;
+		
+		// Seek to image width/columns position in header
+		status = fseek(bmp_image, WIDTH_OFFSET, SEEK_SET);
+		if (status != 0){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error seeking width in header\n", __FILE__, __LINE__);
+			}
+			return BMP_ERR_READ;
+		}
+		// Read width value
+		status = fread(&bmpdata->width, 4, 1, bmp_image);
+		if (status < 1){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error reading %d records at image width header pos, got %d\n", __FILE__, __LINE__, 4, status);
+			}
+			return BMP_ERR_READ;
+		}
+		
+		// Seek to image height/rows position in header
+		status = fseek(bmp_image, HEIGHT_OFFSET, SEEK_SET);
+		if (status != 0){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error seeking height in header\n", __FILE__, __LINE__);
+			}
+			return BMP_ERR_READ;
+		}
+		// Read height value
+		status = fread(&bmpdata->height, 4, 1, bmp_image);
+		if (status < 1){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error reading %d records at image height header pos, got %d\n", __FILE__, __LINE__, 4, status);
+			}
+			return BMP_ERR_READ;
+		}
+		// A negative height means the rows are stored top to bottom
+		if ((int) bmpdata->height < 0){
+			bmpdata->height = (unsigned int) (0 - (int) bmpdata->height);
+			bmpdata->top_down = 1;
+		} else {
+			bmpdata->top_down = 0;
+		}
+		
+		// Seek to bpp location in header
+		status = fseek(bmp_image, BITS_PER_PIXEL_OFFSET, SEEK_SET);
+		if (status != 0){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error seeking bpp in header\n", __FILE__, __LINE__);
+			}
+			return BMP_ERR_READ;
+		}
+		// Read bpp value
+		status = fread(&bmpdata->bpp, 2, 1, bmp_image);
+		if (status < 1){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error reading %d records at bpp header pos, got %d\n", __FILE__, __LINE__, 2, status);
+			}
+			return BMP_ERR_READ;
+		}
+		if ((bmpdata->bpp != BMP_4BPP) && (bmpdata->bpp != BMP_8BPP) && (bmpdata->bpp != BMP_16BPP) && (bmpdata->bpp != BMP_24BPP) && (bmpdata->bpp != BMP_1BPP)){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Unsupported pixel depth of %dbpp\n", __FILE__, __LINE__, bmpdata->bpp);
+				printf("%s.%d\t The supported pixel depths are %d, %d, %d, %d and %d\n", __FILE__, __LINE__, BMP_1BPP, BMP_4BPP, BMP_8BPP, BMP_16BPP, BMP_24BPP);
+			}
+			return BMP_ERR_BPP;
+		}
+		// High colour images have no colour table; they are quantized to a fixed palette
+		if (bmpdata->bpp > BMP_8BPP){
+			bmpdata->is_indexed = 0;
+		} else {
+			bmpdata->is_indexed = 1;
+		}
+		
+		// Seek to colour count field
+		status = fseek(bmp_image, COLOUR_NUM_OFFSET, SEEK_SET);
+		if (status != 0){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error seeking compression field in header\n", __FILE__, __LINE__);
+			}
+			return BMP_ERR_READ;
+		}
+		// Read colour count
+		status = fread(&bmpdata->colours, sizeof(bmpdata->colours), 1, bmp_image);
+		if (status < 1){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error reading %d records at colour count type header pos, got %d\n", __FILE__, __LINE__, 4, status);
+			}
+			return BMP_ERR_READ;
+		}
+		
+		// Seek to compression field
+		status = fseek(bmp_image, COMPRESS_OFFSET, SEEK_SET);
+		if (status != 0){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error seeking compression field in header\n", __FILE__, __LINE__);
+			}
+			return BMP_ERR_READ;
+		}		
+		// Read compression value
+		status = fread(&bmpdata->compressed, sizeof(bmpdata->compressed), 1, bmp_image);
+		if (status < 1){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Error reading %d records at compression type header pos, got %d\n", __FILE__, __LINE__, 4, status);
 			}
 			return BMP_ERR_READ;
 		}
-		// Read data offset value
-		status = fread(&bmpdata->offset, 4, 1, bmp_image);
-		if (status < 1){
+		if (
+			(bmpdata->compressed != BMP_UNCOMPRESSED) &&
+			!((bmpdata->compressed == BMP_RLE8) && (bmpdata->bpp == BMP_8BPP)) &&
+			!((bmpdata->compressed == BMP_RLE4) && (bmpdata->bpp == BMP_4BPP)) &&
+			!((bmpdata->compressed == BMP_BITFIELDS) && (bmpdata->bpp == BMP_16BPP))
+		){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error reading %d records at data offset header pos, got %d\n", __FILE__, __LINE__, 4, status);
+				printf("%s.%d\t Unsupported compressed BMP format (type %d at %dbpp)\n", __FILE__, __LINE__, bmpdata->compressed, bmpdata->bpp);
 			}
-			return BMP_ERR_READ;
+			return BMP_ERR_COMPRESSED;
 		}
 		
-		// Seek to DIB header size field
-		status = fseek(bmp_image, DIB_HEADER_OFFSET, SEEK_SET);
-		if (status != 0){
+		// 16bpp pixels are 5-5-5, unless bitfields say they are 5-6-5
+		bmpdata->rgb565 = 0;
+		if (bmpdata->compressed == BMP_BITFIELDS){
+			status = fseek(bmp_image, BITFIELDS_OFFSET, SEEK_SET);
+			if (status != 0){
+				if (BMP_VERBOSE){
+					printf("%s.%d\t Error seeking bitfields in header\n", __FILE__, __LINE__);
+				}
+				return BMP_ERR_READ;
+			}
+			status = fread(masks, 4, 3, bmp_image);
+			if (status < 3){
+				if (BMP_VERBOSE){
+					printf("%s.%d\t Error reading %d records at bitfields header pos, got %d\n", __FILE__, __LINE__, 3, status);
+				}
+				return BMP_ERR_READ;
+			}
+			if ((masks[0] == 0xF800) && (masks[1] == 0x07E0) && (masks[2] == 0x001F)){
+				bmpdata->rgb565 = 1;
+			} else if ((masks[0] != 0x7C00) || (masks[1] != 0x03E0) || (masks[2] != 0x001F)){
+				if (BMP_VERBOSE){
+					printf("%s.%d\t Unsupported bitfields (r:%x g:%x b:%x)\n", __FILE__, __LINE__, masks[0], masks[1], masks[2]);
+				}
+				return BMP_ERR_COMPRESSED;
+			}
+		}
+				
+		// Rows are stored bottom-up
+		// Each row is padded to be a multiple of 4 bytes. 
+		// We calculate the padded row size in bytes, from the number of bits in a row
+		bmpdata->row_padded = (((bmpdata->width * bmpdata->bpp) + 31) >> 5) << 2;
+		bmpdata->row_unpadded = ((bmpdata->width * bmpdata->bpp) + 7) >> 3;
+		bmpdata->n_pixels = bmpdata->width * bmpdata->height;
+		
+		// All images are expanded, or quantized, to one byte per pixel
+		bmpdata->bytespp = 1;
+		if (bmpdata->bpp > BMP_8BPP){
+			bmpdata->colours = BMP_QUANT_COLOURS;
+		} else if (bmpdata->colours == 0){
+			// Many tools write 0 for a full colour table
+			bmpdata->colours = 1 << bmpdata->bpp;
+		} else if (bmpdata->colours > 256){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error seeking DIB header in header\n", __FILE__, __LINE__);
+				printf("%s.%d\t Colour table of %d entries is too large\n", __FILE__, __LINE__, bmpdata->colours);
 			}
-			return BMP_ERR_READ;
+			return BMP_ERR_COLOURS;
 		}
-		// Read size value
-		status = fread(&bmpdata->dib_size, 4, 1, bmp_image);
-		if (status < 1){
+		bmpdata->size = bmpdata->n_pixels * bmpdata->bytespp;
+		
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Bitmap header loaded ok!\n", __FILE__, __LINE__);
+			printf("%s.%d\t Info - DIB header size: %d\n", __FILE__, __LINE__, bmpdata->dib_size);
+			printf("%s.%d\t Info - Resolution: %dx%d\n", __FILE__, __LINE__, bmpdata->width, bmpdata->height);
+			printf("%s.%d\t Info - Padded row size: %d bytes\n", __FILE__, __LINE__, bmpdata->row_padded);
+			printf("%s.%d\t Info - Unpadded row size: %d bytes\n", __FILE__, __LINE__, bmpdata->row_unpadded);
+			printf("%s.%d\t Info - Colour depth: %dbpp\n", __FILE__, __LINE__, bmpdata->bpp);
+			printf("%s.%d\t Info - Colour count: %d\n", __FILE__, __LINE__, bmpdata->colours);
+			printf("%s.%d\t Info - Colour table @ %x\n", __FILE__, __LINE__, bmpdata->colours_offset);
+			printf("%s.%d\t Info - Storage size: %d bytes\n", __FILE__, __LINE__, bmpdata->size);
+			printf("%s.%d\t Info - Pixel data @ %x\n", __FILE__, __LINE__, (unsigned int) &bmpdata->pixels);
+		}
+	}
+	
+	// =============================
+	//
+	// Read, and possibly remap colour table palette entries
+	//
+	// =============================
+	
+	if (palette){
+		// First verify if we've actually read the header section and know where the colour table is...
+		if (bmpdata->colours_offset <= 0){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error reading %d records at DIB header pos, got %d\n", __FILE__, __LINE__, 4, status);
+				printf("%s.%d\t Colour table offset not found or null, unable to seek to colour table\n", __FILE__, __LINE__);
 			}
 			return BMP_ERR_READ;
 		}
-		bmpdata->colours_offset = DIB_HEADER_OFFSET + bmpdata->dib_size;
 		
-		// Seek to image width/columns position in header
-		status = fseek(bmp_image, WIDTH_OFFSET, SEEK_SET);
-		if (status != 0){
+		if (bmpdata->bpp > BMP_8BPP){
+			bmp_QuantPalette(bmpdata);
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error seeking width in header\n", __FILE__, __LINE__);
+				printf("%s.%d\t Using fixed %d colour palette for %dbpp image\n", __FILE__, __LINE__, bmpdata->colours, bmpdata->bpp);
+			}
+			
+			// Some of the free palette region may be in use for other things
+			if (bmpdata->colours > bmp_max_colours){
+				bmp_ReducePalette(bmpdata, bmp_max_colours);
+			}
+		} else {
+			for(i = 0; i < bmpdata->colours; i++){
+				status = fseek(bmp_image, bmpdata->colours_offset + (i * 4), SEEK_SET);
+				if (status != 0){
+					if (BMP_VERBOSE){
+						printf("%s.%d\t Error seeking to palette %d\n", __FILE__, __LINE__, i);
+					}
+					return BMP_ERR_READ;
+				}
+				status = fread(&b, 1, 1, bmp_image);
+				if (status < 1){
+					if (BMP_VERBOSE){
+						printf("%s.%d\t Error reading file at pos %u for palette %d, Red\n", __FILE__, __LINE__, (unsigned int) ftell(bmp_image), i);
+					}
+					return BMP_ERR_READ;
+				}
+				status = fread(&g, 1, 1, bmp_image);
+				if (status < 1){
+					if (BMP_VERBOSE){
+						printf("%s.%d\t Error reading file at pos %u for palette %d, Red\n", __FILE__, __LINE__, (unsigned int) ftell(bmp_image), i);
+					}
+					return BMP_ERR_READ;
+				}
+				status = fread(&r, 1, 1, bmp_image);
+				if (status < 1){
+					if (BMP_VERBOSE){
+						printf("%s.%d\t Error reading file at pos %u for palette %d, Red\n", __FILE__, __LINE__, (unsigned int) ftell(bmp_image), i);
+					}
+					return BMP_ERR_READ;
+				}
+				//if (BMP_VERBOSE){
+				//	printf("%s.%d\t Palette entry %d @ %d [r:%d, g:%d, b:%d]\n", __FILE__, __LINE__, i,  bmpdata->colours_offset + (i * 4), r, g, b);
+				//}
+				// NOw assign those values to the palette table in the bmpdata structure
+				bmpdata->palette[i].r = r;
+				bmpdata->palette[i].g = g;
+				bmpdata->palette[i].b = b;
+				bmpdata->palette[i].new_palette_entry = i;
+			}
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Extracted %d palette entries ok!\n", __FILE__, __LINE__, bmpdata->colours);
+			}
+			
+			// More colours than there are palette entries for artwork
+			if (bmpdata->colours > bmp_max_colours){
+				bmp_ReducePalette(bmpdata, bmp_max_colours);
 			}
-			return BMP_ERR_READ;
 		}
-		// Read width value
-		status = fread(&bmpdata->width, 4, 1, bmp_image);
-		if (status < 1){
+	}
+	
+	// ==============================
+	//
+	// Read and return pixel data
+	//
+	// ==============================
+	
+	if (data){
+	
+		// First verify if we've actually read the header section...
+		if (bmpdata->offset <= 0){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error reading %d records at image width header pos, got %d\n", __FILE__, __LINE__, 4, status);
+				printf("%s.%d\t Data offset not found or null, unable to seek to data section\n", __FILE__, __LINE__);
 			}
 			return BMP_ERR_READ;
 		}
 		
-		// Seek to image height/rows position in header
-		status = fseek(bmp_image, HEIGHT_OFFSET, SEEK_SET);
+		// Don't leak the pixels of any image previously decoded with this structure
+		bmp_FreePixels(bmpdata);
+		
+		// Allocate the total size of the pixel data in bytes		
+		bmpdata->pixels = (unsigned char*) calloc(bmpdata->size, 1);
+		if (bmpdata->pixels == NULL){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Unable to allocate memory for pixel data\n", __FILE__, __LINE__);
+			}
+			return BMP_ERR_MEM;
+		}
+		return bmp_DecodePixels(bmp_image, bmpdata);
+	}
+	return BMP_OK;
+}
+
+unsigned char bmp_FitScale(bmpdata_t *bmpdata, unsigned int max_width, unsigned int max_height){
+	// Return the smallest integer factor that an image must be scaled
+	// down by in order to fit within max_width x max_height.
+	// The header must already have been read.
+	
+	unsigned char scale;
+	
+	scale = 1;
+	while ((scale < BMP_MAX_SCALE) && (((bmpdata->width / scale) > max_width) || ((bmpdata->height / scale) > max_height))){
+		scale++;
+	}
+	return scale;
+}
+
+int bmp_ReadImageTo(FILE *bmp_image, bmpdata_t *bmpdata, bmpdest_t *dest){
+	// Decode the pixel data of an image straight onto a destination surface
+	// (such as the vram_buffer), instead of into a newly allocated pixel buffer.
+	//
+	// The header must already have been read, and the palette too if the
+	// pixels need remapping to new palette entries as they are written.
+	// bmpdata->pixels is not used.
+	
+	int status;
+	
+	if (bmpdata->offset <= 0){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Data offset not found or null, unable to seek to data section\n", __FILE__, __LINE__);
+		}
+		return BMP_ERR_READ;
+	}
+	status = bmp_ReadPixels(bmp_image, bmpdata, dest);
+	if (status != BMP_OK){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Error decoding pixel data to destination surface\n", __FILE__, __LINE__);
+		}
+	}
+	return status;
+}
+
+void bmp_Remap(bmpdata_t *bmpdata, bmpdest_t *dest, unsigned char *remap){
+	// Move the pixels of an image, decoded before its palette entries were set,
+	// onto those entries; remap[] holds the entry for each value the pixels were
+	// decoded to. dest is the surface it was decoded onto by bmp_ReadImageTo(),
+	// and only the part of it the image covers is remapped; or NULL if the image
+	// was decoded into its own pixel buffer.
+	
+	unsigned char	*dst;
+	unsigned int	n;
+	int x1, y1, x2, y2;
+	int x, y;
+	
+	if (dest == NULL){
+		if (bmpdata->pixels == NULL){
+			return;
+		}
+		dst = bmpdata->pixels;
+		for (n = bmpdata->n_pixels; n > 0; n--){
+			*dst = remap[*dst];
+			dst++;
+		}
+		return;
+	}
+	
+	x1 = dest->x;
+	y1 = dest->y;
+	x2 = dest->x + bmp_ScaledWidth(bmpdata, dest) - 1;
+	if (dest->scale > 1){
+		y2 = dest->y + (bmpdata->height / dest->scale) - 1;
+	} else {
+		y2 = dest->y + bmpdata->height - 1;
+	}
+	if (x1 < dest->clip_x1) x1 = dest->clip_x1;
+	if (y1 < dest->clip_y1) y1 = dest->clip_y1;
+	if (x2 > dest->clip_x2) x2 = dest->clip_x2;
+	if (y2 > dest->clip_y2) y2 = dest->clip_y2;
+	for (y = y1; y <= y2; y++){
+		dst = dest->buffer + (y * dest->pitch) + x1;
+		for (x = x1; x <= x2; x++){
+			*dst = remap[*dst];
+			dst++;
+		}
+	}
+}
+
+int bmp_ReadImageHeader(FILE *bmp_image, bmpdata_t *bmpdata){
+	// Just read the header information about a BMP image into a bmpdata structure
+	return bmp_ReadImage(bmp_image, bmpdata, 1 ,0,  0);	
+}
+
+int bmp_ReadImagePalette(FILE *bmp_image, bmpdata_t *bmpdata){
+	// Process the palette entries in the image colour table
+	return bmp_ReadImage(bmp_image, bmpdata, 0, 1, 0);	
+}
+
+int bmp_ReadImageData(FILE *bmp_image, bmpdata_t *bmpdata){
+	// Just load the pixel data into an already defined bmpdata structure
+	return bmp_ReadImage(bmp_image, bmpdata, 0, 0, 1);	
+}
+
+int bmp_ReadImagePooled(FILE *bmp_image, bmpdata_t *bmpdata){
+	// Load the pixel data of an image that is only needed briefly, e.g. to draw it
+	// once, into a buffer from the decode buffer pool rather than a new allocation. 
+	// If no buffer is free, or the image is too big for one, the pixels are allocated
+	// as bmp_ReadImageData() does. Either way, bmp_Destroy() frees them.
+	
+	unsigned char *buffer;
+	
+	if (bmpdata->offset <= 0){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Data offset not found or null, unable to seek to data section\n", __FILE__, __LINE__);
+		}
+		return BMP_ERR_READ;
+	}
+	buffer = bmp_PoolAcquire(bmpdata->size);
+	if (buffer == NULL){
+		return bmp_ReadImage(bmp_image, bmpdata, 0, 0, 1);
+	}
+	bmp_FreePixels(bmpdata);
+	memset(buffer, 0, bmpdata->size);
+	bmpdata->pixels = buffer;
+	bmpdata->pooled = 1;
+	return bmp_DecodePixels(bmp_image, bmpdata);
+}
+
+static int bmp_ExpandFont(fontdata_t *fontdata){
+	// Expand the packed glyphs into masks of one byte per pixel, ready for drawing.
+	// Each byte is 0 for the background, or 1 + the number of the plane the pixel is set in.
+	
+	unsigned int	symbol;
+	unsigned char	y, x, p;
+	unsigned char	*p_src;
+	unsigned char	*p_dest;
+	
+	fontdata->masks = (unsigned char *) calloc(fontdata->n_symbols * fontdata->width * fontdata->height, 1);
+	if (fontdata->masks == NULL){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Unable to allocate memory for font masks\n", __FILE__, __LINE__);
+		}
+		return BMP_ERR_MEM;
+	}
+	p_src = fontdata->glyphs;
+	p_dest = fontdata->masks;
+	for (symbol = 0; symbol < fontdata->n_symbols; symbol++){
+		for (y = 0; y < fontdata->height; y++){
+			for (p = 0; p < fontdata->n_planes; p++){
+				for (x = 0; x < fontdata->width; x++){
+					if (p_src[x >> 3] & (0x80 >> (x & 0x07))){
+						p_dest[x] = p + 1;
+					}
+				}
+				p_src += fontdata->bytes_per_row;
+			}
+			p_dest += fontdata->width;
+		}
+	}
+	return BMP_OK;
+}
+
+int bmp_ReadFont(FILE *bmp_image, bmpdata_t *bmpdata, fontdata_t *fontdata, unsigned char header, unsigned char palette, unsigned char data, unsigned char font_width, unsigned char font_height){
+	// Read a font from disk - really a wrapper around the bitmap reader.
+	// The glyphs of the bitmap are packed into 1bpp colour planes, 
+	// see the fontdata_t description in bmp.h
+	int h, w;
+	int x, y;
+	int p;
+	int pos;
+	int status;
+	int width_chars;
+	int height_chars;
+	unsigned char c;
+	unsigned char *p_dest, *p_src;
+	
+	status = BMP_OK;
+	
+	if (header){
+		// Extract bmp header
+		status = bmp_ReadImageHeader(bmp_image, bmpdata);
+	}
+	
+	if (palette){
+		// Process palette...
+		status = bmp_ReadImagePalette(bmp_image, bmpdata);
+		// ...and extract pixels
+		status = bmp_ReadImage(bmp_image, bmpdata, 0, 0, 1);
+	}
+	
+	if (data){
+		// Construct the font data structure
+		if (bmpdata->pixels == NULL){
+			return status;
+		}
+		if (bmpdata->bpp > BMP_8BPP){
+			// Unsupported bpp for font
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Unsupported font colour depth!\n", __FILE__, __LINE__);
+			}
+			return BMP_ERR_BPP;
+		}
+		if ((font_width < 1) || (font_width > 16)){
+			return BMP_ERR_FONT_WIDTH;
+		}
+		if ((font_height < 1) || (font_height > 16)){
+			return BMP_ERR_FONT_HEIGHT;
+		}
+		
+		width_chars = bmpdata->width / font_width;
+		height_chars = bmpdata->height / font_height;
+		if ((width_chars * height_chars) > 255){
+			height_chars = 255 / width_chars;
+		}
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Font BMP stores %d rows of %d characters (%d total symbols)\n", __FILE__, __LINE__, height_chars, width_chars, (width_chars * height_chars));	
+		}
+		
+		// Colour 0 of the bitmap is the background; every other colour 
+		// found in the glyphs gets a plane of its own
+		fontdata->bg_colour = bmpdata->palette[0].new_palette_entry;
+		fontdata->n_planes = 0;
+		for (pos = 0; pos < bmpdata->n_pixels; pos++){
+			c = bmpdata->pixels[pos];
+			if (c == fontdata->bg_colour){
+				continue;
+			}
+			for (p = 0; p < fontdata->n_planes; p++){
+				if (fontdata->plane_colour[p] == c){
+					break;
+				}
+			}
+			if (p == fontdata->n_planes){
+				if (fontdata->n_planes == BMP_FONT_MAX_PLANES){
+					if (BMP_VERBOSE){
+						printf("%s.%d\t Font uses more than %d colours plus background\n", __FILE__, __LINE__, BMP_FONT_MAX_PLANES);
+					}
+					return BMP_ERR_FONT_COLOURS;
+				}
+				fontdata->plane_colour[fontdata->n_planes] = c;
+				fontdata->n_planes++;
+			}
+		}
+		
+		fontdata->width = font_width;
+		fontdata->height = font_height;
+		fontdata->n_symbols = width_chars * height_chars;
+		fontdata->bytes_per_row = (font_width + 7) >> 3;
+		fontdata->glyph_size = font_height * fontdata->n_planes * fontdata->bytes_per_row;
+		fontdata->masks = NULL;
+		fontdata->glyphs = (unsigned char *) calloc(fontdata->n_symbols * fontdata->glyph_size, 1);
+		if (fontdata->glyphs == NULL){
+			if (BMP_VERBOSE){
+				printf("%s.%d\t Unable to allocate memory for font glyphs\n", __FILE__, __LINE__);
+			}
+			return BMP_ERR_MEM;
+		}
+		
+		// For each WxH character in the bitmap image, set a bit in the 
+		// plane of each pixel colour, in each row of the glyph
+		p_dest = fontdata->glyphs;
+		for(h = 0; h < height_chars; h++){
+			for(w = 0; w < width_chars; w++){
+				for(y = 0; y < font_height; y++){
+					p_src = bmpdata->pixels + (((h * font_height) + y) * bmpdata->width) + (w * font_width);
+					for (p = 0; p < fontdata->n_planes; p++){
+						for (x = 0; x < font_width; x++){
+							if (p_src[x] == fontdata->plane_colour[p]){
+								p_dest[x >> 3] |= (0x80 >> (x & 0x07));
+							}
+						}
+						p_dest += fontdata->bytes_per_row;
+					}
+				}
+			}
+		}
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Font packed to %d planes, %d bytes\n", __FILE__, __LINE__, fontdata->n_planes, fontdata->n_symbols * fontdata->glyph_size);
+		}
+		return bmp_ExpandFont(fontdata);
+	}
+	return status;
+}
+
+int bmp_ReadPackedFont(FILE *font_file, bmpdata_t *bmpdata, fontdata_t *fontdata, unsigned char header, unsigned char palette, unsigned char data){
+	// Read a packed font file, as made by tools/mkfont, in the same 
+	// three steps as bmp_ReadFont():
+	//
+	// header	== fills in fontdata, and the colour count and offsets of bmpdata
+	// palette	== reads the colour table into bmpdata, ready for pal_BMP2Palette()
+	// data		== reads all glyphs in one go, and sets the plane colours to
+	//			   the new palette entries of the colour table
+	
+	unsigned char	hdr[BMP_FONT_HEADER_SIZE];
+	unsigned int	size;
+	int			status;
+	int			i;
+	
+	if (header){
+		status = fseek(font_file, 0, SEEK_SET);
 		if (status != 0){
+			return BMP_ERR_READ;
+		}
+		status = fread(hdr, 1, BMP_FONT_HEADER_SIZE, font_file);
+		if (status < BMP_FONT_HEADER_SIZE){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error seeking height in header\n", __FILE__, __LINE__);
+				printf("%s.%d\t Error reading font header, got %d bytes\n", __FILE__, __LINE__, status);
 			}
 			return BMP_ERR_READ;
 		}
-		// Read height value
-		status = fread(&bmpdata->height, 4, 1, bmp_image);
-		if (status < 1){
+		if ((hdr[0] != 'P') || (hdr[1] != 'F') || (hdr[2] != 'N') || (hdr[3] != 'T') || (hdr[4] != BMP_FONT_VERSION)){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error reading %d records at image height header pos, got %d\n", __FILE__, __LINE__, 4, status);
+				printf("%s.%d\t Not a version %d packed font file\n", __FILE__, __LINE__, BMP_FONT_VERSION);
 			}
-			return BMP_ERR_READ;
+			return BMP_ERR_FONT_FORMAT;
+		}
+		fontdata->width = hdr[5];
+		fontdata->height = hdr[6];
+		fontdata->ascii_start = hdr[7];
+		fontdata->n_symbols = hdr[8];
+		fontdata->unknown_symbol = hdr[9];
+		fontdata->n_planes = hdr[10];
+		fontdata->bg_colour = hdr[11];
+		fontdata->bytes_per_row = hdr[12];
+		for (i = 0; i < BMP_FONT_MAX_PLANES; i++){
+			fontdata->plane_colour[i] = hdr[16 + i];
+		}
+		fontdata->glyph_size = fontdata->height * fontdata->n_planes * fontdata->bytes_per_row;
+		fontdata->glyphs = NULL;
+		fontdata->masks = NULL;
+		if ((fontdata->n_planes > BMP_FONT_MAX_PLANES) || (fontdata->bytes_per_row != ((fontdata->width + 7) >> 3))){
+			return BMP_ERR_FONT_FORMAT;
 		}
 		
-		// Seek to bpp location in header
-		status = fseek(bmp_image, BITS_PER_PIXEL_OFFSET, SEEK_SET);
+		bmpdata->width = fontdata->width;
+		bmpdata->height = fontdata->height;
+		bmpdata->colours = hdr[14] | (hdr[15] << 8);
+		if (bmpdata->colours > 256){
+			return BMP_ERR_FONT_FORMAT;
+		}
+		bmpdata->colours_offset = BMP_FONT_HEADER_SIZE;
+		bmpdata->offset = BMP_FONT_HEADER_SIZE + (bmpdata->colours * 4);
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Packed font: %dx%d, %d symbols, %d planes\n", __FILE__, __LINE__, fontdata->width, fontdata->height, fontdata->n_symbols, fontdata->n_planes);
+		}
+	}
+	
+	if (palette){
+		status = fseek(font_file, bmpdata->colours_offset, SEEK_SET);
 		if (status != 0){
-			if (BMP_VERBOSE){
-				printf("%s.%d\t Error seeking bpp in header\n", __FILE__, __LINE__);
-			}
 			return BMP_ERR_READ;
 		}
-		// Read bpp value
-		status = fread(&bmpdata->bpp, 2, 1, bmp_image);
-		if (status < 1){
+		status = fread(bmp_read_buffer, 4, bmpdata->colours, font_file);
+		if (status < bmpdata->colours){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error reading %d records at bpp header pos, got %d\n", __FILE__, __LINE__, 2, status);
+				printf("%s.%d\t Error reading font colour table\n", __FILE__, __LINE__);
 			}
 			return BMP_ERR_READ;
 		}
-		if ((bmpdata->bpp != BMP_4BPP) && (bmpdata->bpp != BMP_8BPP) && (bmpdata->bpp != BMP_16BPP) && (bmpdata->bpp != BMP_1BPP)){
+		for (i = 0; i < bmpdata->colours; i++){
+			bmpdata->palette[i].b = bmp_read_buffer[(i * 4)];
+			bmpdata->palette[i].g = bmp_read_buffer[(i * 4) + 1];
+			bmpdata->palette[i].r = bmp_read_buffer[(i * 4) + 2];
+			bmpdata->palette[i].new_palette_entry = i;
+		}
+	}
+	
+	if (data){
+		size = fontdata->n_symbols * fontdata->glyph_size;
+		fontdata->masks = NULL;
+		fontdata->glyphs = (unsigned char *) malloc(size);
+		if (fontdata->glyphs == NULL){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Unsupported pixel depth of %dbpp\n", __FILE__, __LINE__, bmpdata->bpp);
-				printf("%s.%d\t The supported pixel depths are %d, %d and %d\n", __FILE__, __LINE__, BMP_8BPP, BMP_16BPP, BMP_1BPP);
+				printf("%s.%d\t Unable to allocate memory for font glyphs\n", __FILE__, __LINE__);
 			}
-			return BMP_ERR_BPP;
+			return BMP_ERR_MEM;
 		}
-		
-		// Seek to colour count field
-		status = fseek(bmp_image, COLOUR_NUM_OFFSET, SEEK_SET);
+		status = fseek(font_file, bmpdata->offset, SEEK_SET);
 		if (status != 0){
-			if (BMP_VERBOSE){
-				printf("%s.%d\t Error seeking compression field in header\n", __FILE__, __LINE__);
-			}
 			return BMP_ERR_READ;
 		}
-		// Read colour count
-		status = fread(&bmpdata->colours, sizeof(bmpdata->colours), 1, bmp_image);
-		if (status < 1){
+		status = fread(fontdata->glyphs, 1, size, font_file);
+		if (status < size){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error reading %d records at colour count type header pos, got %d\n", __FILE__, __LINE__, 4, status);
+				printf("%s.%d\t Error reading font glyphs, wanted %d bytes, got %d\n", __FILE__, __LINE__, size, status);
 			}
+			free(fontdata->glyphs);
+			fontdata->glyphs = NULL;
 			return BMP_ERR_READ;
 		}
 		
-		// Seek to compression field
-		status = fseek(bmp_image, COMPRESS_OFFSET, SEEK_SET);
+		// Colours are stored as entries of the colour table
+		if (fontdata->bg_colour < bmpdata->colours){
+			fontdata->bg_colour = bmpdata->palette[fontdata->bg_colour].new_palette_entry;
+		}
+		for (i = 0; i < fontdata->n_planes; i++){
+			if (fontdata->plane_colour[i] < bmpdata->colours){
+				fontdata->plane_colour[i] = bmpdata->palette[fontdata->plane_colour[i]].new_palette_entry;
+			}
+		}
+		return bmp_ExpandFont(fontdata);
+	}
+	return BMP_OK;
+}
+
+int bmp_ReadTheme(FILE *theme_file, bmpdata_t *bmpdata, themedata_t *themedata, unsigned char header, unsigned char palette){
+	// Read a theme archive, as made by tools/mkthm:
+	//
+	// header	== reads the header and the directory of images into themedata, 
+	//			   and the colour count and offsets of the colour table into bmpdata
+	// palette	== reads the colour table shared by all images into bmpdata, 
+	//			   ready for pal_Alloc()
+	//
+	// The images are then read, one at a time, by bmp_ReadThemeImage()
+	
+	unsigned char	hdr[BMP_THEME_HEADER_SIZE];
+	unsigned char	*entry;
+	int			status;
+	int			i;
+	
+	if (header){
+		status = fseek(theme_file, 0, SEEK_SET);
 		if (status != 0){
+			return BMP_ERR_READ;
+		}
+		status = fread(hdr, 1, BMP_THEME_HEADER_SIZE, theme_file);
+		if (status < BMP_THEME_HEADER_SIZE){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error seeking compression field in header\n", __FILE__, __LINE__);
+				printf("%s.%d\t Error reading theme header, got %d bytes\n", __FILE__, __LINE__, status);
 			}
 			return BMP_ERR_READ;
-		}		
-		// Read compression value
-		status = fread(&bmpdata->compressed, sizeof(bmpdata->compressed), 1, bmp_image);
-		if (status < 1){
+		}
+		if ((hdr[0] != 'P') || (hdr[1] != 'T') || (hdr[2] != 'H') || (hdr[3] != 'M') || (hdr[4] != BMP_THEME_VERSION)){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Error reading %d records at compression type header pos, got %d\n", __FILE__, __LINE__, 4, status);
+				printf("%s.%d\t Not a version %d theme archive\n", __FILE__, __LINE__, BMP_THEME_VERSION);
 			}
+			return BMP_ERR_THEME_FORMAT;
+		}
+		themedata->n_images = hdr[6] | (hdr[7] << 8);
+		themedata->alignment = hdr[10] | (hdr[11] << 8);
+		bmpdata->colours = hdr[8] | (hdr[9] << 8);
+		if ((themedata->n_images > BMP_THEME_MAX_IMAGES) || (bmpdata->colours > 256)){
+			return BMP_ERR_THEME_FORMAT;
+		}
+		bmpdata->colours_offset = BMP_THEME_HEADER_SIZE;
+		bmpdata->offset = BMP_THEME_HEADER_SIZE + (bmpdata->colours * 4);
+		
+		// The whole directory, in one read
+		status = fseek(theme_file, bmpdata->offset, SEEK_SET);
+		if (status != 0){
 			return BMP_ERR_READ;
 		}
-		if (bmpdata->compressed != BMP_UNCOMPRESSED){
+		status = fread(bmp_read_buffer, BMP_THEME_ENTRY_SIZE, themedata->n_images, theme_file);
+		if (status < themedata->n_images){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Unsupported compressed BMP format\n", __FILE__, __LINE__);
+				printf("%s.%d\t Error reading theme directory\n", __FILE__, __LINE__);
 			}
-			return BMP_ERR_COMPRESSED;
+			return BMP_ERR_READ;
 		}
-				
-		// Calculate the bytes needed to store a single pixel
-		bmpdata->bytespp = (unsigned char) (bmpdata->bpp >> 3);
-		
-		// Rows are stored bottom-up
-		// Each row is padded to be a multiple of 4 bytes. 
-		// We calculate the padded row size in bytes
-		if (bmpdata->bpp == BMP_1BPP){
-			bmpdata->row_padded = (int)(4 * ceil((float)(bmpdata->width) / 4.0f)) / 8;
-			bmpdata->row_unpadded = (int) ceil((float)bmpdata->width / 8.0f);
-			bmpdata->size = (int) ceil((bmpdata->width * bmpdata->height) / 8.0f); 
-			bmpdata->n_pixels = bmpdata->size;
-		} else {
-			bmpdata->row_padded = (int)(4 * ceil((float)(bmpdata->width) / 4.0f)) * bmpdata->bytespp; // This needs moving from ceil/floating point!!!!
-			bmpdata->row_unpadded = bmpdata->width * bmpdata->bytespp;
-			bmpdata->size = (bmpdata->width * bmpdata->height * bmpdata->bytespp);
-			bmpdata->n_pixels = bmpdata->width * bmpdata->height;
+		for (i = 0; i < themedata->n_images; i++){
+			entry = bmp_read_buffer + (i * BMP_THEME_ENTRY_SIZE);
+			memcpy(themedata->images[i].name, entry, BMP_THEME_NAME_SIZE);
+			themedata->images[i].name[BMP_THEME_NAME_SIZE - 1] = '\0';
+			themedata->images[i].width = entry[12] | (entry[13] << 8);
+			themedata->images[i].height = entry[14] | (entry[15] << 8);
+			themedata->images[i].offset = entry[16] | (entry[17] << 8) | ((unsigned long) entry[18] << 16) | ((unsigned long) entry[19] << 24);
 		}
-		
 		if (BMP_VERBOSE){
-			printf("%s.%d\t Bitmap header loaded ok!\n", __FILE__, __LINE__);
-			printf("%s.%d\t Info - DIB header size: %d\n", __FILE__, __LINE__, bmpdata->dib_size);
-			printf("%s.%d\t Info - Resolution: %dx%d\n", __FILE__, __LINE__, bmpdata->width, bmpdata->height);
-			printf("%s.%d\t Info - Padded row size: %d bytes\n", __FILE__, __LINE__, bmpdata->row_padded);
-			printf("%s.%d\t Info - Unpadded row size: %d bytes\n", __FILE__, __LINE__, bmpdata->row_unpadded);
-			printf("%s.%d\t Info - Colour depth: %dbpp\n", __FILE__, __LINE__, bmpdata->bpp);
-			printf("%s.%d\t Info - Colour count: %d\n", __FILE__, __LINE__, bmpdata->colours);
-			printf("%s.%d\t Info - Colour table @ %x\n", __FILE__, __LINE__, bmpdata->colours_offset);
-			printf("%s.%d\t Info - Storage size: %d bytes\n", __FILE__, __LINE__, bmpdata->size);
-			printf("%s.%d\t Info - Pixel data @ %x\n", __FILE__, __LINE__, (unsigned int) &bmpdata->pixels);
+			printf("%s.%d\t Theme archive: %d images, %d colours\n", __FILE__, __LINE__, themedata->n_images, bmpdata->colours);
 		}
 	}
 	
-	// =============================
-	//
-	// Read, and possibly remap colour table palette entries
-	//
-	// =============================
-	
 	if (palette){
-		// First verify if we've actually read the header section and know where the colour table is...
-		if (bmpdata->colours_offset <= 0){
+		status = fseek(theme_file, bmpdata->colours_offset, SEEK_SET);
+		if (status != 0){
+			return BMP_ERR_READ;
+		}
+		status = fread(bmp_read_buffer, 4, bmpdata->colours, theme_file);
+		if (status < bmpdata->colours){
 			if (BMP_VERBOSE){
-				printf("%s.%d\t Colour table offset not found or null, unable to seek to colour table\n", __FILE__, __LINE__);
+				printf("%s.%d\t Error reading theme colour table\n", __FILE__, __LINE__);
 			}
 			return BMP_ERR_READ;
 		}
-		
-		for(i = 0; i < bmpdata->colours; i++){
-			status = fseek(bmp_image, bmpdata->colours_offset + (i * 4), SEEK_SET);
-			if (status != 0){
-				if (BMP_VERBOSE){
-					printf("%s.%d\t Error seeking to palette %d\n", __FILE__, __LINE__, i);
-				}
-				return BMP_ERR_READ;
-			}
-			status = fread(&b, 1, 1, bmp_image);
-			if (status < 1){
-				if (BMP_VERBOSE){
-					printf("%s.%d\t Error reading file at pos %u for palette %d, Red\n", __FILE__, __LINE__, (unsigned int) ftell(bmp_image), i);
-				}
-				return BMP_ERR_READ;
-			}
-			status = fread(&g, 1, 1, bmp_image);
-			if (status < 1){
-				if (BMP_VERBOSE){
-					printf("%s.%d\t Error reading file at pos %u for palette %d, Red\n", __FILE__, __LINE__, (unsigned int) ftell(bmp_image), i);
-				}
-				return BMP_ERR_READ;
-			}
-			status = fread(&r, 1, 1, bmp_image);
-			if (status < 1){
-				if (BMP_VERBOSE){
-					printf("%s.%d\t Error reading file at pos %u for palette %d, Red\n", __FILE__, __LINE__, (unsigned int) ftell(bmp_image), i);
-				}
-				return BMP_ERR_READ;
-			}
-			//if (BMP_VERBOSE){
-			//	printf("%s.%d\t Palette entry %d @ %d [r:%d, g:%d, b:%d]\n", __FILE__, __LINE__, i,  bmpdata->colours_offset + (i * 4), r, g, b);
-			//}
-			// NOw assign those values to the palette table in the bmpdata structure
-			bmpdata->palette[i].r = r;
-			bmpdata->palette[i].g = g;
-			bmpdata->palette[i].b = b;
+		for (i = 0; i < bmpdata->colours; i++){
+			bmpdata->palette[i].b = bmp_read_buffer[(i * 4)];
+			bmpdata->palette[i].g = bmp_read_buffer[(i * 4) + 1];
+			bmpdata->palette[i].r = bmp_read_buffer[(i * 4) + 2];
 			bmpdata->palette[i].new_palette_entry = i;
 		}
-		if (BMP_VERBOSE){
-			printf("%s.%d\t Extracted %d palette entries ok!\n", __FILE__, __LINE__, bmpdata->colours);
-		}
 	}
+	return BMP_OK;
+}
+
+themeentry_t *bmp_FindThemeImage(themedata_t *themedata, char *name){
+	// Directory entry of the named image of a theme archive, or NULL if there is none
 	
-	// ==============================
-	//
-	// Read and return pixel data
-	//
-	// ==============================
-	
-	if (data){
+	int i;
 	
-		// First verify if we've actually read the header section...
-		if (bmpdata->offset <= 0){
-			if (BMP_VERBOSE){
-				printf("%s.%d\t Data offset not found or null, unable to seek to data section\n", __FILE__, __LINE__);
-			}
-			return BMP_ERR_READ;
+	for (i = 0; i < themedata->n_images; i++){
+		if (strcmp(themedata->images[i].name, name) == 0){
+			return &themedata->images[i];
 		}
-		
-		// Allocate the total size of the pixel data in bytes		
-		if (bmpdata->bpp == BMP_1BPP){
-			bmpdata->pixels = (unsigned char*) calloc(bmpdata->size, 1);
-		} else {
-			bmpdata->pixels = (unsigned char*) calloc(bmpdata->n_pixels, bmpdata->bytespp);
-		} 
-		if (bmpdata->pixels == NULL){
-			if (BMP_VERBOSE){
-				printf("%s.%d\t Unable to allocate memory for pixel data\n", __FILE__, __LINE__);
-			}
-			return BMP_ERR_MEM;
+	}
+	return NULL;
+}
+
+int bmp_ReadThemeImage(FILE *theme_file, bmpdata_t *palette_bmp, themedata_t *themedata, char *name, bmpdata_t *bmpdata){
+	// Read the named image of a theme archive into bmpdata, in one read straight 
+	// into its pixel buffer. The pixels are remapped to the new palette entries
+	// of the colour table in palette_bmp, which bmpdata is given a copy of.
+	
+	themeentry_t	*image;
+	unsigned char	*px;
+	unsigned int	i;
+	int			status;
+	
+	image = bmp_FindThemeImage(themedata, name);
+	if (image == NULL){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t No image [%s] in theme archive\n", __FILE__, __LINE__, name);
 		}
+		return BMP_ERR_THEME_IMAGE;
+	}
 	
-		// Set the pixer buffer point to point to the very end of the buffer, minus the space for one row
-		// We have to read the BMP data backwards into the buffer, as it is stored in the file bottom to top
-		bmp_ptr = bmpdata->pixels + ((bmpdata->height - 1) * bmpdata->row_unpadded);
-		
-		// Seek to start of data section in file
-		fseek(bmp_image, bmpdata->offset, SEEK_SET);
-		
+	bmpdata->width = image->width;
+	bmpdata->height = image->height;
+	bmpdata->compressed = BMP_UNCOMPRESSED;
+	bmpdata->top_down = 1;
+	bmpdata->pooled = 0;
+	bmpdata->is_indexed = 1;
+	bmpdata->bpp = BMP_8BPP;
+	bmpdata->bytespp = 1;
+	bmpdata->offset = image->offset;
+	bmpdata->row_padded = image->width;
+	bmpdata->row_unpadded = image->width;
+	bmpdata->n_pixels = image->width * image->height;
+	bmpdata->size = bmpdata->n_pixels;
+	bmpdata->colours = palette_bmp->colours;
+	memcpy(bmpdata->palette, palette_bmp->palette, sizeof(bmpdata->palette));
+	
+	bmpdata->pixels = (unsigned char *) malloc(bmpdata->size);
+	if (bmpdata->pixels == NULL){
 		if (BMP_VERBOSE){
-			if (bmpdata->row_padded != bmpdata->row_unpadded){
-				printf("%s.%d\t Need to seek additional %d bytes per row\n", __FILE__, __LINE__, (bmpdata->row_padded - bmpdata->row_unpadded));
-			}
+			printf("%s.%d\t Unable to allocate memory for theme image [%s]\n", __FILE__, __LINE__, name);
 		}
-		
-		// For every row in the image...
-		for (i = 0; i < bmpdata->height; i++){		
-			
-			status = fread(bmp_ptr, 1, bmpdata->row_unpadded, bmp_image);
-			if (status < 1){
-				if (BMP_VERBOSE){
-					printf("%s.%d\t Error reading file at pos %u\n", __FILE__, __LINE__, (unsigned int) ftell(bmp_image));
-					printf("%s.%d\t Error reading %d records, got %d\n", __FILE__, __LINE__, bmpdata->row_unpadded, status);
-				}
-				free(bmpdata->pixels);
-				return BMP_ERR_READ;	
-			}
-			
-			// Update pixel buffer position to the next row which we'll read next loop (from bottom to top)
-			bmp_ptr -= bmpdata->row_unpadded;
-			
-			// Seek to next set of pixels for the next row if row_unpadded < row_padded
-			if (status != bmpdata->row_unpadded){
-				// Seek the number of bytes left in this row
-				status = fseek(bmp_image, (bmpdata->row_padded - bmpdata->row_unpadded), SEEK_CUR);
-				if (status != 0){
-					if (BMP_VERBOSE){
-						printf("%s.%d\t Error seeking next row of pixels\n", __FILE__, __LINE__);
-					}
-					free(bmpdata->pixels);
-					return BMP_ERR_READ;
-				}
-			} else {
-				// Seek to end of row
-				if (bmpdata->row_padded != bmpdata->row_unpadded){
-					fseek(bmp_image, (bmpdata->row_padded - bmpdata->row_unpadded), SEEK_CUR);
-				}
-			}
-			// Else... the fread() already left us at the next row	
-		}		
-		
-		// Swap each pixel to correct endianness (this is for Sharp X68000, which is big-endian)
-		// BMP pixel data is stored little-endian.
-		
-		// Case 8bpp
-		if (bmpdata->bpp == BMP_8BPP){
-			// We dont need to byteswap 8bpp image data
-			// But we do need to extract palette information
-			return BMP_OK;
-		
-		// Case 4bpp
-		} else if (bmpdata->bpp == BMP_4BPP){
-			// We dont need to byteswap 8bpp image data
-			// But we do need to extract palette information
-			return BMP_OK;
-			
-		// Case 1bpp
-		} else if (bmpdata->bpp == BMP_1BPP){
-			// We dont need to byteswap 1bpp image data
-			return BMP_OK;
-			
-		// Everything else
-		} else {
-			if (BMP_VERBOSE){
-				printf("%s.%d\t Unsupported byte mode for this pixel depth\n", __FILE__, __LINE__);
-			}
-			free(bmpdata->pixels);
-			return BMP_ERR_BPP;
+		return BMP_ERR_MEM;
+	}
+	status = fseek(theme_file, image->offset, SEEK_SET);
+	if ((status == 0) && (fread(bmpdata->pixels, 1, bmpdata->size, theme_file) < bmpdata->size)){
+		status = -1;
+	}
+	if (status != 0){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Error reading theme image [%s]\n", __FILE__, __LINE__, name);
+		}
+		free(bmpdata->pixels);
+		bmpdata->pixels = NULL;
+		return BMP_ERR_READ;
+	}
+	
+	bmp_BuildRemap(bmpdata);
+	if (!bmp_remap_identity){
+		px = bmpdata->pixels;
+		for (i = 0; i < bmpdata->size; i++){
+			px[i] = bmp_remap[px[i]];
 		}
 	}
 	return BMP_OK;
 }
 
-int bmp_ReadImageHeader(FILE *bmp_image, bmpdata_t *bmpdata){
-	// Just read the header information about a BMP image into a bmpdata structure
-	return bmp_ReadImage(bmp_image, bmpdata, 1 ,0,  0);	
+unsigned char *bmp_PoolAcquire(unsigned int size){
+	// Take a buffer of at least 'size' bytes from the decode buffer pool.
+	// Returns NULL if the size is too big, or all buffers are in use.
+	// The buffer must be handed back with bmp_PoolRelease().
+	
+	int i;
+	
+	if (size > BMP_POOL_BUFFER_SIZE){
+		if (BMP_VERBOSE){
+			printf("%s.%d\t Requested %d bytes is larger than the pool buffer size\n", __FILE__, __LINE__, size);
+		}
+		return NULL;
+	}
+	for (i = 0; i < BMP_POOL_BUFFERS; i++){
+		if (bmp_pool_used[i] == 0){
+			bmp_pool_used[i] = 1;
+			return bmp_pool[i];
+		}
+	}
+	if (BMP_VERBOSE){
+		printf("%s.%d\t No free pool buffers\n", __FILE__, __LINE__);
+	}
+	return NULL;
 }
 
-int bmp_ReadImagePalette(FILE *bmp_image, bmpdata_t *bmpdata){
-	// Process the palette entries in the image colour table
-	return bmp_ReadImage(bmp_image, bmpdata, 0, 1, 0);	
+void bmp_PoolRelease(unsigned char *buffer){
+	// Hand a buffer back to the decode buffer pool
+	
+	int i;
+	
+	for (i = 0; i < BMP_POOL_BUFFERS; i++){
+		if (buffer == bmp_pool[i]){
+			bmp_pool_used[i] = 0;
+			return;
+		}
+	}
+	if (BMP_VERBOSE){
+		printf("%s.%d\t Buffer 0x%x is not from the pool\n", __FILE__, __LINE__, (unsigned int) buffer);
+	}
 }
 
-int bmp_ReadImageData(FILE *bmp_image, bmpdata_t *bmpdata){
-	// Just load the pixel data into an already defined bmpdata structure
-	return bmp_ReadImage(bmp_image, bmpdata, 0, 0, 1);	
+void bmp_SetDither(unsigned char dither){
+	// Enable or disable ordered dithering when quantizing 16bpp and 24bpp images
+	
+	bmp_dither = dither;
 }
 
-int bmp_ReadFont(FILE *bmp_image, bmpdata_t *bmpdata, fontdata_t *fontdata, unsigned char header, unsigned char palette, unsigned char data, unsigned char font_width, unsigned char font_height){
-	// Read a font from disk - really a wrapper around the bitmap reader
-	int h, w;
-	int bytepos;
-	int heightpos;
-	int pos;
-	int status;
-	int width_chars;
-	int height_chars;
-	int row_bytepos;
-	int i;
-	char b;
-	unsigned char *p_dest, *p_src;
+void bmp_SetUsed(unsigned char *used){
+	// Mark used[] (256 entries, cleared by the caller) with every pixel value 
+	// written by the decodes that follow, or stop marking when NULL. Only the 
+	// pixels written to the destination surface count, not those clipped or 
+	// dropped by scaling.
 	
-	if (header){
-		// Extract bmp header
-		status = bmp_ReadImageHeader(bmp_image, bmpdata);
-	}
+	bmp_used = used;
+}
+
+void bmp_SetMaxColours(int max_colours){
+	// Most colours an image may use before its colour table is reduced; this is
+	// BMP_MAX_COLOURS, less any free palette region entries taken for other uses
 	
-	if (palette){
-		// Process palette...
-		status = bmp_ReadImagePalette(bmp_image, bmpdata);
-		// ...and extract pixels
-		status = bmp_ReadImage(bmp_image, bmpdata, 0, 0, 1);
+	if (max_colours < 1){
+		max_colours = 1;
 	}
-	
-	if (data){
-		// Construct the font data structure
-		if (bmpdata->pixels != NULL){
-			fontdata->width = font_width;
-			fontdata->height = font_height;
-			if (data != 0){
-				// Process BMP pixels to planar font array
-				pos = 0;
-				width_chars = bmpdata->width / font_width;
-				height_chars = bmpdata->height / font_height;
-				if (BMP_VERBOSE){
-					printf("%s.%d\t Font BMP stores %d rows of %d characters (%d total symbols)\n", __FILE__, __LINE__, height_chars, width_chars, (width_chars * height_chars));	
-					printf("%s.%d\t %dbpp font decoded at 0x%x\n", __FILE__, __LINE__, bmpdata->bpp, (unsigned int) &fontdata->symbol);
-				}
-				if (bmpdata->bpp == BMP_8BPP){			
-					// For each WxH character in the bitmap image, store each row of bytes
-					if (BMP_VERBOSE){
-						printf("%s.%d\t Starting 8bpp font decoding\n", __FILE__, __LINE__);
-					}
-					
-					pos = 0; 		// character/symbol position (0, 1, 2, ... 32)
-					bytepos = 0; 		// position in bmp image data of the top left pixel of the current symbol
-					heightpos = 0;	// vertical offsetof into bmp image data
-					row_bytepos = bytepos;
-					
-					// For every row of symbols
-					for(h = 0; h < height_chars; h++){
-						if (BMP_VERBOSE){
-							printf("%s.%d\t Decoding font glyph row %d\n", __FILE__, __LINE__, h);
-						}
-						// FOr every symbol in the row
-						for(w = 0; w < width_chars; w++){
-							//if (BMP_VERBOSE){
-							//	printf("%s.%d\t Decoding font glyph row %d, symbol %d\n", __FILE__, __LINE__, h, w);
-							//}
-
-							// For every row of pixels in a symbol
-							for(heightpos = 0; heightpos < fontdata->height; heightpos++){
-								//printf("%s.%d\t Pixel row %d\n", __FILE__, __LINE__, heightpos);
-								for (i = 0; i < font_width; i++){
-									fontdata->symbol[pos][heightpos][i] = bmpdata->pixels[row_bytepos + i];
-								} 
-								row_bytepos = bytepos + (bmpdata->row_unpadded * heightpos);
-							}
-							// Jump to next symbol in row
-							bytepos += font_width;
-							
-							// Increment symbol number
-							pos++;
-						}
-						// At end of every row of symbols, step by the height of one symbol row
-						// so that we're at the top left pixel of the first symbol of the new row
-						bytepos += (bmpdata->row_unpadded * (font_height - 1));
-					}
-					return BMP_OK;
-				} else {
-					// Unsupported bpp for font
-					if (BMP_VERBOSE){
-						printf("%s.%d\t Unsupported font colour depth!\n", __FILE__, __LINE__);
-					}
-					return BMP_ERR_BPP;
-				}
-			} else {
-				return BMP_OK;
-			}
-		} else {
-			return status;	
-		}
+	if (max_colours > BMP_MAX_COLOURS){
+		max_colours = BMP_MAX_COLOURS;
 	}
-	return status;
+	bmp_max_colours = max_colours;
 }
 
 void bmp_Destroy(bmpdata_t *bmpdata){
 	// Destroy a bmpdata structure and free any memory allocated
 	
-	if (bmpdata->pixels != NULL){
-		free(bmpdata->pixels);	
-	}
+	bmp_FreePixels(bmpdata);
 	free(bmpdata);	
 }
 
 void bmp_DestroyFont(fontdata_t *fontdata){
 	// Destroy a fontdata structure and free any memory allocated
 	
+	if (fontdata->glyphs != NULL){
+		free(fontdata->glyphs);
+	}
+	if (fontdata->masks != NULL){
+		free(fontdata->masks);
+	}
 	free(fontdata);
 	
 }
\ No newline at end of file
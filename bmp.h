@@ -19,13 +19,21 @@
 #define COLOUR_NUM_OFFSET		0x002E // Where we can find the numbers of colours used in the image
 #define COLOUR_PRI_OFFSET		0x0032 // Where we can find the number of the 'important' colour ???
 #define PALETTE_OFFSET			0x0036 // Where the colour palette starts, for <=8bpp images.
+#define BITFIELDS_OFFSET			0x0036 // Where the red, green and blue masks start, for bitfields images
 #define HEADER_SIZE 				14
 #define INFO_HEADER_SIZE 		40
 #define BMP_1BPP					1
 #define BMP_4BPP					4
 #define BMP_8BPP					8	
 #define BMP_16BPP				16
+#define BMP_24BPP				24
 #define BMP_UNCOMPRESSED			0
+#define BMP_RLE8					1 // 8bpp run-length encoded
+#define BMP_RLE4					2 // 4bpp run-length encoded
+#define BMP_BITFIELDS			3 // 16bpp with red, green and blue masks
+#define BMP_RLE_EOL				0 // RLE escape; end of line
+#define BMP_RLE_EOB				1 // RLE escape; end of bitmap
+#define BMP_RLE_DELTA			2 // RLE escape; move x,y position by the following two bytes
 #define BMP_VERBOSE				0 // Enable BMP specific debug/verbose output
 #define BMP_OK					0 // BMP loaded and decode okay
 #define BMP_ERR_NOFILE			-1 // Cannot find file
@@ -33,12 +41,38 @@
 #define BMP_ERR_MEM				-3 // Unable to allocate memory
 #define BMP_ERR_BPP				-4 // Unsupported colour depth/BPP
 #define BMP_ERR_READ				-5 // Error reading or seeking within file
-#define BMP_ERR_COMPRESSED		-6 // We dont support comrpessed BMP files
+#define BMP_ERR_COMPRESSED		-6 // We dont support this type of compressed BMP file
 #define BMP_ERR_FONT_WIDTH		-7 // We dont support fonts of this width
 #define BMP_ERR_FONT_HEIGHT		-8 // We dont support fonts of this height
+#define BMP_ERR_FONT_COLOURS		-9 // Font uses more colours than can be packed
+#define BMP_ERR_FONT_FORMAT		-10 // Not a packed font file, or an unknown version of one
+#define BMP_ERR_THEME_FORMAT		-11 // Not a theme archive, or an unknown version of one
+#define BMP_ERR_THEME_IMAGE		-12 // No image of that name in the theme archive
+#define BMP_ERR_COLOURS			-13 // Colour table has more than 256 entries
 #define BMP_FONT_MAX_WIDTH		8
 #define BMP_FONT_MAX_HEIGHT		16
 #define BMP_FONT_PLANES			4 // Number of colour planes per pixel
+#define BMP_FONT_MAX_PLANES		4 // Maximum number of (non-background) colours in a packed font
+#define BMP_FONT_VERSION			1 // Version of the packed font file format
+#define BMP_FONT_HEADER_SIZE		20 // Size of the packed font file header, in bytes
+#define BMP_THEME_VERSION		1 // Version of the theme archive file format
+#define BMP_THEME_HEADER_SIZE	16 // Size of the theme archive header, in bytes
+#define BMP_THEME_ENTRY_SIZE		20 // Size of each directory entry of a theme archive, in bytes
+#define BMP_THEME_NAME_SIZE		12 // Longest image name in a theme archive, including the terminating nul
+#define BMP_THEME_MAX_IMAGES		64 // Most images in one theme archive
+#define BMP_THEME_ALIGN			2048 // Pixels of each image start on a multiple of this, so they are read in whole clusters
+#define BMP_READ_BUFFER_SIZE		16384 // Size of the block buffer used to bulk read pixel data (same as the DJGPP transfer buffer)
+#define BMP_ROW_BUFFER_SIZE		2048 // Widest image, in pixels, that can be decoded
+#define BMP_MAX_SCALE			8 // Largest factor an image can be scaled down by when decoded
+#define BMP_POOL_BUFFERS			2 // Number of preallocated decode buffers
+#define BMP_POOL_BUFFER_SIZE		64000 // Size of each preallocated decode buffer (one 320x200 artwork window)
+#define BMP_QUANT_R_LEVELS		6 // Red levels of the fixed palette used for 16bpp and 24bpp images
+#define BMP_QUANT_G_LEVELS		8 // Green levels
+#define BMP_QUANT_B_LEVELS		4 // Blue levels
+#define BMP_QUANT_CUBE_SIZE		(BMP_QUANT_R_LEVELS * BMP_QUANT_G_LEVELS * BMP_QUANT_B_LEVELS)
+#define BMP_QUANT_GREYS			16 // Additional grey levels, after the colour cube
+#define BMP_QUANT_COLOURS		(BMP_QUANT_CUBE_SIZE + BMP_QUANT_GREYS) // Must fit the free palette region (208)
+#define BMP_MAX_COLOURS			208 // Most colours an indexed image may use; larger colour tables are reduced to fit the free palette region
 
 // ============================
 //
@@ -61,6 +95,9 @@ typedef struct bmpdata {
 	unsigned int 	width;			// X resolution in pixels
 	unsigned int 	height;			// Y resolution in pixels
 	char			compressed;		// If the data is compressed or not (usually RLE)
+	unsigned char	top_down;		// If the rows are stored top to bottom (negative height in header)
+	unsigned char	rgb565;			// If 16bpp pixels are 5-6-5, rather than 5-5-5
+	unsigned char	pooled;			// If pixels is a buffer from the decode buffer pool, rather than calloc'ed
 	unsigned int	dib_size;			// size of the DIB header
 	unsigned char	is_indexed;		// If the image uses a palette table
 	unsigned short	colours_offset;
@@ -72,7 +109,7 @@ typedef struct bmpdata {
 	unsigned int 	row_unpadded;	// SIze of a row, padded to a multiple of 4 bytes
 	unsigned int 	size;			// Size of the pixel data, in bytes
 	unsigned int	n_pixels;			// Number of pixels
-	struct pal_entry	palette[256];		// Palette entries for 8bit indexed images
+	struct pal_entry	palette[256];		// Palette entries for 8bit indexed images, or the fixed quantizer palette
 	unsigned char	*pixels;			// Pointer to raw pixels - in font mode each byte is a single pixel
 } bmpdata_t;
 
@@ -87,14 +124,51 @@ typedef struct bmpstate {
 	unsigned char	*pixels;			// Needs to be malloc'ed to the width of a single row of pixels
 } bmpstate_t;
 
+// ============================
+//
+// BMP decode destination
+//
+// A surface that pixel data is decoded straight onto, such 
+// as the vram_buffer, or the pixel buffer of a bmpdata_t.
+//
+// ============================
+typedef struct bmpdest {
+	unsigned char	*buffer;		// Top left pixel of the surface
+	unsigned int	pitch;			// Size of one row of the surface, in bytes
+	int			x;				// Where the top left pixel of the image is placed on the surface
+	int			y;
+	int			clip_x1;			// Clip rectangle (inclusive); nothing outside of this is written
+	int			clip_y1;
+	int			clip_x2;
+	int			clip_y2;
+	unsigned char	scale;			// Integer factor to scale the image down by (1 == unscaled)
+} bmpdest_t;
+
 // ============================
 //
 // Font data structure
 //
-// 96 characters, 
-// each character is 1 byte wide, and up to 16 (max) rows high 
-// each row is 4 planes
-// total of 6144 bytes per 96 character font
+// Glyphs are packed 1 bit per pixel (leftmost pixel in the 
+// highest bit), with one plane for each colour used by the 
+// font other than the background. Each glyph is stored as:
+//
+//	row 0: plane 0, plane 1, ... plane n
+//	row 1: plane 0, plane 1, ... plane n
+//	...
+//
+// so an 8x16 font with a glyph colour and an outline colour
+// takes 96 * 16 * 2 = 3072 bytes.
+//
+// Packed font files (.fnt) hold exactly this data, after a 
+// header and the colour table of the bitmap they were made from:
+//
+//	0	'P', 'F', 'N', 'T'
+//	4	version, width, height, ascii_start
+//	8	n_symbols, unknown_symbol, n_planes, bg_colour
+//	12	bytes_per_row, 0, n_colours (16bit)
+//	16	plane_colour[4]
+//	20	n_colours * 4 bytes of colour table (b, g, r, 0)
+//	..	glyph data
 //
 //=============================
 typedef struct fontdata {
@@ -103,13 +177,67 @@ typedef struct fontdata {
 	unsigned char			ascii_start;		// ASCII number of symbol 0
 	unsigned char			n_symbols;		// Total number of symbols
 	unsigned char			unknown_symbol;	// Which symbol do we map to unknown/missing symbols?
-	unsigned char 			symbol[96][16][16]; // Only up to 16px high, 16 px wide fonts
+	unsigned char			n_planes;			// Number of colour planes
+	unsigned char			bytes_per_row;	// Size of one row of one plane, in bytes
+	unsigned char			bg_colour;		// Palette entry of pixels not set in any plane
+	unsigned char			plane_colour[BMP_FONT_MAX_PLANES]; // Palette entry of pixels set in each plane
+	unsigned int			glyph_size;		// Size of one glyph, in bytes
+	unsigned char			*glyphs;			// Packed glyph data
+	unsigned char			*masks;			// Glyphs expanded to a byte per pixel; 0 or 1 + plane number
 }  fontdata_t;
 
+// ============================
+//
+// Theme archive
+//
+// All the bitmaps of a UI theme in one file, as made by tools/mkthm,
+// so they can be loaded without opening and decoding each bitmap. 
+// The images share one colour table, and their pixels are stored 
+// ready to use, other than the remap to new palette entries:
+//
+//	0	'P', 'T', 'H', 'M'
+//	4	version, 0, n_images (16bit)
+//	8	n_colours (16bit), alignment (16bit)
+//	12	0, 0, 0, 0
+//	16	n_colours * 4 bytes of colour table (b, g, r, 0)
+//	..	n_images * BMP_THEME_ENTRY_SIZE bytes of directory:
+//		0	name, nul padded
+//		12	width (16bit), height (16bit)
+//		16	offset of the pixels from the start of the file (32bit)
+//	..	pixels of each image; 8bpp, top row first, rows not padded, 
+//		starting at a multiple of the alignment
+//
+//=============================
+typedef struct themeentry {
+	char				name[BMP_THEME_NAME_SIZE];
+	unsigned short		width;
+	unsigned short		height;
+	unsigned long		offset;			// Where the pixels start in the file
+} themeentry_t;
+
+typedef struct themedata {
+	unsigned short		n_images;
+	unsigned short		alignment;		// Pixels of each image start on a multiple of this
+	themeentry_t		images[BMP_THEME_MAX_IMAGES];
+} themedata_t;
+
+void	bmp_SetDither(unsigned char dither);
+void	bmp_SetMaxColours(int max_colours);
+void	bmp_SetUsed(unsigned char *used);
+unsigned char	*bmp_PoolAcquire(unsigned int size);
+void	bmp_PoolRelease(unsigned char *buffer);
 void	bmp_Destroy(bmpdata_t *bmpdata);
 void	bmp_DestroyFont(fontdata_t *fontdata);
+int 		bmp_ReadPackedFont(FILE *font_file, bmpdata_t *bmpdata, fontdata_t *fontdata, unsigned char header, unsigned char palette, unsigned char data);
 int 		bmp_ReadFont(FILE *bmp_image, bmpdata_t *bmpdata, fontdata_t *fontdata, unsigned char header, unsigned char palette, unsigned char data, unsigned char font_width, unsigned char font_height);
+int 		bmp_ReadTheme(FILE *theme_file, bmpdata_t *bmpdata, themedata_t *themedata, unsigned char header, unsigned char palette);
+themeentry_t	*bmp_FindThemeImage(themedata_t *themedata, char *name);
+int 		bmp_ReadThemeImage(FILE *theme_file, bmpdata_t *palette_bmp, themedata_t *themedata, char *name, bmpdata_t *bmpdata);
 int 		bmp_ReadImage(FILE *bmp_image, bmpdata_t *bmpdata, unsigned char header, unsigned char palette, unsigned char data);
 int 		bmp_ReadImageHeader(FILE *bmp_image, bmpdata_t *bmpdata);
 int 		bmp_ReadImagePalette(FILE *bmp_image, bmpdata_t *bmpdata);
 int 		bmp_ReadImageData(FILE *bmp_image, bmpdata_t *bmpdata);
+int 		bmp_ReadImagePooled(FILE *bmp_image, bmpdata_t *bmpdata);
+unsigned char	bmp_FitScale(bmpdata_t *bmpdata, unsigned int max_width, unsigned int max_height);
+int 		bmp_ReadImageTo(FILE *bmp_image, bmpdata_t *bmpdata, bmpdest_t *dest);
+void	bmp_Remap(bmpdata_t *bmpdata, bmpdest_t *dest, unsigned char *remap);
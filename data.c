@@ -285,6 +285,11 @@ void configDefaults(config_t *config){
 	config->preload_names = 0;
 	config->dir = NULL;
 	config->keyboard_test = 0;
+	config->dither = 1;
+	config->pageflip = 0;
+	config->scroll = 0;
+	config->vsync = 0;
+	config->highlight = 0;
 }
 
 int getLaunchdata(gamedata_t *gamedata, launchdat_t *launchdat){
@@ -332,6 +337,16 @@ static int configHandler(void* user, const char* section, const char* name, cons
 		config->preload_names =  atoi(value);
 	} else if (MATCH("default", "keyboard_test")){
 		config->keyboard_test =  atoi(value);
+	} else if (MATCH("default", "dither")){
+		config->dither =  atoi(value);
+	} else if (MATCH("default", "pageflip")){
+		config->pageflip =  atoi(value);
+	} else if (MATCH("default", "scroll")){
+		config->scroll =  atoi(value);
+	} else if (MATCH("default", "vsync")){
+		config->vsync =  atoi(value);
+	} else if (MATCH("default", "highlight")){
+		config->highlight =  atoi(value);
 	} else {
 		return 0;  /* unknown section/name, error */
 	}
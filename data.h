@@ -71,6 +71,11 @@ typedef struct config {
 	int save;					// Save the list of all games to a text file
 	int preload_names;		// Flag to indicate wheter a launch.dat is loaded at scrape-time to pick up real names
 	int keyboard_test;
+	int dither;				// Use ordered dithering when displaying 16bpp/24bpp artwork
+	int pageflip;				// Draw to the hidden graphics page and flip, rather than draw to the displayed page
+	int scroll;				// Scroll the browser a line at a time, rather than a page at a time
+	int vsync;				// Wait for vertical blank before presenting, and optionally split large copies over several
+	int highlight;			// Show the selected line by changing palette entries, rather than moving the cursor
 	char dirs[MAX_SEARCHDIRS_SIZE];			// String containing all game dirs to search - it will then be parsed into a list below:
 	struct gamedir *dir;		// List of all the game search dirs
 } __attribute__((__packed__)) __attribute__((aligned (2))) config_t;
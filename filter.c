@@ -239,6 +239,7 @@ int filter_None(state_t *state, gamedata_t *gamedata){
 	state->selected_max = i; 	// Number of items in selection list
 	state->selected_page = 1;	// Start on page 1
 	state->selected_line = 0;	// Start on line 0
+	state->selected_top = 0;
 	state->total_pages = 0;	
 	state->selected_filter_string = 0;
 	state->selected_gameid = state->selected_list[0]; 	// Initial game is the 0th element of the selection list
@@ -288,6 +289,7 @@ int filter_Genre(state_t *state, gamedata_t *gamedata){
 	state->selected_max = 0; 	
 	state->selected_page = 1;	
 	state->selected_line = 0;	
+	state->selected_top = 0;
 	state->total_pages = 0;		
 	state->selected_gameid = -1;
 	state->selected_game = NULL;
@@ -336,6 +338,7 @@ int filter_Genre(state_t *state, gamedata_t *gamedata){
 	state->selected_max = i; 	// Number of items in selection list
 	state->selected_page = 1;	// Start on page 1
 	state->selected_line = 0;	// Start on line 0
+	state->selected_top = 0;
 	state->total_pages = 0;		
 	state->selected_filter_string = 0;
 	state->selected_gameid = state->selected_list[0]; 	// Initial game is the 0th element of the selection list
@@ -383,6 +386,7 @@ int filter_Series(state_t *state, gamedata_t *gamedata){
 	state->selected_max = 0; 	
 	state->selected_page = 1;	
 	state->selected_line = 0;	
+	state->selected_top = 0;
 	state->total_pages = 0;		
 	state->selected_gameid = -1;
 	state->selected_game = NULL;
@@ -431,6 +435,7 @@ int filter_Series(state_t *state, gamedata_t *gamedata){
 	state->selected_max = i; 	// Number of items in selection list
 	state->selected_page = 1;	// Start on page 1
 	state->selected_line = 0;	// Start on line 0
+	state->selected_top = 0;
 	state->total_pages = 0;		
 	state->selected_filter_string = 0;
 	state->selected_gameid = state->selected_list[0]; 	// Initial game is the 0th element of the selection list
@@ -19,11 +19,13 @@
 #include <limits.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include <dos.h>
 #include <go32.h>
 #include <dpmi.h>
 
 #include "gfx.h"
+#include "palette.h"
 #include "pegc.h"
 #include "utils.h"
 #ifndef __HAS_BMP
@@ -31,6 +33,45 @@
 #define __HAS_BMP
 #endif
 
+// Damaged span of each row of vram_buffer, since the last gfx_Flip()
+// x2 is exclusive, so a row is clean when x2 == 0 (or x2 <= x1)
+static short	gfx_dirty_x1[GFX_ROWS];
+static short	gfx_dirty_x2[GFX_ROWS];
+static int		gfx_dirty_y1;		// First damaged row
+static int		gfx_dirty_y2;		// Last damaged row, exclusive; nothing is damaged when 0
+static unsigned int	gfx_flip_bytes;	// Bytes copied to the framebuffer by the last gfx_Flip()
+
+// Page flipping; each gfx_Flip() draws into the hidden page and then displays it.
+// The other page missed the previous frame's changes, so those spans are kept
+// and copied again, along with the new ones, the next time it is drawn to.
+static unsigned char	gfx_page_flip;		// Set if page flipping is enabled
+static unsigned char	gfx_hidden_page;	// Page which is not currently displayed
+static short	gfx_prev_x1[GFX_ROWS];	// Damaged spans of the previous frame
+static short	gfx_prev_x2[GFX_ROWS];
+static int		gfx_prev_y1;
+static int		gfx_prev_y2;
+
+// Vertical blank synchronisation of gfx_Flip()
+static unsigned char	gfx_vsync;			// One of GFX_VSYNC_OFF, GFX_VSYNC_WAIT or GFX_VSYNC_SPLIT
+static unsigned char	gfx_vsync_split;	// Set while the current flip is splitting its copies
+static unsigned int	gfx_blank_bytes;	// Bytes copied since the last vertical blank began
+
+// Present statistics, for every gfx_Flip() which copied anything
+static unsigned long	gfx_stat_presents;
+static unsigned long	gfx_stat_bytes;		// Bytes copied, in total and for the smallest and largest present
+static unsigned int	gfx_stat_bytes_min;
+static unsigned int	gfx_stat_bytes_max;
+static uclock_t		gfx_stat_time;		// Time taken, including waiting for vertical blank
+static uclock_t		gfx_stat_time_min;
+static uclock_t		gfx_stat_time_max;
+static uclock_t		gfx_stat_wait;		// Time spent waiting for vertical blank
+static unsigned long	gfx_stat_blanks;	// Vertical blanks waited for
+static unsigned long	gfx_stat_timeouts;	// Waits which gave up
+
+// Background layer; a full screen copy of vram_buffer holding only the static 
+// parts of the screen, so that any area of it can be cleared with a memcpy
+static unsigned char	*gfx_background;
+
 int gfx_Init(){
 	// Initialise graphics to a set of configured defaults
 	
@@ -67,6 +108,8 @@ int gfx_Init(){
 	// Set screen 0 to be active for drawing and active for display
 	outportb(PEGC_DRAW_SCREEN_SEL_ADDR, 0x00);
 	outportb(PEGC_DISP_SCREEN_SEL_ADDR, 0x00);
+	gfx_hidden_page = 1;
+	gfx_prev_y2 = 0;
 	
 	// Graphics mode on
 	outportb(PEGC_GDC_COMMAND_ADDR, GDC_COMMAND_START);
@@ -87,6 +130,10 @@ int gfx_Close(){
 		printf("%s.%d\t Exiting gfx mode\n", __FILE__, __LINE__);	
 	}
 	_farpokeb(_dos_ds, PEGC_FB_CONTROL_ADDR, PEGC_FB_OFF);
+	
+	// Back to screen 0, in case page flipping left us on screen 1
+	outportb(PEGC_DRAW_SCREEN_SEL_ADDR, 0x00);
+	outportb(PEGC_DISP_SCREEN_SEL_ADDR, 0x00);
 
 	// 16 Color mode
 	outportb(PEGC_MODE_ADDR, 0x07);
@@ -101,6 +148,7 @@ int gfx_Close(){
 	
 	//  Clear anything we did to the screen
 	gfx_Clear();
+	gfx_BackgroundFree();
 	
 	// Text mode on
 	gfx_TextOn();
@@ -112,7 +160,56 @@ void gfx_Clear(){
 	
 	// Set local vram_buffer to empty
 	memset(vram_buffer, 0, (GFX_ROW_SIZE * GFX_COL_SIZE));
+	gfx_Dirty(0, 0, GFX_COLS - 1, GFX_ROWS - 1);
+}
+
+void gfx_Dirty(int x1, int y1, int x2, int y2){
+	// Mark an area of vram_buffer as changed, so that it is
+	// copied to the framebuffer by the next gfx_Flip().
+	// Coordinates are inclusive, and clipped to the screen.
+	
+	int row;
+	
+	if (x1 < 0){
+		x1 = 0;
+	}
+	if (y1 < 0){
+		y1 = 0;
+	}
+	if (x2 > (GFX_COLS - 1)){
+		x2 = GFX_COLS - 1;
+	}
+	if (y2 > (GFX_ROWS - 1)){
+		y2 = GFX_ROWS - 1;
+	}
+	if ((x2 < x1) || (y2 < y1)){
+		return;
+	}
 	
+	for (row = y1; row <= y2; row++){
+		if (gfx_dirty_x2[row] <= gfx_dirty_x1[row]){
+			gfx_dirty_x1[row] = x1;
+			gfx_dirty_x2[row] = x2 + 1;
+		} else {
+			if (x1 < gfx_dirty_x1[row]){
+				gfx_dirty_x1[row] = x1;
+			}
+			if ((x2 + 1) > gfx_dirty_x2[row]){
+				gfx_dirty_x2[row] = x2 + 1;
+			}
+		}
+	}
+	if (gfx_dirty_y2 == 0){
+		gfx_dirty_y1 = y1;
+		gfx_dirty_y2 = y2 + 1;
+	} else {
+		if (y1 < gfx_dirty_y1){
+			gfx_dirty_y1 = y1;
+		}
+		if ((y2 + 1) > gfx_dirty_y2){
+			gfx_dirty_y2 = y2 + 1;
+		}
+	}
 }
 
 int gfx_DPMI(){
@@ -177,11 +274,292 @@ void gfx_TextOff(){
 	outportb(0x62, GDC_COMMAND_STOP1);
 }
 
+static void gfx_WaitVsync(){
+	// Wait for the start of the next vertical blank. If we are already in one
+	// then it is partly over, so let it finish first. If the GDC never reports 
+	// a change, vsync is turned off rather than waiting on every flip.
+	
+	unsigned long polls;
+	uclock_t start_time;
+	
+	start_time = uclock();
+	polls = 0;
+	while ((inportb(PEGC_GDC_STATUS_ADDR) & GDC_STATUS_VSYNC) && (polls < GFX_VSYNC_TIMEOUT)){
+		polls++;
+	}
+	if (polls < GFX_VSYNC_TIMEOUT){
+		polls = 0;
+		while (!(inportb(PEGC_GDC_STATUS_ADDR) & GDC_STATUS_VSYNC) && (polls < GFX_VSYNC_TIMEOUT)){
+			polls++;
+		}
+	}
+	gfx_stat_wait += uclock() - start_time;
+	gfx_blank_bytes = 0;
+	if (polls < GFX_VSYNC_TIMEOUT){
+		gfx_stat_blanks++;
+	} else {
+		if (GFX_VERBOSE){
+			printf("%s.%d\t No vertical blank reported by the GDC, vsync disabled\n", __FILE__, __LINE__);
+		}
+		gfx_stat_timeouts++;
+		gfx_vsync = GFX_VSYNC_OFF;
+		gfx_vsync_split = 0;
+	}
+}
+
+static void gfx_Copy(unsigned int offset, unsigned int page_offset, unsigned int n){
+	// Copy n bytes at offset in vram_buffer to the same place in the framebuffer.
+	// When splitting, no more is copied than is left of the budget for this 
+	// vertical blank, and the rest waits for the next one.
+	
+	unsigned int chunk;
+	
+	while (n > 0){
+		chunk = n;
+		if (gfx_vsync_split){
+			if (gfx_blank_bytes >= GFX_VSYNC_BUDGET){
+				gfx_WaitVsync();
+			}
+			if (gfx_vsync_split && (chunk > (GFX_VSYNC_BUDGET - gfx_blank_bytes))){
+				chunk = GFX_VSYNC_BUDGET - gfx_blank_bytes;
+			}
+		}
+		movedata(_my_ds(), (unsigned int) (vram_buffer + offset), vram_dpmi_selector, page_offset + offset, chunk);
+		gfx_blank_bytes += chunk;
+		gfx_flip_bytes += chunk;
+		offset += chunk;
+		n -= chunk;
+	}
+}
+
 void gfx_Flip(){
-	// Copy a buffer of GFX_ROWS * GFX_COLS bytes to
-	// the active VRAM framebuffer for display.
+	// Copy the damaged areas of vram_buffer to the
+	// active VRAM framebuffer for display.
+	//
+	// Runs of damaged rows are merged into bands; a band which is 
+	// mostly full width is copied as one block of whole rows, otherwise
+	// just the damaged span of each row in the band is copied.
+	//
+	// Drawing only marks rows as damaged, so any number of changes are
+	// presented together by the next flip, and a flip with nothing 
+	// damaged does nothing at all.
+	//
+	// Palette changes are uploaded in the same vertical blank as the 
+	// copies (or page switch), so new colours and pixels appear together.
+	
+	int row, i;
+	int band_y1, band_y2;
+	int band_x1, band_x2;
+	int own_x1, own_x2;
+	unsigned int offset;
+	unsigned int page_offset;
+	uclock_t start_time;
+	uclock_t elapsed;
 	
-	movedata(_my_ds(), vram_buffer, vram_dpmi_selector, 0, (GFX_ROWS * GFX_COLS));
+	gfx_flip_bytes = 0;
+	if ((gfx_dirty_y2 == 0) && ((!gfx_page_flip) || (gfx_prev_y2 == 0))){
+		if (pal_Pending()){
+			if (gfx_vsync != GFX_VSYNC_OFF){
+				gfx_WaitVsync();
+			}
+			pal_Commit();
+		}
+		return;
+	}
+	start_time = uclock();
+	page_offset = 0;
+	
+	if (gfx_page_flip){
+		// Add the spans of the previous frame, which the hidden page has not 
+		// seen yet, and keep this frame's own spans for the next flip
+		if (gfx_prev_y2 != 0){
+			if (gfx_dirty_y2 == 0){
+				gfx_dirty_y1 = gfx_prev_y1;
+				gfx_dirty_y2 = gfx_prev_y2;
+				gfx_prev_y2 = 0;
+			} else {
+				i = gfx_dirty_y1;
+				gfx_dirty_y1 = gfx_prev_y1;
+				gfx_prev_y1 = i;
+				i = gfx_dirty_y2;
+				gfx_dirty_y2 = gfx_prev_y2;
+				gfx_prev_y2 = i;
+				if (gfx_prev_y1 < gfx_dirty_y1){
+					gfx_dirty_y1 = gfx_prev_y1;
+				}
+				if (gfx_prev_y2 > gfx_dirty_y2){
+					gfx_dirty_y2 = gfx_prev_y2;
+				}
+			}
+		} else {
+			gfx_prev_y1 = gfx_dirty_y1;
+			gfx_prev_y2 = gfx_dirty_y2;
+		}
+		for (row = gfx_dirty_y1; row < gfx_dirty_y2; row++){
+			own_x1 = gfx_dirty_x1[row];
+			own_x2 = gfx_dirty_x2[row];
+			if (gfx_prev_x2[row] > gfx_prev_x1[row]){
+				if (own_x2 <= own_x1){
+					gfx_dirty_x1[row] = gfx_prev_x1[row];
+					gfx_dirty_x2[row] = gfx_prev_x2[row];
+				} else {
+					if (gfx_prev_x1[row] < own_x1){
+						gfx_dirty_x1[row] = gfx_prev_x1[row];
+					}
+					if (gfx_prev_x2[row] > own_x2){
+						gfx_dirty_x2[row] = gfx_prev_x2[row];
+					}
+				}
+			}
+			gfx_prev_x1[row] = own_x1;
+			gfx_prev_x2[row] = own_x2;
+		}
+		if (gfx_hidden_page){
+			page_offset = PEGC_PAGE_1_OFFSET;
+		}
+		outportb(PEGC_DRAW_SCREEN_SEL_ADDR, gfx_hidden_page);
+	}
+	
+	// Copies to the page on display should start as the beam leaves it. 
+	// With page flipping, they are hidden, and only the page switch waits.
+	gfx_vsync_split = 0;
+	if ((gfx_vsync != GFX_VSYNC_OFF) && (!gfx_page_flip) && (gfx_dirty_y2 != 0)){
+		gfx_WaitVsync();
+		if (gfx_vsync == GFX_VSYNC_SPLIT){
+			gfx_vsync_split = 1;
+		}
+	}
+	if (!gfx_page_flip){
+		pal_Commit();
+	}
+	
+	row = gfx_dirty_y1;
+	while (row < gfx_dirty_y2){
+		if (gfx_dirty_x2[row] <= gfx_dirty_x1[row]){
+			row++;
+			continue;
+		}
+		
+		// Extend the band over all following damaged rows
+		band_y1 = row;
+		band_x1 = gfx_dirty_x1[row];
+		band_x2 = gfx_dirty_x2[row];
+		row++;
+		while ((row < gfx_dirty_y2) && (gfx_dirty_x2[row] > gfx_dirty_x1[row])){
+			if (gfx_dirty_x1[row] < band_x1){
+				band_x1 = gfx_dirty_x1[row];
+			}
+			if (gfx_dirty_x2[row] > band_x2){
+				band_x2 = gfx_dirty_x2[row];
+			}
+			row++;
+		}
+		band_y2 = row;
+		
+		if ((band_x2 - band_x1) >= (GFX_COLS / 2)){
+			offset = band_y1 * GFX_COLS;
+			gfx_Copy(offset, page_offset, (band_y2 - band_y1) * GFX_COLS);
+		} else {
+			for (i = band_y1; i < band_y2; i++){
+				offset = (i * GFX_COLS) + gfx_dirty_x1[i];
+				gfx_Copy(offset, page_offset, gfx_dirty_x2[i] - gfx_dirty_x1[i]);
+			}
+		}
+	}
+	
+	// Everything is now clean
+	for (row = gfx_dirty_y1; row < gfx_dirty_y2; row++){
+		gfx_dirty_x2[row] = 0;
+	}
+	gfx_dirty_y2 = 0;
+	
+	if (gfx_page_flip){
+		// Show the page we have just drawn
+		if (gfx_vsync != GFX_VSYNC_OFF){
+			gfx_WaitVsync();
+		}
+		pal_Commit();
+		outportb(PEGC_DISP_SCREEN_SEL_ADDR, gfx_hidden_page);
+		gfx_hidden_page = !gfx_hidden_page;
+	}
+	
+	if (gfx_flip_bytes > 0){
+		elapsed = uclock() - start_time;
+		if ((gfx_stat_presents == 0) || (gfx_flip_bytes < gfx_stat_bytes_min)){
+			gfx_stat_bytes_min = gfx_flip_bytes;
+		}
+		if (gfx_flip_bytes > gfx_stat_bytes_max){
+			gfx_stat_bytes_max = gfx_flip_bytes;
+		}
+		if ((gfx_stat_presents == 0) || (elapsed < gfx_stat_time_min)){
+			gfx_stat_time_min = elapsed;
+		}
+		if (elapsed > gfx_stat_time_max){
+			gfx_stat_time_max = elapsed;
+		}
+		gfx_stat_presents++;
+		gfx_stat_bytes += gfx_flip_bytes;
+		gfx_stat_time += elapsed;
+	}
+	
+	if (GFX_VERBOSE){
+		printf("%s.%d\t Flip copied %d bytes\n", __FILE__, __LINE__, gfx_flip_bytes);
+	}
+}
+
+unsigned long gfx_FlipCount(){
+	// Number of flips so far which copied anything to the framebuffer
+	
+	return gfx_stat_presents;
+}
+
+void gfx_FlipStats(){
+	// Print a summary of every gfx_Flip() so far; times are in uclock() ticks
+	// and microseconds
+	
+	if (gfx_stat_presents == 0){
+		printf("Presents: none\n");
+		return;
+	}
+	printf("Presents: %lu, %lu bytes\n", gfx_stat_presents, gfx_stat_bytes);
+	printf("- Bytes: min %u, avg %lu, max %u\n", gfx_stat_bytes_min, gfx_stat_bytes / gfx_stat_presents, gfx_stat_bytes_max);
+	printf("- Ticks: min %lu, avg %lu, max %lu\n", 
+		(unsigned long) gfx_stat_time_min, (unsigned long) (gfx_stat_time / gfx_stat_presents), (unsigned long) gfx_stat_time_max);
+	printf("- Time: min %ldus, avg %ldus, max %ldus\n", 
+		(long) ((gfx_stat_time_min * 1000000) / UCLOCKS_PER_SEC), 
+		(long) (((gfx_stat_time / gfx_stat_presents) * 1000000) / UCLOCKS_PER_SEC), 
+		(long) ((gfx_stat_time_max * 1000000) / UCLOCKS_PER_SEC));
+	printf("- Vsync: %lu blanks, %ldus waiting, %lu timeouts\n", 
+		gfx_stat_blanks, (long) ((gfx_stat_wait * 1000000) / UCLOCKS_PER_SEC), gfx_stat_timeouts);
+}
+
+void gfx_SetPageFlip(unsigned char enable){
+	// Enable or disable page flipping, using both pages of dual page mode.
+	// The whole screen is redrawn to both pages on the next two flips.
+	
+	int row;
+	
+	for (row = 0; row < GFX_ROWS; row++){
+		gfx_prev_x2[row] = 0;
+	}
+	gfx_prev_y2 = 0;
+	gfx_page_flip = enable;
+	gfx_hidden_page = 1;
+	outportb(PEGC_DRAW_SCREEN_SEL_ADDR, 0x00);
+	outportb(PEGC_DISP_SCREEN_SEL_ADDR, 0x00);
+	gfx_Dirty(0, 0, GFX_COLS - 1, GFX_ROWS - 1);
+}
+
+void gfx_SetVsync(unsigned char mode){
+	// Choose whether gfx_Flip() waits for vertical blank; see GFX_VSYNC_*
+	
+	gfx_vsync = mode;
+}
+
+unsigned int gfx_FlipBytes(){
+	// Number of bytes copied to the framebuffer by the last gfx_Flip()
+	
+	return gfx_flip_bytes;
 }
 
 int gfx_GetXYaddr(int x, int y){
@@ -203,318 +581,665 @@ int gfx_GetXYaddr(int x, int y){
 	return addr;
 }
 
+static int gfx_ClipBox(int *x1, int *y1, int *x2, int *y2){
+	// Put the corners of a box in order and clip it to the screen
+	// Returns 0 if none of the box is onscreen
+	
+	int temp;
+	
+	// Flip y, if it is supplied reversed
+	if (*y1 > *y2){
+		temp = *y1;
+		*y1 = *y2;
+		*y2 = temp;
+	}
+	// Flip x, if it is supplied reversed
+	if (*x1 > *x2){
+		temp = *x1;
+		*x1 = *x2;
+		*x2 = temp;
+	}
+	if ((*x2 < 0) || (*y2 < 0) || (*x1 >= GFX_COLS) || (*y1 >= GFX_ROWS)){
+		return 0;
+	}
+	if (*x1 < 0){
+		*x1 = 0;
+	}
+	if (*y1 < 0){
+		*y1 = 0;
+	}
+	if (*x2 >= GFX_COLS){
+		*x2 = GFX_COLS - 1;
+	}
+	if (*y2 >= GFX_ROWS){
+		*y2 = GFX_ROWS - 1;
+	}
+	return 1;
+}
+
+static void gfx_SpanFill(unsigned char *dst, int n, unsigned int colour){
+	// Fill n pixels of a row with a colour, which is repeated in all 4 bytes.
+	// Single bytes up to a 4 byte boundary, whole words, then any last bytes.
+	
+	unsigned int *word;
+	
+	while ((n > 0) && ((unsigned int) dst & 3)){
+		*dst++ = colour;
+		n--;
+	}
+	word = (unsigned int *) dst;
+	while (n >= 4){
+		*word++ = colour;
+		n -= 4;
+	}
+	dst = (unsigned char *) word;
+	while (n > 0){
+		*dst++ = colour;
+		n--;
+	}
+}
+
+static void gfx_SpanMask(unsigned char *dst, int n, unsigned int colour, unsigned int mask){
+	// As gfx_SpanFill(), but only the bytes set in mask are written.
+	// The low byte of the mask is for the first pixel; it is rotated along
+	// with each single byte, so it always lines up with the next pixel.
+	
+	unsigned int *word;
+	
+	while ((n > 0) && ((unsigned int) dst & 3)){
+		if (mask & 0xFF){
+			*dst = colour;
+		}
+		dst++;
+		n--;
+		mask = (mask >> 8) | (mask << 24);
+	}
+	word = (unsigned int *) dst;
+	while (n >= 4){
+		*word = (*word & ~mask) | (colour & mask);
+		word++;
+		n -= 4;
+	}
+	dst = (unsigned char *) word;
+	while (n > 0){
+		if (mask & 0xFF){
+			*dst = colour;
+		}
+		dst++;
+		n--;
+		mask = (mask >> 8) | (mask << 24);
+	}
+}
+
+static int gfx_ClipImage(int *x, int *y, int width, int height, int *src_x, int *src_y, int *clip_width, int *clip_height){
+	// Clip an image of width x height, drawn at x,y, to the screen
+	// x,y become the first onscreen pixel, src_x,src_y the matching pixel of the image
+	// Returns 0 if none of the image is onscreen
+	
+	*src_x = 0;
+	*src_y = 0;
+	*clip_width = width;
+	*clip_height = height;
+	
+	if (*x < 0){
+		// Negative values start offscreen at the left
+		*src_x = -*x;
+		*clip_width += *x;
+		*x = 0;
+	}
+	if ((*x + *clip_width) > GFX_COLS){
+		// Positive values get clipped at the right
+		*clip_width = GFX_COLS - *x;
+	}
+	if (*y < 0){
+		// Negative values start off the top of the screen
+		*src_y = -*y;
+		*clip_height += *y;
+		*y = 0;
+	}
+	if ((*y + *clip_height) > GFX_ROWS){
+		// Positive values get clipped at the bottom of the screen
+		*clip_height = GFX_ROWS - *y;
+	}
+	if ((*clip_width <= 0) || (*clip_height <= 0)){
+		return 0;
+	}
+	return 1;
+}
+
 int gfx_Bitmap(int x, int y, bmpdata_t *bmpdata){
 	// Load bitmap data into vram_buffer at coords x,y
 	// X or Y can be negative which starts the first X or Y
-	// rows or columns of the bitmap offscreen - i.e. they are clipped
-	//
-	// Bitmaps wider or taller than the screen are UNSUPPORTED
-	
-	int row, col;			//  x and y position counters
-	int start_addr;		// The first pixel
-	int width_bytes;		// Number of bytes in one row of the image
-	int skip_cols;			// Skip first or last pixels of a row if the image is partially offscreen
-	int skip_bytes;
-	int skip_rows;		// Skip this number of rows if the image is patially offscreen
-	int total_rows	;		// Total number of rows to read in clip mode
+	// rows or columns of the bitmap offscreen - i.e. they are clipped,
+	// as are any rows or columns past the right or bottom of the screen.
+	
+	int row;				// y position counter
+	int src_x, src_y;		// First visible column and row of the bitmap
+	int width_bytes;		// Number of visible bytes in one row of the image
+	int total_rows;		// Number of visible rows of the image
 	unsigned char *ptr;	// Pointer to current location in bmp pixel buffer
 	
-	if (x < 0){
-		// Negative values start offscreen at the left
-		skip_cols = x;
-	} else {
-		if ((x + bmpdata->width) > GFX_COLS){
-			// Positive values get clipped at the right
-			skip_cols = x + bmpdata->width - GFX_COLS;
-		} else {
-			// Full width can fit on screen
-			skip_cols = 0;
-		}
+	if (bmpdata->pixels == NULL){
+		// Nothing to draw, e.g. a UI bitmap which could not be read
+		return -1;
+	}
+	if (!gfx_ClipImage(&x, &y, bmpdata->width, bmpdata->height, &src_x, &src_y, &width_bytes, &total_rows)){
+		// Entirely offscreen
+		return 0;
 	}
 	
-	if (y < 0){
-		// Negative values start off the top of the screen
-		skip_rows = y;
-	} else {
-		if ((y + bmpdata->height) > GFX_ROWS){
-			// Positive values get clipped at the bottom of the screen
-			skip_rows = y + bmpdata->height - GFX_ROWS;
-		} else {
-			// Full height can fit on screen
-			skip_rows = 0;
-		}
+	gfx_Dirty(x, y, x + width_bytes - 1, y + total_rows - 1);
+	
+	// Set starting pixel address
+	vram = vram_buffer + (y * GFX_COLS) + x;
+	
+	// Set starting point in pixel buffer
+	ptr = (unsigned char*) bmpdata->pixels + (src_y * bmpdata->width) + src_x;
+	
+	// memcpy entire rows at a time, subject to clipping sizes
+	for(row = 0; row < total_rows; row++){
+		memcpy(vram, ptr, width_bytes);
+		// Go to next row in vram buffer
+		vram += GFX_COLS;
+		// Increment pointer to next row in pixel buffer
+		ptr += bmpdata->width;
 	}
+	return 0;
+}
+
+int gfx_BitmapPart(int x, int y, bmpdata_t *bmpdata, int src_x, int src_y, int width, int height){
+	// Draw just a width x height area of a bitmap, starting from src_x,src_y
+	// of the bitmap, into vram_buffer at coords x,y - clipped as for gfx_Bitmap()
+	
+	int row;
+	int skip_x, skip_y;	// Columns and rows clipped off the top left
+	int clip_width, clip_height;
+	unsigned char *ptr;
 	
-	if ((skip_cols == 0) && (skip_rows == 0)){
+	if (bmpdata->pixels == NULL){
+		return -1;
+	}
+	
+	// Keep the area within the bitmap
+	if ((src_x < 0) || (src_y < 0)){
+		return -1;
+	}
+	if ((src_x + width) > bmpdata->width){
+		width = bmpdata->width - src_x;
+	}
+	if ((src_y + height) > bmpdata->height){
+		height = bmpdata->height - src_y;
+	}
+	
+	if (!gfx_ClipImage(&x, &y, width, height, &skip_x, &skip_y, &clip_width, &clip_height)){
+		return 0;
+	}
+	gfx_Dirty(x, y, x + clip_width - 1, y + clip_height - 1);
+	
+	vram = vram_buffer + (y * GFX_COLS) + x;
+	ptr = (unsigned char*) bmpdata->pixels + ((src_y + skip_y) * bmpdata->width) + src_x + skip_x;
+	for (row = 0; row < clip_height; row++){
+		memcpy(vram, ptr, clip_width);
+		vram += GFX_COLS;
+		ptr += bmpdata->width;
+	}
+	return 0;
+}
 
-		// Case 1 - bitmap fits entirely onscreen
-		width_bytes = bmpdata->width * bmpdata->bytespp;
-		
-		// Get starting pixel address
-		start_addr = gfx_GetXYaddr(x, y);
-		if (start_addr < 0){
-			if (GFX_VERBOSE){
-				printf("%s.%d\t Unable to set VRAM buffer start address\n", __FILE__, __LINE__);
+int gfx_BitmapKeyed(int x, int y, bmpdata_t *bmpdata, unsigned char key){
+	// As gfx_Bitmap(), but pixels of the key colour are not drawn, so 
+	// whatever is already in vram_buffer shows through them.
+	
+	int row, col;			// x and y position counters
+	int src_x, src_y;		// First visible column and row of the bitmap
+	int width;			// Number of visible pixels in one row of the image
+	int total_rows;		// Number of visible rows of the image
+	unsigned char *ptr;	// Pointer to current location in bmp pixel buffer
+	
+	if (bmpdata->pixels == NULL){
+		return -1;
+	}
+	if (!gfx_ClipImage(&x, &y, bmpdata->width, bmpdata->height, &src_x, &src_y, &width, &total_rows)){
+		return 0;
+	}
+	
+	gfx_Dirty(x, y, x + width - 1, y + total_rows - 1);
+	
+	vram = vram_buffer + (y * GFX_COLS) + x;
+	ptr = (unsigned char*) bmpdata->pixels + (src_y * bmpdata->width) + src_x;
+	
+	for(row = 0; row < total_rows; row++){
+		for(col = 0; col < width; col++){
+			if (ptr[col] != key){
+				vram[col] = ptr[col];
 			}
-			return -1;
-		}
-		// Set starting pixel address
-		vram = vram_buffer + start_addr;
-		
-		// memcpy entire rows at a time
-		ptr = (unsigned char*) bmpdata->pixels; 
-		for(row = 0; row < bmpdata->height; row++){
-			memcpy(vram, ptr, width_bytes);
-			
-			// Go to next row in vram_buffer
-			vram += GFX_COLS;
-			
-			// Increment point
-			ptr += bmpdata->width;
 		}
+		vram += GFX_COLS;
+		ptr += bmpdata->width;
+	}
+	return 0;
+}
+
+int gfx_SaveRect(int x, int y, int width, int height, unsigned char *buffer){
+	// Copy a width x height area of vram_buffer at x,y out to a buffer, 
+	// one row after another. Any part of the area which is offscreen is 
+	// left as it is in the buffer.
+	
+	int row;
+	int src_x, src_y;
+	int clip_width, clip_height;
+	unsigned char *ptr;
+	
+	if (!gfx_ClipImage(&x, &y, width, height, &src_x, &src_y, &clip_width, &clip_height)){
 		return 0;
-		
-	} else {
-		// Case 2 - image is either vertically or horizontally partially offscreen		
-		if (skip_cols < 0){
-			x = x + abs(skip_cols);
+	}
+	vram = vram_buffer + (y * GFX_COLS) + x;
+	ptr = buffer + (src_y * width) + src_x;
+	for (row = 0; row < clip_height; row++){
+		memcpy(ptr, vram, clip_width);
+		vram += GFX_COLS;
+		ptr += width;
+	}
+	return 0;
+}
+
+int gfx_RestoreRect(int x, int y, int width, int height, unsigned char *buffer){
+	// Copy a buffer of width x height pixels, as saved by gfx_SaveRect(), 
+	// back into vram_buffer at x,y
+	
+	int row;
+	int src_x, src_y;
+	int clip_width, clip_height;
+	unsigned char *ptr;
+	
+	if (!gfx_ClipImage(&x, &y, width, height, &src_x, &src_y, &clip_width, &clip_height)){
+		return 0;
+	}
+	gfx_Dirty(x, y, x + clip_width - 1, y + clip_height - 1);
+	vram = vram_buffer + (y * GFX_COLS) + x;
+	ptr = buffer + (src_y * width) + src_x;
+	for (row = 0; row < clip_height; row++){
+		memcpy(vram, ptr, clip_width);
+		vram += GFX_COLS;
+		ptr += width;
+	}
+	return 0;
+}
+
+int gfx_ScrollRect(int x1, int y1, int x2, int y2, int dy){
+	// Move the contents of a box of vram_buffer up (dy < 0) or down (dy > 0)
+	// by dy rows. Rows moved out of the box are lost, and the rows uncovered
+	// at the other end are left as they were, for the caller to redraw.
+	
+	int row;
+	int width;
+	int rows;
+	unsigned char *src, *dst;
+	
+	if (!gfx_ClipBox(&x1, &y1, &x2, &y2)){
+		return 0;
+	}
+	rows = (y2 - y1 + 1) - abs(dy);
+	if ((dy == 0) || (rows <= 0)){
+		return 0;
+	}
+	gfx_Dirty(x1, y1, x2, y2);
+	width = x2 - x1 + 1;
+	
+	if (dy < 0){
+		// Moving up; copy from the top down
+		dst = vram_buffer + (y1 * GFX_COLS) + x1;
+		src = dst - (dy * GFX_COLS);
+		for (row = 0; row < rows; row++){
+			memcpy(dst, src, width);
+			dst += GFX_COLS;
+			src += GFX_COLS;
 		}
-		if (skip_rows < 0){
-			y = y + abs(skip_rows);
+	} else {
+		// Moving down; copy from the bottom up
+		dst = vram_buffer + (y2 * GFX_COLS) + x1;
+		src = dst - (dy * GFX_COLS);
+		for (row = 0; row < rows; row++){
+			memcpy(dst, src, width);
+			dst -= GFX_COLS;
+			src -= GFX_COLS;
 		}
-		
-		// Get starting pixel address - at the new coordinates
-		start_addr = gfx_GetXYaddr(x, y);
-		if (start_addr < 0){
+	}
+	return 0;
+}
+
+int gfx_BackgroundSave(){
+	// Keep a copy of the whole of vram_buffer as the background layer
+	
+	if (gfx_background == NULL){
+		gfx_background = (unsigned char *) malloc(GFX_ROWS * GFX_COLS);
+		if (gfx_background == NULL){
 			if (GFX_VERBOSE){
-				printf("%s.%d\t Unable to set VRAM buffer start address\n", __FILE__, __LINE__);
+				printf("%s.%d\t Unable to allocate memory for background layer\n", __FILE__, __LINE__);	
 			}
-			return -1;
-		}
-		
-		// Set starting pixel address
-		vram = vram_buffer + start_addr;
-		
-		// Set starting point in pixel buffer
-		ptr = (unsigned char*) bmpdata->pixels;
-		
-		// Default to writing a full row of pixels, unless....
-		width_bytes = (bmpdata->width * bmpdata->bytespp) ;
-		
-		// Default to writing all rows, unless....
-		total_rows = bmpdata->height;
-		
-		// If we are starting offscreen at the y axis, jump that many rows into the data
-		if (skip_rows < 0){
-			ptr += abs(skip_rows) * bmpdata->width;
-			total_rows = bmpdata->height - abs(skip_rows);
-		}
-		if (skip_rows > 0){
-			total_rows = bmpdata->height - abs(skip_rows);
+			return GFX_ERR_MALLOC;
 		}
+	}
+	memcpy(gfx_background, vram_buffer, GFX_ROWS * GFX_COLS);
+	return 0;
+}
+
+int gfx_BackgroundRestore(int x1, int y1, int x2, int y2){
+	// Copy a box of the background layer back over vram_buffer
+	
+	int row;
+	int width;
+	unsigned char *src;
+	
+	if (gfx_background == NULL){
+		return GFX_ERR_NO_BACKGROUND;
+	}
+	if (!gfx_ClipBox(&x1, &y1, &x2, &y2)){
+		return 0;
+	}
+	gfx_Dirty(x1, y1, x2, y2);
+	width = x2 - x1 + 1;
+	if (width == GFX_COLS){
+		// Whole rows are contiguous
+		memcpy(vram_buffer + (y1 * GFX_COLS), gfx_background + (y1 * GFX_COLS), (y2 - y1 + 1) * GFX_COLS);
+		return 0;
+	}
+	vram = vram_buffer + (y1 * GFX_COLS) + x1;
+	src = gfx_background + (y1 * GFX_COLS) + x1;
+	for (row = y1; row <= y2; row++){
+		memcpy(vram, src, width);
+		vram += GFX_COLS;
+		src += GFX_COLS;
+	}
+	return 0;
+}
+
+void gfx_BackgroundFree(){
+	// Release the background layer
 	
-		if (skip_cols != 0){
-			width_bytes = (bmpdata->width * bmpdata->bytespp) - (abs(skip_cols) * bmpdata->bytespp);
+	if (gfx_background != NULL){
+		free(gfx_background);
+		gfx_background = NULL;
+	}
+}
+
+int gfx_SpriteFromBitmap(bmpdata_t *bmpdata, spritedata_t *sprite, unsigned char key){
+	// Run length encode a bitmap into a sprite, leaving out all pixels of 
+	// the key colour. See gfx.h for the layout of the runs.
+	//
+	// The first pass only counts the bytes needed, the second writes the runs.
+	
+	int pass;
+	int row, col;
+	int skip, count;
+	unsigned int size;
+	unsigned char *ptr;
+	unsigned char *data;
+	
+	if (bmpdata->pixels == NULL){
+		return -1;
+	}
+	sprite->width = bmpdata->width;
+	sprite->height = bmpdata->height;
+	sprite->data = NULL;
+	sprite->row_offset = (unsigned int *) malloc(bmpdata->height * sizeof(unsigned int));
+	if (sprite->row_offset == NULL){
+		if (GFX_VERBOSE){
+			printf("%s.%d\t Unable to allocate sprite row offsets\n", __FILE__, __LINE__);
 		}
-		
-		// memcpy entire rows at a time, subject to clipping sizes
-		for(row = 0; row < total_rows; row++){
-			if (skip_cols < 0){
-				memcpy(vram, ptr + abs(skip_cols), width_bytes);
-			} else {
-				memcpy(vram, ptr, width_bytes);
+		return -1;
+	}
+	
+	data = NULL;
+	for (pass = 0; pass < 2; pass++){
+		size = 0;
+		ptr = (unsigned char*) bmpdata->pixels;
+		for (row = 0; row < bmpdata->height; row++){
+			sprite->row_offset[row] = size;
+			col = 0;
+			while (col < bmpdata->width){
+				// Transparent pixels before the next run
+				skip = 0;
+				while ((col < bmpdata->width) && (ptr[col] == key)){
+					skip++;
+					col++;
+				}
+				if (col == bmpdata->width){
+					break;
+				}
+				// Skips too long for one byte are split into empty runs
+				while (skip > GFX_SPRITE_MAX_RUN){
+					if (data != NULL){
+						data[size] = GFX_SPRITE_MAX_RUN;
+						data[size + 1] = 0;
+					}
+					size += 2;
+					skip -= GFX_SPRITE_MAX_RUN;
+				}
+				// Opaque pixels of the run
+				count = 0;
+				while ((col + count < bmpdata->width) && (ptr[col + count] != key) && (count < GFX_SPRITE_MAX_RUN)){
+					count++;
+				}
+				if (data != NULL){
+					data[size] = skip;
+					data[size + 1] = count;
+					memcpy(data + size + 2, ptr + col, count);
+				}
+				size += 2 + count;
+				col += count;
+			}
+			// End of row
+			if (data != NULL){
+				data[size] = 0;
+				data[size + 1] = 0;
 			}
-			// Go to next row in vram buffer
-			vram += GFX_COLS;
-			// Increment pointer to next row in pixel buffer
+			size += 2;
 			ptr += bmpdata->width;
 		}
+		if (pass == 0){
+			data = (unsigned char *) malloc(size);
+			if (data == NULL){
+				if (GFX_VERBOSE){
+					printf("%s.%d\t Unable to allocate %d bytes for sprite runs\n", __FILE__, __LINE__, size);
+				}
+				free(sprite->row_offset);
+				sprite->row_offset = NULL;
+				return -1;
+			}
+		}
+	}
+	sprite->data = data;
+	sprite->size = size;
+	
+	if (GFX_VERBOSE){
+		printf("%s.%d\t Sprite %dx%d encoded to %d bytes\n", __FILE__, __LINE__, sprite->width, sprite->height, sprite->size);
+	}
+	return 0;
+}
+
+static int gfx_SpriteDraw(int x, int y, spritedata_t *sprite, int fill){
+	// Draw a run length encoded sprite into vram_buffer at coords x,y
+	// Only the opaque runs are touched; clipped as for gfx_Bitmap().
+	// If fill is a palette entry, every opaque pixel is drawn in it, 
+	// otherwise (fill < 0) the pixels of the sprite are copied.
+	
+	int row;
+	int src_x, src_y;		// First visible column and row of the sprite
+	int width, total_rows;	// Visible size of the sprite
+	int col;				// Column of the sprite at the start of this run
+	int first, last;		// Visible part of this run, exclusive of last
+	int count;
+	unsigned char *run;
+	
+	if (!gfx_ClipImage(&x, &y, sprite->width, sprite->height, &src_x, &src_y, &width, &total_rows)){
 		return 0;
 	}
-	return -1;
+	
+	gfx_Dirty(x, y, x + width - 1, y + total_rows - 1);
+	
+	// Start of the row in vram_buffer, as if the sprite were not clipped on the left
+	vram = vram_buffer + (y * GFX_COLS) + x - src_x;
+	
+	for (row = src_y; row < (src_y + total_rows); row++){
+		run = sprite->data + sprite->row_offset[row];
+		col = 0;
+		while ((run[0] != 0) || (run[1] != 0)){
+			col += run[0];
+			count = run[1];
+			first = col;
+			last = col + count;
+			if (first < src_x){
+				first = src_x;
+			}
+			if (last > (src_x + width)){
+				last = src_x + width;
+			}
+			if (first < last){
+				if (fill < 0){
+					memcpy(vram + first, run + 2 + (first - col), last - first);
+				} else {
+					memset(vram + first, fill, last - first);
+				}
+			}
+			col += count;
+			run += 2 + count;
+		}
+		vram += GFX_COLS;
+	}
+	return 0;
+}
+
+int gfx_Sprite(int x, int y, spritedata_t *sprite){
+	// Draw a run length encoded sprite into vram_buffer at coords x,y
+	
+	return gfx_SpriteDraw(x, y, sprite, -1);
+}
+
+int gfx_SpriteSolid(int x, int y, spritedata_t *sprite, unsigned char palette){
+	// Draw the shape of a sprite into vram_buffer at coords x,y, 
+	// with all of its opaque pixels in a single palette entry colour
+	
+	return gfx_SpriteDraw(x, y, sprite, palette);
+}
+
+void gfx_SpriteDestroy(spritedata_t *sprite){
+	// Destroy a spritedata structure and free any memory allocated
+	
+	if (sprite->row_offset != NULL){
+		free(sprite->row_offset);
+	}
+	if (sprite->data != NULL){
+		free(sprite->data);
+	}
+	free(sprite);
 }
 
 int gfx_Box(int x1, int y1, int x2, int y2, unsigned char palette){
-        // Draw a box outline with a given palette entry colour
-        int row, col;		//  x and y position counters
-        int start_addr; 	// The first pixel, at x1,y1
-        int temp;		// Holds either x or y, if we need to flip them
-        int step;
-        
-        // Flip y, if it is supplied reversed
-        if (y1>y2){
-                temp=y1;
-                y1=y2;
-                y2=temp;
-        }
-        // Flip x, if it is supplied reversed
-        if (x1>x2){
-                temp=x1;
-                x1=x2;
-                x2=temp;
-        }
-        // Clip the x range to the edge of the screen
-        if (x2>GFX_COLS){
-                x2 = GFX_COLS - 1;
-        }
-        // Clip the y range to the bottom of the screen
-        if (y2>GFX_ROWS){
-                y2 = GFX_ROWS - 1;
-        }
-        // Get starting pixel address
-        start_addr = gfx_GetXYaddr(x1, y1);
-        if (start_addr < 0){
-                if (GFX_VERBOSE){
-                        printf("%s.%d\t Unable to set VRAM start address\n", __FILE__, __LINE__);
-                }
-                return -1;
-        }
-        // Set starting pixel address
-        vram = vram_buffer + start_addr;
-        
-        // Step to next row in vram
-        step = (GFX_COLS - x2) + x1;
-
-        // Draw top
-        for(col = x1; col <= x2; col++){
-                *vram = palette;
-                // Move to next pixel in line
-                vram++;
-        }
-        // Jump to next line down and start of left side
-        vram += (GFX_COLS - x2) + (x1 - 1);
-        
-        // Draw sides
-        for(row = y1; row < (y2-1); row++){     
-                *vram = palette;
-                vram += (x2 - x1);
-                *vram = palette;
-                vram += step;
-        }
-        
-        // Draw bottom
-        for(col = x1; col <= x2; col++){
-                *vram = palette;
-                // Move to next pixel in line
-                vram++;
-        }
-        
-        return 0;
+	// Draw a box outline with a given palette entry colour
+	// Edges which are clipped offscreen are not drawn.
+	
+	int row;				// y position counter
+	int width;			// Pixels in each row of the box
+	int left, right;		// Unclipped x of each side
+	int top, bottom;		// Unclipped y of the top and bottom
+	unsigned int colour;	// Palette entry, in every byte of a word
+	
+	left = (x1 < x2) ? x1 : x2;
+	right = (x1 < x2) ? x2 : x1;
+	top = (y1 < y2) ? y1 : y2;
+	bottom = (y1 < y2) ? y2 : y1;
+	if (!gfx_ClipBox(&x1, &y1, &x2, &y2)){
+		return 0;
+	}
+	gfx_Dirty(x1, y1, x2, y2);
+	
+	colour = palette * 0x01010101U;
+	width = x2 - x1 + 1;
+	
+	// Draw top
+	if (y1 == top){
+		gfx_SpanFill(vram_buffer + (y1 * GFX_COLS) + x1, width, colour);
+	}
+	
+	// Draw sides
+	vram = vram_buffer + (y1 * GFX_COLS);
+	for(row = y1; row <= y2; row++){
+		if (x1 == left){
+			vram[x1] = palette;
+		}
+		if (x2 == right){
+			vram[x2] = palette;
+		}
+		vram += GFX_COLS;
+	}
+	
+	// Draw bottom
+	if (y2 == bottom){
+		gfx_SpanFill(vram_buffer + (y2 * GFX_COLS) + x1, width, colour);
+	}
+	return 0;
 }
 
 int gfx_BoxFill(int x1, int y1, int x2, int y2, unsigned char palette){
-        // Draw a box, fill it with a given palette entry
-        int row, col;		//  x and y position counters
-        int start_addr;	// The first pixel, at x1,y1
-        int temp;		// Holds either x or y, if we need to flip them
-        int step;
-        
-        // Flip y, if it is supplied reversed
-        if (y1>y2){
-                temp=y1;
-                y1=y2;
-                y2=temp;
-        }
-        // Flip x, if it is supplied reversed
-        if (x1>x2){
-                temp=x1;
-                x1=x2;
-                x2=temp;
-        }
-        // Clip the x range to the edge of the screen
-        if (x2>GFX_COLS){
-                x2 = GFX_COLS - 1;
-        }
-        // Clip the y range to the bottom of the screen
-        if (y2>GFX_ROWS){
-                y2 = GFX_ROWS - 1;
-        }
-        // Get starting pixel address
-        start_addr = gfx_GetXYaddr(x1, y1);
-        if (start_addr < 0){
-                if (GFX_VERBOSE){
-                        printf("%s.%d\t Unable to set VRAM start address\n", __FILE__, __LINE__);
-                }
-                return -1;
-        }
-        // Set starting pixel address
-        vram = vram_buffer + start_addr;
-        
-        // Step to next row in vram
-        step = (GFX_COLS - x2) + (x1 - 1);
-        
-        // Starting from the first row (y1)
-        for(row = y1; row <= y2; row++){
-                // Starting from the first column (x1)
-                for(col = x1; col <= x2; col++){
-                        *vram = palette;
-                        vram++;
-                }
-                vram += step;
-        }
-        return 0;
+	// Draw a box, fill it with a given palette entry
+	
+	int row;				// y position counter
+	int width;			// Pixels in each row of the box
+	unsigned int colour;	// Palette entry, in every byte of a word
+	
+	if (!gfx_ClipBox(&x1, &y1, &x2, &y2)){
+		return 0;
+	}
+	gfx_Dirty(x1, y1, x2, y2);
+	
+	colour = palette * 0x01010101U;
+	width = x2 - x1 + 1;
+	
+	// Set starting pixel address
+	vram = vram_buffer + (y1 * GFX_COLS) + x1;
+	
+	// Starting from the first row (y1)
+	for(row = y1; row <= y2; row++){
+		gfx_SpanFill(vram, width, colour);
+		vram += GFX_COLS;
+	}
+	return 0;
 }
 
 int gfx_BoxFillTranslucent(int x1, int y1, int x2, int y2, unsigned char palette){
-        // Draw a box, fill it with a given palette entry - every 2nd pixel, so that
-        // it looks semi-transparent.
-        
-        int row, col;	// x and y position counters
-        int start_addr;	// The first pixel, at x1,y1
-        int temp;		// Holds either x or y, if we need to flip them
-        int step;
-        int flip;		// toggles display of every other pixel on/off
-        
-        // Flip y, if it is supplied reversed
-        if (y1>y2){
-                temp=y1;
-                y1=y2;
-                y2=temp;
-        }
-        // Flip x, if it is supplied reversed
-        if (x1>x2){
-                temp=x1;
-                x1=x2;
-                x2=temp;
-        }
-        // Clip the x range to the edge of the screen
-        if (x2>GFX_COLS){
-                x2 = GFX_COLS - 1;
-        }
-        // Clip the y range to the bottom of the screen
-        if (y2>GFX_ROWS){
-                y2 = GFX_ROWS - 1;
-        }
-        // Get starting pixel address
-        start_addr = gfx_GetXYaddr(x1, y1);
-        if (start_addr < 0){
-                if (GFX_VERBOSE){
-                        printf("%s.%d\t Unable to set VRAM start address\n", __FILE__, __LINE__);
-                }
-                return -1;
-        }
-        // Set starting pixel address
-        vram = vram_buffer + start_addr;
-        
-        // Step to next row in vram
-        step = (GFX_COLS - x2) + (x1 - 1);
-        
-        flip = 0;
-        
-        // Starting from the first row (y1)
-        for(row = y1; row <= y2; row++){
-			// Starting from the first column (x1)
-			for(col = x1; col <= x2; col++){
-				// Only every other pixel
-				if (flip){
-					*vram = palette;
-				}
-				vram++;
-				flip = !flip;
-			}
-			vram += step;
-        }
-        return 0;
+	// Draw a box, fill it with a given palette entry - every 2nd pixel, so that
+	// it looks semi-transparent.
+	//
+	// The pixels drawn are those where x + y is even, so the checkerboard lines up
+	// between overlapping boxes.
+	
+	int row;				// y position counter
+	int width;			// Pixels in each row of the box
+	unsigned int colour;	// Palette entry, in every byte of a word
+	unsigned int mask;		// Pixels to draw in each word of this row
+	
+	if (!gfx_ClipBox(&x1, &y1, &x2, &y2)){
+		return 0;
+	}
+	gfx_Dirty(x1, y1, x2, y2);
+	
+	colour = palette * 0x01010101U;
+	width = x2 - x1 + 1;
+	
+	// Whether the first pixel of the first row is drawn
+	mask = ((x1 + y1) & 1) ? 0xFF00FF00 : 0x00FF00FF;
+	
+	// Set starting pixel address
+	vram = vram_buffer + (y1 * GFX_COLS) + x1;
+	
+	// Starting from the first row (y1)
+	for(row = y1; row <= y2; row++){
+		gfx_SpanMask(vram, width, colour, mask);
+		vram += GFX_COLS;
+		mask = ~mask;
+	}
+	return 0;
 }
 
 int gfx_HasMemoryHole(){
@@ -534,76 +1259,141 @@ int gfx_HasMemoryHole(){
 	}
 }
 
+void gfx_TextStyleInit(textstyle_t *style){
+	// Set a text style to the defaults used by gfx_Puts(); opaque, 
+	// in the font's own colours and clipped only to the screen.
+	
+	style->mode = GFX_TEXT_OPAQUE;
+	style->fg_colour = GFX_TEXT_FONT_COLOUR;
+	style->clip_x1 = 0;
+	style->clip_y1 = 0;
+	style->clip_x2 = GFX_COLS - 1;
+	style->clip_y2 = GFX_ROWS - 1;
+}
+
+int gfx_TextWidth(fontdata_t *fontdata, char *c){
+	// Width, in pixels, of a string of text in a given font
+	
+	return fontdata->width * strlen(c);
+}
+
 int gfx_Puts(int x, int y, fontdata_t *fontdata, char *c){
 	// Put a string of text on the screen, at a set of coordinates
 	// using a specific font.
+	
+	textstyle_t style;
+	
+	gfx_TextStyleInit(&style);
+	return gfx_PutsStyle(x, y, fontdata, &style, c);
+}
+
+int gfx_PutsStyle(int x, int y, fontdata_t *fontdata, textstyle_t *style, char *c){
+	// Put a string of text on the screen, at a set of coordinates
+	// using a specific font, drawn and clipped as set in a text style.
 	//
-	// Note: We only support 8px and 16px wide fonts.
+	// Glyphs are drawn from the expanded masks of the font, which index
+	// a table of the colours for this style. Entry 0 is the background.
 	
-	unsigned int	start_offset;
-	unsigned int	row_offset;
+	int				len;
+	int				clip_x1, clip_y1, clip_x2, clip_y2;
+	int				first, last;	// First and last visible symbols of the string
+	int				pos;
+	int				glyph_x;		// Screen x of the current symbol
+	int				col1, col2;	// Visible columns of the current symbol
+	int				row, col;
+	unsigned char	i;
 	unsigned char	font_symbol;
-	unsigned char	font_row;
-	unsigned char	i, w;
-	unsigned char	pos;
-	unsigned char	*src, *dst;
+	unsigned char	colours[BMP_FONT_MAX_PLANES + 1];
+	unsigned char	*mask, *dst;
 	
-	// Empty string
-	if (strlen(c) < 1){
-		return GFX_TEXT_OK;
-	}
-	
-	// Calculate starting address
-	start_offset = gfx_GetXYaddr(x, y);
-	if (start_offset < 0){
+	if (fontdata->masks == NULL){
 		if (GFX_VERBOSE){
-			printf("%s.%d\t Unable to set VRAM start offset\n", __FILE__, __LINE__);
+			printf("%s.%d\t Error, font has no glyph masks\n", __FILE__, __LINE__);	
 		}
-		return -1;
+		return GFX_TEXT_INVALID;
 	}
 	
-	// Reposition write position
-	vram = vram_buffer + start_offset;
+	len = strlen(c);
+	
+	// Clip the whole string to the style and the screen
+	clip_x1 = (style->clip_x1 > x) ? style->clip_x1 : x;
+	clip_y1 = (style->clip_y1 > y) ? style->clip_y1 : y;
+	clip_x2 = (style->clip_x2 < (x + (fontdata->width * len) - 1)) ? style->clip_x2 : (x + (fontdata->width * len) - 1);
+	clip_y2 = (style->clip_y2 < (y + fontdata->height - 1)) ? style->clip_y2 : (y + fontdata->height - 1);
+	if (clip_x1 < 0){
+		clip_x1 = 0;
+	}
+	if (clip_y1 < 0){
+		clip_y1 = 0;
+	}
+	if (clip_x2 >= GFX_COLS){
+		clip_x2 = GFX_COLS - 1;
+	}
+	if (clip_y2 >= GFX_ROWS){
+		clip_y2 = GFX_ROWS - 1;
+	}
+	if ((len < 1) || (clip_x1 > clip_x2) || (clip_y1 > clip_y2)){
+		// Empty string, or nothing visible
+		return GFX_TEXT_OK;
+	}
+	gfx_Dirty(clip_x1, clip_y1, clip_x2, clip_y2);
 	
 	if (GFX_VERBOSE){
-		printf("%s.%d\t Displaying string: [%s] at vram offset 0x%x\n", __FILE__, __LINE__, c, vram);
 		printf("%s.%d\t Displaying string: [%s] at screen co-ords %d,%d\n", __FILE__, __LINE__, c, x, y);
 	}
+	
+	// Colour of each mask value
+	colours[0] = fontdata->bg_colour;
+	for (i = 0; i < fontdata->n_planes; i++){
+		colours[i + 1] = fontdata->plane_colour[i];
+	}
+	if ((style->fg_colour != GFX_TEXT_FONT_COLOUR) && (fontdata->n_planes > 0)){
+		// The last plane is the glyph itself; any before it (e.g. an outline) keep their colour
+		colours[fontdata->n_planes] = style->fg_colour;
+	}
+	
+	first = (clip_x1 - x) / fontdata->width;
+	last = (clip_x2 - x) / fontdata->width;
+	
+	// For every visible symbol in the string,
+	// 1. Look up the appropriate symbol number to ascii character
+	// 2. Check if the symbol is in our font table
+	// 3. Copy the visible rows and columns of its mask into the vram buffer
+	for (pos = first; pos <= last; pos++){
 		
-	if ((fontdata->width == 8) || (fontdata->width == 16)){
-		// For every symbol in the string,
-		// 1. Look up the appropriate symbol number to ascii character
-		// 2. Check if the symbol is in our font table
-		// 3. Do a bitmap copy of the symbol into the vram buffer
-		// 4. Increment vram buffer pointer
-		for (pos = 0; pos < strlen(c); pos+=1){
-			
-			i = (unsigned char) c[pos];
-			if ((i >= fontdata->ascii_start) && (i <= (fontdata->ascii_start + fontdata->n_symbols))){
-				font_symbol = i - fontdata->ascii_start;
-			} else {
-				font_symbol = fontdata->unknown_symbol;
-			}
-			
-			// Output this symbol
-			for(font_row = 0; font_row <= fontdata->height; font_row++){
-				row_offset = font_row * GFX_COLS;
-				src =  (unsigned char*) fontdata->symbol[font_symbol][font_row];
-				dst = vram + row_offset;
-				memcpy(dst, src, fontdata->width);
-			}
-		
-			// Reposition write position for next symbol
-			vram = vram + fontdata->width;
+		i = (unsigned char) c[pos];
+		if ((i >= fontdata->ascii_start) && (i < (fontdata->ascii_start + fontdata->n_symbols))){
+			font_symbol = i - fontdata->ascii_start;
+		} else {
+			font_symbol = fontdata->unknown_symbol;
 		}
-		return GFX_TEXT_OK;
 		
-	} else {
-		// Unsupported font width
-		if (GFX_VERBOSE){
-			printf("%s.%d\t Error, font is not a supported width (8 or 16 pixels)\n", __FILE__, __LINE__);	
+		glyph_x = x + (pos * fontdata->width);
+		col1 = (clip_x1 > glyph_x) ? (clip_x1 - glyph_x) : 0;
+		col2 = (clip_x2 < (glyph_x + fontdata->width - 1)) ? (clip_x2 - glyph_x) : (fontdata->width - 1);
+		
+		mask = fontdata->masks + (font_symbol * fontdata->width * fontdata->height) + ((clip_y1 - y) * fontdata->width);
+		dst = vram_buffer + (clip_y1 * GFX_COLS) + glyph_x;
+		
+		if (style->mode == GFX_TEXT_TRANSPARENT){
+			for (row = clip_y1; row <= clip_y2; row++){
+				for (col = col1; col <= col2; col++){
+					if (mask[col]){
+						dst[col] = colours[mask[col]];
+					}
+				}
+				mask += fontdata->width;
+				dst += GFX_COLS;
+			}
+		} else {
+			for (row = clip_y1; row <= clip_y2; row++){
+				for (col = col1; col <= col2; col++){
+					dst[col] = colours[mask[col]];
+				}
+				mask += fontdata->width;
+				dst += GFX_COLS;
+			}
 		}
-		return GFX_TEXT_INVALID;
 	}
-	
-}
\ No newline at end of file
+	return GFX_TEXT_OK;
+}
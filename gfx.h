@@ -33,6 +33,12 @@
 #define VRAM_START		0xC00000		// Start of graphics vram
 #define VRAM_END			VRAM_START + (GFX_ROW_SIZE * GFX_COL_SIZE)		// End of graphics vram
 
+#define GFX_VSYNC_OFF		0			// Copy to VRAM as soon as gfx_Flip() is called
+#define GFX_VSYNC_WAIT		1			// Start copying to VRAM (or switch pages) at the next vertical blank
+#define GFX_VSYNC_SPLIT		2			// As above, and spread large copies over as many blanks as they need
+#define GFX_VSYNC_BUDGET		8192		// Bytes that can be copied to VRAM within one vertical blank
+#define GFX_VSYNC_TIMEOUT	100000		// Status polls before deciding the GDC isn't reporting vertical blank
+
 #define RGB_BLACK		0x0000			// Simple RGB definition for a black 16bit pixel (5551 representation?)
 #define RGB_WHITE		0xFFFF			// Simple RGB definition for a white 16bit pixel (5551 representation?)
 
@@ -40,6 +46,39 @@
 #define GFX_ERR_MISSING_BMPHEADER	-253
 #define GFX_TEXT_OK           		-252 // Output of text data ok
 #define GFX_TEXT_INVALID      		-251 // Attempted output of an unsupported font glyph (too wide, too heigh, etc)
+#define GFX_ERR_MALLOC			-250 // Unable to allocate memory
+#define GFX_ERR_NO_BACKGROUND		-249 // No background layer has been saved
+
+#define GFX_TEXT_OPAQUE			0			// Glyph backgrounds are filled with the font background colour
+#define GFX_TEXT_TRANSPARENT		1			// Glyph backgrounds are left as they are
+#define GFX_TEXT_FONT_COLOUR		-1			// Draw the glyph in the colour of the font itself
+
+// How gfx_PutsStyle() draws a string; see gfx_TextStyleInit() for the defaults
+typedef struct textstyle {
+	unsigned char	mode;		// GFX_TEXT_OPAQUE or GFX_TEXT_TRANSPARENT
+	int			fg_colour;	// Palette entry for the glyph, or GFX_TEXT_FONT_COLOUR
+	int			clip_x1;		// Only pixels inside this box are drawn
+	int			clip_y1;
+	int			clip_x2;
+	int			clip_y2;
+} textstyle_t;
+
+#define GFX_SPRITE_MAX_RUN	255			// Longest skip or run of pixels in one sprite run
+
+// A bitmap with the pixels of its key colour left out, as built by gfx_SpriteFromBitmap()
+//
+// Each row is a list of runs, each of which is:
+//	skip	- 1 byte, transparent pixels before this run
+//	count	- 1 byte, opaque pixels in this run (may be 0 to make a longer skip)
+//	pixels	- count bytes
+// and the row ends with a run where both skip and count are 0.
+typedef struct spritedata {
+	unsigned short	width;		// Width of the original bitmap
+	unsigned short	height;		// Height of the original bitmap
+	unsigned int	size;		// Bytes of run data
+	unsigned int	*row_offset;	// Offset of the first run of each row in data
+	unsigned char	*data;		// Runs of all rows
+} spritedata_t;
 
 unsigned char	*vram;				// Pointer to a location in the local graphics buffer
 unsigned char	vram_buffer[(GFX_ROW_SIZE * GFX_COL_SIZE)];
@@ -50,14 +89,36 @@ int				vram_dpmi_selector;	// Memory region selector handle
 /* Function prototypes */
 /* **************************** */
 
+int		gfx_BackgroundSave();
+int		gfx_BackgroundRestore(int x1, int y1, int x2, int y2);
+void		gfx_BackgroundFree();
 int		gfx_Bitmap(int x, int y, bmpdata_t *bmpdata);
+int		gfx_BitmapPart(int x, int y, bmpdata_t *bmpdata, int src_x, int src_y, int width, int height);
+int		gfx_BitmapKeyed(int x, int y, bmpdata_t *bmpdata, unsigned char key);
 int 		gfx_Box(int x1, int y1, int x2, int y2, unsigned char palette);
 int 		gfx_BoxFill(int x1, int y1, int x2, int y2, unsigned char palette);
 int		gfx_BoxFillTranslucent(int x1, int y1, int x2, int y2, unsigned char palette);
 void		gfx_Clear();
+void		gfx_Dirty(int x1, int y1, int x2, int y2);
 int		gfx_Close();
 void		gfx_Flip();
+unsigned int	gfx_FlipBytes();
+unsigned long	gfx_FlipCount();
+void		gfx_FlipStats();
+void		gfx_SetPageFlip(unsigned char enable);
+void		gfx_SetVsync(unsigned char mode);
 int		gfx_GetXYaddr(int x, int y);
 int		gfx_Init();
+int		gfx_Puts(int x, int y, fontdata_t *fontdata, char *c);
+int		gfx_PutsStyle(int x, int y, fontdata_t *fontdata, textstyle_t *style, char *c);
+int		gfx_RestoreRect(int x, int y, int width, int height, unsigned char *buffer);
+int		gfx_SaveRect(int x, int y, int width, int height, unsigned char *buffer);
+int		gfx_ScrollRect(int x1, int y1, int x2, int y2, int dy);
+int		gfx_Sprite(int x, int y, spritedata_t *sprite);
+void		gfx_SpriteDestroy(spritedata_t *sprite);
+int		gfx_SpriteSolid(int x, int y, spritedata_t *sprite, unsigned char palette);
+int		gfx_SpriteFromBitmap(bmpdata_t *bmpdata, spritedata_t *sprite, unsigned char key);
 void		gfx_TextOff();
-void		gfx_TextOn();
\ No newline at end of file
+void		gfx_TextOn();
+void		gfx_TextStyleInit(textstyle_t *style);
+int		gfx_TextWidth(fontdata_t *fontdata, char *c);
\ No newline at end of file
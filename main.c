@@ -56,6 +56,10 @@ int main() {
 	int found, found_tmp;					// Number of gamedirs/games found
 	int verbose;							// Controls output of additional logging/text
 	int status;								// Generic function return status variable
+	unsigned long inputs;					// Number of inputs handled by the main loop
+	unsigned long inputs_reported;			// Inputs whose presents have been reported
+	unsigned long presents;					// Flips presented before the current input
+	unsigned long palette_writes;			// Palette port writes made before the current input
 	char msg[64];							// Message buffer
 	FILE *screenshot_file;
 	FILE *savefile;
@@ -81,6 +85,7 @@ int main() {
 	active_pane = BROWSER_PANE;				// Set initial focus to browser pane
 	user_input = joy_input = key_input = 0;	// Initial state of all input variables
 	exit = 0;								// Dont exit from main loop unless specified
+	inputs = inputs_reported = presents = palette_writes = 0;
 	scrape_dirs = 0;						// Default to 0 directories found
 	progress = 0;							// Default to 0 progress bar size
 	found = found_tmp = 0;					// Counter of the number of found directories/gamedata items
@@ -123,6 +128,9 @@ int main() {
 	state->selected_max = 0;			// Total amount of items in current filtered selection
 	state->selected_page = 1;		// Default to first page of selected games 
 	state->selected_line = 0;		// Default to first line selected
+	state->selected_top = 0;			// Default to the first game at the top of the browser
+	state->browser_scroll = 0;
+	state->browser_highlight = 0;
 	state->total_pages = 0;			// Total number of pages of selected games (selected_max / ui_browser_max_lines)
 	state->selected_gameid = -1;		// Current selected game
 	state->has_images = 0;			
@@ -169,6 +177,11 @@ int main() {
 		printf("save=%d\n", config->save);
 		printf("keyboard_test=%d\n", config->keyboard_test);
 		printf("preload_names=%d\n", config->preload_names);
+		printf("dither=%d\n", config->dither);
+		printf("pageflip=%d\n", config->pageflip);
+		printf("scroll=%d\n", config->scroll);
+		printf("vsync=%d\n", config->vsync);
+		printf("highlight=%d\n", config->highlight);
 		printf("\n");
 		if (config->verbose == 0){
 			printf("Verbose mode is disabled, you will not receive any further logging after this point\n");
@@ -185,6 +198,13 @@ int main() {
 		input_test();
 	}
 	
+	// Dithering of any high colour artwork
+	bmp_SetDither((unsigned char) config->dither);
+	
+	// Line by line, or page by page, browser
+	state->browser_scroll = config->scroll;
+	state->browser_highlight = config->highlight;
+	
 	// ======================
 	// Initialise GUI 
 	// ======================
@@ -193,6 +213,8 @@ int main() {
 		printf("ERROR! Unable to initialise graphics mode!\n");
 		return status;	
 	}
+	gfx_SetPageFlip((unsigned char) config->pageflip);
+	gfx_SetVsync((unsigned char) config->vsync);
 	
 	// Do basic UI initialisation
 	ui_Init();	
@@ -477,7 +499,6 @@ int main() {
 		free(gamedata);
 		return status;
 	}
-	gfx_Flip();
 	
 	// Launchdat metadata structure
 	launchdat = (launchdat_t *) malloc(sizeof(launchdat_t));	
@@ -489,7 +510,21 @@ int main() {
 	// ======================	
 	//ui_StatusMessage("Waiting for user input...");
 	while(exit == 0){
+		// Everything drawn in response to the last input is 
+		// presented in one flip, before waiting for the next input
+		gfx_Flip();
+		// input_get() returns input_none after a short wait if nothing was 
+		// pressed, so only real inputs are counted and reported
+		if ((inputs != inputs_reported) && config->verbose){
+			printf("%s.%d\t %lu present(s), %lu palette port writes for last input\n", __FILE__, __LINE__, gfx_FlipCount() - presents, pal_WriteCount() - palette_writes);
+		}
+		inputs_reported = inputs;
+		presents = gfx_FlipCount();
+		palette_writes = pal_WriteCount();
 		user_input = input_get();
+		if (user_input != input_none){
+			inputs++;
+		}
 		
 		// ==================================================
 		//
@@ -508,18 +543,20 @@ int main() {
 						printf("%s.%d\t Closing confirm popup\n", __FILE__, __LINE__);	
 					}
 					active_pane = BROWSER_PANE;
-					// exit and redraw main window
-					if (config->verbose){
-						printf("%s.%d\t Redrawing main screen for Game ID: %d, %s\n", __FILE__, __LINE__, state->selected_gameid, state->selected_game->name);	
+					// put back whatever the popup(s) covered, or
+					// redraw the main window if that isn't possible
+					if (ui_PopupCloseAll() != UI_OK){
+						if (config->verbose){
+							printf("%s.%d\t Redrawing main screen for Game ID: %d, %s\n", __FILE__, __LINE__, state->selected_gameid, state->selected_game->name);	
+						}
+						ui_DrawMainWindow();
+						ui_UpdateBrowserPane(state, gamedata);
+						ui_DrawInfoBox();
+						ui_ReselectCurrentGame(state);
+						ui_UpdateInfoPane(state, gamedata, launchdat);
+						ui_UpdateBrowserPaneStatus(state);
+						ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
 					}
-					ui_DrawMainWindow();
-					ui_UpdateBrowserPane(state, gamedata);
-					ui_DrawInfoBox();
-					ui_ReselectCurrentGame(state);
-					ui_UpdateInfoPane(state, gamedata, launchdat);
-					ui_UpdateBrowserPaneStatus(state);
-					ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
-					gfx_Flip();
 					break;
 				case(input_select):
 					// Quit application and run the file
@@ -552,28 +589,28 @@ int main() {
 						printf("%s.%d\t Closing launcher popup\n", __FILE__, __LINE__);	
 					}
 					active_pane = BROWSER_PANE;
-					// exit and redraw main window
-					if (config->verbose){
-						printf("%s.%d\t Redrawing main screen for Game ID: %d, %s\n", __FILE__, __LINE__, state->selected_gameid, state->selected_game->name);	
+					// put back whatever the popup(s) covered, or
+					// redraw the main window if that isn't possible
+					if (ui_PopupCloseAll() != UI_OK){
+						if (config->verbose){
+							printf("%s.%d\t Redrawing main screen for Game ID: %d, %s\n", __FILE__, __LINE__, state->selected_gameid, state->selected_game->name);	
+						}
+						ui_DrawMainWindow();
+						ui_UpdateBrowserPane(state, gamedata);
+						ui_DrawInfoBox();
+						ui_ReselectCurrentGame(state);
+						ui_UpdateInfoPane(state, gamedata, launchdat);
+						ui_UpdateBrowserPaneStatus(state);
+						ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
 					}
-					ui_DrawMainWindow();
-					ui_UpdateBrowserPane(state, gamedata);
-					ui_DrawInfoBox();
-					ui_ReselectCurrentGame(state);
-					ui_UpdateInfoPane(state, gamedata, launchdat);
-					ui_UpdateBrowserPaneStatus(state);
-					ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
-					gfx_Flip();
 					break;
 				case(input_up):
 					// FLip between start files
 					ui_DrawLaunchPopup(state, gamedata, launchdat, 1);
-					gfx_Flip();
 					break;
 				case(input_down):
 					// FLip between start files
 					ui_DrawLaunchPopup(state, gamedata, launchdat, 1);
-					gfx_Flip();
 					break;
 				case(input_select):
 					// Quit application and run the selected start file
@@ -582,7 +619,6 @@ int main() {
 					}
 					active_pane = CONFIRM_PANE;
 					ui_DrawConfirmPopup(state, gamedata, launchdat);
-					gfx_Flip();
 					break;
 				default:
 					break;
@@ -626,14 +662,12 @@ int main() {
 						printf("%s.%d\t Toggle filter type selection up\n", __FILE__, __LINE__);	
 					}
 					ui_DrawFilterPrePopup(state, -1);
-					gfx_Flip();
 					break;
 				case(input_down):
 					if (config->verbose){
 						printf("%s.%d\t Toggle filter type selection down\n", __FILE__, __LINE__);	
 					}
 					ui_DrawFilterPrePopup(state, 1);
-					gfx_Flip();
 					break;
 				case(input_select):
 					// Choose the highlighted selection
@@ -657,8 +691,8 @@ int main() {
 						ui_UpdateInfoPane(state, gamedata, launchdat);
 						ui_UpdateBrowserPaneStatus(state);
 						ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
-						gfx_Flip();
-						user_input = input_get();
+						// The key is used; the browser pane must not see it as well
+						user_input = input_none;
 					} else {
 						if (config->verbose){
 							printf("%s.%d\t Launching filter popup\n", __FILE__, __LINE__);	
@@ -678,8 +712,8 @@ int main() {
 						
 						// Bring up the filter keyword selection pane
 						ui_DrawFilterPopup(state, 0);
-						gfx_Flip();
-						user_input = input_get();
+						// The key is used; the filter pane must not see it as well
+						user_input = input_none;
 					}
 					break;
 				case(input_cancel):
@@ -687,18 +721,20 @@ int main() {
 						printf("%s.%d\t Closing filter type popup\n", __FILE__, __LINE__);	
 					}
 					active_pane = BROWSER_PANE;
-					// exit and redraw main window
-					if (config->verbose){
-						printf("%s.%d\t Redrawing main screen for Game ID: %d, %s\n", __FILE__, __LINE__, state->selected_gameid, state->selected_game->name);	
+					// put back whatever the popup(s) covered, or
+					// redraw the main window if that isn't possible
+					if (ui_PopupCloseAll() != UI_OK){
+						if (config->verbose){
+							printf("%s.%d\t Redrawing main screen for Game ID: %d, %s\n", __FILE__, __LINE__, state->selected_gameid, state->selected_game->name);	
+						}
+						ui_DrawMainWindow();
+						ui_UpdateBrowserPane(state, gamedata);
+						ui_DrawInfoBox();
+						ui_ReselectCurrentGame(state);
+						ui_UpdateInfoPane(state, gamedata, launchdat);
+						ui_UpdateBrowserPaneStatus(state);
+						ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
 					}
-					ui_DrawMainWindow();
-					ui_UpdateBrowserPane(state, gamedata);
-					ui_DrawInfoBox();
-					ui_ReselectCurrentGame(state);
-					ui_UpdateInfoPane(state, gamedata, launchdat);
-					ui_UpdateBrowserPaneStatus(state);
-					ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
-					gfx_Flip();
 					break;
 				default:
 					break;
@@ -726,14 +762,12 @@ int main() {
 						printf("%s.%d\t Toggle filter selection up\n", __FILE__, __LINE__);	
 					}
 					ui_DrawFilterPopup(state, -1);
-					gfx_Flip();
 					break;
 				case(input_down):
 					if (config->verbose){
 						printf("%s.%d\t Toggle filter selection down\n", __FILE__, __LINE__);	
 					}
 					ui_DrawFilterPopup(state, 1);
-					gfx_Flip();
 					break;
 				case(input_select):
 					if (state->selected_filter == FILTER_GENRE){
@@ -760,26 +794,28 @@ int main() {
 					ui_UpdateInfoPane(state, gamedata, launchdat);
 					ui_UpdateBrowserPaneStatus(state);
 					ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
-					gfx_Flip();
-					user_input = input_get();
+					// The key is used; the browser pane must not see it as well
+					user_input = input_none;
 					break;
 				case(input_cancel):
 					if (config->verbose){
 						printf("%s.%d\t Closing filter keyword popup\n", __FILE__, __LINE__);	
 					}
 					active_pane = BROWSER_PANE;
-					// exit and redraw main window
-					if (config->verbose){
-						printf("%s.%d\t Redrawing main screen for Game ID: %d, %s\n", __FILE__, __LINE__, state->selected_gameid, state->selected_game->name);	
+					// put back whatever the popup(s) covered, or
+					// redraw the main window if that isn't possible
+					if (ui_PopupCloseAll() != UI_OK){
+						if (config->verbose){
+							printf("%s.%d\t Redrawing main screen for Game ID: %d, %s\n", __FILE__, __LINE__, state->selected_gameid, state->selected_game->name);	
+						}
+						ui_DrawMainWindow();
+						ui_UpdateBrowserPane(state, gamedata);
+						ui_DrawInfoBox();
+						ui_ReselectCurrentGame(state);
+						ui_UpdateInfoPane(state, gamedata, launchdat);
+						ui_UpdateBrowserPaneStatus(state);
+						ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
 					}
-					ui_DrawMainWindow();
-					ui_UpdateBrowserPane(state, gamedata);
-					ui_DrawInfoBox();
-					ui_ReselectCurrentGame(state);
-					ui_UpdateInfoPane(state, gamedata, launchdat);
-					ui_UpdateBrowserPaneStatus(state);
-					ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
-					gfx_Flip();
 					break;
 				default:
 					break;
@@ -812,7 +848,6 @@ int main() {
 					}
 					active_pane = FILTER_PRE_PANE;
 					ui_DrawFilterPrePopup(state, 0);
-					gfx_Flip();
 					break;
 				case(input_select):
 					// Start a game or launch a config tool
@@ -832,7 +867,6 @@ int main() {
 							active_pane = LAUNCH_PANE;
 							state->selected_start = START_MAIN;
 							ui_DrawLaunchPopup(state, gamedata, launchdat, 0);
-							gfx_Flip();
 							
 						} else if ((launchdat->start != NULL) && (strcmp(launchdat->start, "") != 0)){
 							// Start defined only
@@ -842,7 +876,6 @@ int main() {
 							active_pane = CONFIRM_PANE;
 							state->selected_start = START_MAIN;
 							ui_DrawConfirmPopup(state, gamedata, launchdat);
-							gfx_Flip();
 							
 						} else if ((launchdat->alt_start != NULL) && (strcmp(launchdat->alt_start, "") != 0)){
 							// alt start defined only
@@ -852,7 +885,6 @@ int main() {
 							active_pane = CONFIRM_PANE;
 							state->selected_start = START_ALT;
 							ui_DrawConfirmPopup(state, gamedata, launchdat);
-							gfx_Flip();
 							
 						} else {
 							// Nothing defined
@@ -865,19 +897,23 @@ int main() {
 					break;
 				case(input_up):
 					// Up current list by one row
-					if (state->selected_line == 0){
-						if (state->selected_page == 1){
-							// Loop back to last page
-							state->selected_page = state->total_pages;
+					if (state->browser_scroll){
+						ui_BrowserScroll(state, -1);
+					} else {
+						if (state->selected_line == 0){
+							if (state->selected_page == 1){
+								// Loop back to last page
+								state->selected_page = state->total_pages;
+							} else {
+								// Go back one page
+								state->selected_page--;
+							}
+							// Reset to line 1 of the new page
+							state->selected_line = 0;							
 						} else {
-							// Go back one page
-							state->selected_page--;
+							// Move up one line
+							state->selected_line--;
 						}
-						// Reset to line 1 of the new page
-						state->selected_line = 0;							
-					} else {
-						// Move up one line
-						state->selected_line--;
 					}
 					// Detect if selected game has changed
 					ui_ReselectCurrentGame(state);
@@ -885,19 +921,23 @@ int main() {
 					break;
 				case(input_down):
 					// Down current list by one row
-					if ((state->selected_line == ui_browser_max_lines - 1) || (state->selected_line == (state->selected_max - 1))){
-						if (state->selected_page == state->total_pages){
-							// Go to first page
-							state->selected_page = 1;
+					if (state->browser_scroll){
+						ui_BrowserScroll(state, 1);
+					} else {
+						if ((state->selected_line == ui_browser_max_lines - 1) || (state->selected_line == (state->selected_max - 1))){
+							if (state->selected_page == state->total_pages){
+								// Go to first page
+								state->selected_page = 1;
+							} else {
+								// Go forward one page
+								state->selected_page++;
+							}
+							// Reset to line 1 of the new page
+							state->selected_line = 0;							
 						} else {
-							// Go forward one page
-							state->selected_page++;
+							// Move down one line
+							state->selected_line++;
 						}
-						// Reset to line 1 of the new page
-						state->selected_line = 0;							
-					} else {
-						// Move down one line
-						state->selected_line++;
 					}
 					// Detect if selected game has changed
 					ui_ReselectCurrentGame(state);
@@ -906,29 +946,37 @@ int main() {
 				case(input_scroll_up):
 					// Scroll list up by one page
 					// Detect if selected game has changed
-					if (state->selected_page == 1){
-						// Loop back to last page
-						state->selected_page = state->total_pages;
+					if (state->browser_scroll){
+						ui_BrowserScroll(state, -ui_browser_max_lines);
 					} else {
-						// Go back one page
-						state->selected_page--;
+						if (state->selected_page == 1){
+							// Loop back to last page
+							state->selected_page = state->total_pages;
+						} else {
+							// Go back one page
+							state->selected_page--;
+						}
+						state->selected_line = 0;
 					}
-					state->selected_line = 0;
 					ui_ReselectCurrentGame(state);
 					ui_UpdateBrowserPane(state, gamedata);
 					break;
 				case(input_scroll_down):
 					// Scroll list down by one page
 					// Detect if selected game has changed
-					if (state->selected_page == state->total_pages){
-						// Go to first page
-						state->selected_page = 1;
+					if (state->browser_scroll){
+						ui_BrowserScroll(state, ui_browser_max_lines);
 					} else {
-						// Go forward one page
-						state->selected_page++;
+						if (state->selected_page == state->total_pages){
+							// Go to first page
+							state->selected_page = 1;
+						} else {
+							// Go forward one page
+							state->selected_page++;
+						}
+						// Reset to line 1 of the new page
+						state->selected_line = 0;	
 					}
-					// Reset to line 1 of the new page
-					state->selected_line = 0;	
 					ui_ReselectCurrentGame(state);
 					ui_UpdateBrowserPane(state, gamedata);
 					break;
@@ -941,7 +989,6 @@ int main() {
 							imagefile = imagefile_head;
 						}
 						ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
-						gfx_Flip();
 					}
 					break;
 				case(input_right):
@@ -953,7 +1000,6 @@ int main() {
 							imagefile = imagefile_head;
 						}
 						ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
-						gfx_Flip();
 					}
 					break;
 				default:
@@ -986,7 +1032,7 @@ int main() {
 					}
 				}
 				// Clear artwork window
-				gfx_BoxFill(ui_artwork_xpos, ui_artwork_ypos, ui_artwork_xpos + 320, ui_artwork_ypos + 200, PALETTE_UI_BLACK);
+				ui_ClearArtwork();
 				memset(state->selected_image, '\0', sizeof(state->selected_image)); 
 				state->has_images = 0;
 				
@@ -1031,7 +1077,6 @@ int main() {
 								printf("%s.%d\t Error, could not load metadata\n", __FILE__, __LINE__);	
 							}
 							//ui_StatusMessage("Error, could not load metadata!");
-							gfx_Flip();
 						} else {
 							state->has_launchdat = 1;
 						}
@@ -1073,11 +1118,9 @@ int main() {
 					ui_UpdateInfoPane(state, gamedata, launchdat);
 					ui_UpdateBrowserPaneStatus(state);
 					old_gameid = state->selected_gameid;
-					gfx_Flip();
 	
 					// Display artwork/first screenshot
 					ui_DisplayArtwork(screenshot_file, screenshot_bmp, state, imagefile);
-					gfx_Flip();
 				}
 				if (config->verbose){
 					printf("%s.%d\t New game successfully loaded\n", __FILE__, __LINE__);
@@ -1088,5 +1131,11 @@ int main() {
 	
 	ui_Close();
 	gfx_Close();
+	if (config->verbose){
+		gfx_FlipStats();
+		ui_AssetStats();
+		printf("Inputs: %lu\n", inputs);
+		printf("Palette port writes: %lu\n", pal_WriteCount());
+	}
 	return 0;
 }
\ No newline at end of file
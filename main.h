@@ -33,6 +33,9 @@ typedef struct state {
 	unsigned int selected_page;			// Page 'N' of the selected list
 	unsigned int selected_line;			// The line in the page indicating the selected game
 	unsigned int total_pages;			// Total number of pages in the selected_list
+	unsigned int browser_scroll;		// Scroll the browser a line at a time, rather than a page at a time
+	unsigned int browser_highlight;	// Move the selection by changing the palette entries of the cursors of each line
+	unsigned int selected_top;			// With browser_scroll, the index of the first line shown in the browser
 	unsigned int active_pane;
 	unsigned int selected_start;			// Which start file to launch, 0==start, 1==alt_start
 	unsigned int selected_filter;		// Which filter to use, 0==none, 1==genre, 2==series
@@ -26,88 +26,290 @@
 #include "pegc.h"
 #include "palette.h"
 
+// Shadow palette; pal_Set() and friends only change this copy, and
+// pal_Commit() uploads the entries which differ from the hardware
+static unsigned char	pal_shadow[PALETTES_TOTAL][3];	// r, g, b of each entry, as it should be
+static unsigned char	pal_hw[PALETTES_TOTAL][3];		// r, g, b of each entry, as last uploaded
+static unsigned char	pal_hw_valid[PALETTES_TOTAL];	// Set once an entry has been uploaded
+static int			pal_dirty_lo;					// Range of entries changed since the last commit
+static int			pal_dirty_hi;					// Exclusive; nothing has changed when lo >= hi
+static unsigned long	pal_writes;						// Port writes made by all commits
+
+// Images using each entry, as allocated by pal_Alloc()
+static unsigned short	pal_refs[PALETTES_TOTAL];
+
+// Entries taken by pal_Claim(), which are never shared with an image
+static unsigned char	pal_owned[PALETTES_TOTAL];
+
+static void pal_Ref(int idx){
+	// Take a reference to a palette entry
+	
+	if (pal_refs[idx] == 0){
+		if (idx < PALETTES_FREE){
+			free_palettes_used++;
+		} else {
+			reserved_palettes_used++;
+		}
+	}
+	pal_refs[idx]++;
+}
+
+static void pal_Unref(int idx){
+	// Drop a reference to a palette entry; it keeps its colour, so that
+	// a later image with the same colour can have it back for free
+	
+	if (pal_refs[idx] == 0){
+		return;
+	}
+	pal_refs[idx]--;
+	if (pal_refs[idx] == 0){
+		if (idx < PALETTES_FREE){
+			free_palettes_used--;
+		} else {
+			reserved_palettes_used--;
+		}
+	}
+}
+
+static int pal_AllocColour(bmpdata_t *bmpdata, int i, int first, int last){
+	// Give colour i of bmpdata an entry in the range first to last - 1, and point 
+	// its new_palette_entry at it. Returns 1 if the colour had to be approximated.
+	//
+	// Colours which are already in the range share that entry, whether it is 
+	// in use by another image or was left behind by one. Otherwise an unused 
+	// entry is taken. If there are none left, the nearest colour in use is 
+	// shared instead.
+	
+	int j;
+	int found;
+	int d, dr, dg, db, best_d;
+	int approximated;
+	
+	// Same colour already in the range
+	found = -1;
+	for (j = first; j < last; j++){
+		if (pal_owned[j]){
+			continue;
+		}
+		if ((pal_shadow[j][0] == bmpdata->palette[i].r) && (pal_shadow[j][1] == bmpdata->palette[i].g) && (pal_shadow[j][2] == bmpdata->palette[i].b)){
+			if (pal_refs[j] || (found < 0)){
+				found = j;
+			}
+			if (pal_refs[j]){
+				break;
+			}
+		}
+	}
+	
+	// An unused entry
+	if (found < 0){
+		for (j = first; j < last; j++){
+			if ((pal_refs[j] == 0) && (pal_owned[j] == 0)){
+				found = j;
+				pal_Set(j, bmpdata->palette[i].r, bmpdata->palette[i].g, bmpdata->palette[i].b);
+				break;
+			}
+		}
+	}
+	
+	// Range is full; the closest colour in use will have to do
+	approximated = 0;
+	if (found < 0){
+		best_d = (3 * 255 * 255) + 1;
+		for (j = first; j < last; j++){
+			if (pal_owned[j]){
+				continue;
+			}
+			dr = pal_shadow[j][0] - bmpdata->palette[i].r;
+			dg = pal_shadow[j][1] - bmpdata->palette[i].g;
+			db = pal_shadow[j][2] - bmpdata->palette[i].b;
+			d = (dr * dr) + (dg * dg) + (db * db);
+			if (d < best_d){
+				found = j;
+				best_d = d;
+			}
+		}
+		approximated = 1;
+	}
+	
+	// Every entry of the range is claimed; there is nothing to share
+	if (found < 0){
+		bmpdata->palette[i].new_palette_entry = PALETTE_UI_BLACK;
+		return approximated;
+	}
+	pal_Ref(found);
+	bmpdata->palette[i].new_palette_entry = found;
+	return approximated;
+}
+
+int pal_Alloc(bmpdata_t *bmpdata, int first, int count){
+	// Give each colour of bmpdata an entry in the range first to first + count - 1,
+	// and point its new_palette_entry at it; this is the remap table that the 
+	// pixels are translated through, either as they are decoded or by pal_BMPRemap().
+	// Returns the number of colours which had to share the nearest colour in use,
+	// as the range was full.
+	
+	int i;
+	int approximated;
+	
+	approximated = 0;
+	for (i = 0; i < bmpdata->colours; i++){
+		approximated += pal_AllocColour(bmpdata, i, first, first + count);
+	}
+	
+	if (PALETTE_VERBOSE){
+		printf("%s.%d\t Allocated %d colours in entries %d-%d, %d approximated\n", __FILE__, __LINE__, bmpdata->colours, first, first + count - 1, approximated);
+	}
+	return approximated;
+}
+
+int pal_AllocUsed(bmpdata_t *bmpdata, int first, int count, unsigned char *used, unsigned char *remap){
+	// As pal_Alloc(), for an image whose pixels have already been decoded through
+	// new_palette_entry, with used[] marked for each value they were decoded to 
+	// (see bmp_SetUsed()). Only those colours are given an entry; the rest are
+	// pointed at PALETTE_UI_BLACK, which pal_Release() leaves alone.
+	// remap[] is set to the entry for each decoded value, ready for bmp_Remap().
+	
+	int i;
+	int n;
+	int approximated;
+	unsigned char decoded;
+	
+	for (i = 0; i < 256; i++){
+		remap[i] = i;
+	}
+	n = 0;
+	approximated = 0;
+	for (i = 0; i < bmpdata->colours; i++){
+		decoded = bmpdata->palette[i].new_palette_entry;
+		if (used[decoded]){
+			approximated += pal_AllocColour(bmpdata, i, first, first + count);
+			remap[decoded] = bmpdata->palette[i].new_palette_entry;
+			n++;
+		} else {
+			bmpdata->palette[i].new_palette_entry = PALETTE_UI_BLACK;
+		}
+	}
+	
+	if (PALETTE_VERBOSE){
+		printf("%s.%d\t Allocated %d of %d colours in entries %d-%d, %d approximated\n", __FILE__, __LINE__, n, bmpdata->colours, first, first + count - 1, approximated);
+	}
+	return approximated;
+}
+
+void pal_Release(bmpdata_t *bmpdata){
+	// Drop the references taken by pal_Alloc() for the colours of bmpdata
+	
+	int i;
+	
+	for (i = 0; i < bmpdata->colours; i++){
+		if (bmpdata->palette[i].new_palette_entry < (PALETTES_FREE + PALETTES_RESERVED)){
+			pal_Unref(bmpdata->palette[i].new_palette_entry);
+		}
+	}
+}
+
+int pal_Claim(int first, int count){
+	// Take an unused entry in the range first to first + count - 1 for the 
+	// sole use of the caller, which sets its colour as it likes with pal_Set().
+	// Images are never given it by pal_Alloc(). Returns -1 if there are none left.
+	
+	int j;
+	
+	for (j = first; j < (first + count); j++){
+		if ((pal_refs[j] == 0) && (pal_owned[j] == 0)){
+			pal_owned[j] = 1;
+			if (j < PALETTES_FREE){
+				free_palettes_used++;
+			} else {
+				reserved_palettes_used++;
+			}
+			return j;
+		}
+	}
+	return -1;
+}
+
+int pal_Claimed(int first, int count){
+	// Number of entries in the range first to first + count - 1 taken by pal_Claim()
+	
+	int j;
+	int n;
+	
+	n = 0;
+	for (j = first; j < (first + count); j++){
+		n += pal_owned[j];
+	}
+	return n;
+}
+
+void pal_Unclaim(int idx){
+	// Hand back an entry taken by pal_Claim(), so that images can be given it again
+	
+	if ((idx < 0) || (idx >= PALETTES_TOTAL) || (pal_owned[idx] == 0)){
+		return;
+	}
+	pal_owned[idx] = 0;
+	if (idx < PALETTES_FREE){
+		free_palettes_used--;
+	} else {
+		reserved_palettes_used--;
+	}
+}
+
+void pal_Get(unsigned char idx, unsigned char *r, unsigned char *g, unsigned char *b){
+	// Colour of a palette entry, as last set
+	
+	*r = pal_shadow[idx][0];
+	*g = pal_shadow[idx][1];
+	*b = pal_shadow[idx][2];
+}
+
 int pal_BMP2Palette(bmpdata_t *bmpdata, int reserved){
 	// Set palette entries based on a specific bmpdata structure
-	// restricted == 1 if we are setting the 32 reserved colours of the user interface
+	// reserved == 1 if we are setting the 32 reserved colours of the user interface,
+	// whose pixels may have already been decoded and are remapped here; otherwise
+	// this is artwork in the free region, which is remapped as it is decoded.
 	
+	unsigned char decoded[256];	// Value each colour was given when its pixels were decoded
+	int status;
 	int i;
-	int f;
 	
 	if (reserved == 1){
-		// Set palette entries for the restricted region (UI elements)
-		
 		if (PALETTE_VERBOSE){
 			printf("%s.%d\t Setting reserved UI palette entries\n", __FILE__, __LINE__);
 		}
-		
-		if (reserved_palettes_used < PALETTES_RESERVED){
-			f = PALETTES_FREE;
-			for(i = 0; i < bmpdata->colours; i++){
-				
-				if (i >= PALETTES_RESERVED){
-					// Somehow this image has more colours than we have reserved palette entries
-					if (PALETTE_VERBOSE){
-						printf("%s.%d\t Warning, more colours than available in reserved palette entry space!\n", __FILE__, __LINE__);
-					}
-					return -1;
-				}
-				
-				if (reserved_palettes_used < PALETTES_RESERVED){
-					pal_Set((i + PALETTES_FREE), bmpdata->palette[i].r, bmpdata->palette[i].g, bmpdata->palette[i].b);
-					bmpdata->palette[i].new_palette_entry = i + PALETTES_FREE;
-					reserved_palettes_used++;
-				} else {
-					// No free palette entries remaining - this shouldnt happen with the UI!!!
-					if (PALETTE_VERBOSE){
-						printf("%s.%d\t Warning, we ran out of reserved palette entries before processing all colours!\n", __FILE__, __LINE__);
-					}
-					return -1;
-				}
-			}
-			// Remap the bitmap pixels to the new palette indices
-			pal_BMPRemap(bmpdata);
-			return bmpdata->colours;
-		} else {
-			// Maximum number of palette entries reached
-			if (PALETTE_VERBOSE){
-				printf("%s.%d\t Reserved UI palette entries already set\n", __FILE__, __LINE__);
-			}
-			// Remap the bitmap pixels to the new palette indices
-			for (i = 0; i < bmpdata->colours; i++){
-				bmpdata->palette[i].new_palette_entry = i + PALETTES_FREE;	
-			}
-			pal_BMPRemap(bmpdata);
-			return -1;
+		// The pixels went through new_palette_entry as they were decoded; it
+		// is only the colour table index if the colour table was not reduced
+		for (i = 0; i < bmpdata->colours; i++){
+			decoded[i] = bmpdata->palette[i].new_palette_entry;
 		}
-		
+		status = pal_Alloc(bmpdata, PALETTES_FREE, PALETTES_RESERVED);
+		pal_BMPRemap(bmpdata, decoded);
 	} else {
-		// Set palette entries for the free region (artwork etc)
-		if (free_palettes_used < PALETTES_FREE){
-			for(i = 0; i < bmpdata->colours; i++){
-				if (free_palettes_used < PALETTES_FREE){
-					pal_Set(i, bmpdata->palette[i].r, bmpdata->palette[i].g, bmpdata->palette[i].b);
-					bmpdata->palette[i].new_palette_entry = i;
-					free_palettes_used++;
-				}
-			}			
-			return bmpdata->colours;
-		} else {
-			// Maximum number of palette entries reached	
-			return -1;
-		}
+		status = pal_Alloc(bmpdata, 0, PALETTES_FREE);
 	}
+	if (status != 0){
+		// Ran out of entries, and some colours were approximated
+		return -1;
+	}
+	return bmpdata->colours;
 }
 
-int pal_BMPRemap(bmpdata_t *bmpdata){
+int pal_BMPRemap(bmpdata_t *bmpdata, unsigned char *decoded){
+	// Move decoded pixels to the entries given to their colours by pal_Alloc().
+	// decoded[i] is the value the pixels of colour i were decoded to; those
+	// colours which shared a value (after bmp_ReducePalette()) have the same
+	// colour, so pal_Alloc() gave them the same entry too.
 
+	unsigned char remap[256];
 	unsigned char *px;
 	unsigned char c;
 	int i;
 	int pos;
-	int px_remapped, colours_remapped, remapped;
+	int px_remapped;
 	
 	px_remapped = 0;
-	colours_remapped = 0;
 	
 	if (bmpdata->pixels == NULL){
 		if (PALETTE_VERBOSE){
@@ -116,13 +318,20 @@ int pal_BMPRemap(bmpdata_t *bmpdata){
 		return PALETTE_NO_PIXELS;
 	} else {
 		
+		for (i = 0; i < 256; i++){
+			remap[i] = i;
+		}
+		for (i = 0; i < bmpdata->colours; i++){
+			remap[decoded[i]] = bmpdata->palette[i].new_palette_entry;
+		}
+		
 		px = bmpdata->pixels;
 		// A single loop over all the pixels
 		for (pos = 0; pos < bmpdata->size; pos++){
 			// Read the value of the current pixel, this is the palette entry number
 			c = *px;
 			// Set it to the new palette entry number
-			*px = (unsigned char) bmpdata->palette[c].new_palette_entry;
+			*px = remap[c];
 			px_remapped++;
 			// Step to next pixel
 			px++;
@@ -135,8 +344,56 @@ int pal_BMPRemap(bmpdata_t *bmpdata){
 	}
 }
 
+int pal_Commit(){
+	// Upload the entries of the shadow palette which have changed since
+	// they were last uploaded, returning the number of entries written.
+	// Callers should do this in vertical blank, as gfx_Flip() does.
+	
+	int i;
+	int n;
+	unsigned char *c;
+	
+	n = 0;
+	for (i = pal_dirty_lo; i < pal_dirty_hi; i++){
+		c = pal_shadow[i];
+		if (pal_hw_valid[i] && (pal_hw[i][0] == c[0]) && (pal_hw[i][1] == c[1]) && (pal_hw[i][2] == c[2])){
+			continue;
+		}
+		outportb(PEGC_PALLETE_SEL_ADDR, i);
+		outportb(PEGC_RED_ADDR, c[0]);
+		outportb(PEGC_GREEN_ADDR, c[1]);
+		outportb(PEGC_BLUE_ADDR, c[2]);
+		pal_hw[i][0] = c[0];
+		pal_hw[i][1] = c[1];
+		pal_hw[i][2] = c[2];
+		pal_hw_valid[i] = 1;
+		n++;
+	}
+	pal_dirty_lo = PALETTES_TOTAL;
+	pal_dirty_hi = 0;
+	pal_writes += n * 4;
+	
+	if (PALETTE_VERBOSE && (n > 0)){
+		printf("%s.%d\t Committed %d palette entries, %d port writes\n", __FILE__, __LINE__, n, n * 4);
+	}
+	return n;
+}
+
+int pal_Pending(){
+	// Whether any entries have been set since the last commit
+	
+	return (pal_dirty_lo < pal_dirty_hi);
+}
+
+unsigned long pal_WriteCount(){
+	// Number of palette port writes made so far
+	
+	return pal_writes;
+}
+
 void pal_ResetAll(){
-	// Reset all palette entries
+	// Reset all palette entries. Whatever the hardware palette
+	// holds now is unknown, so every entry is uploaded on the next commit.
 	
 	unsigned int i;
 	
@@ -144,12 +401,16 @@ void pal_ResetAll(){
 		printf("%s.%d\t Resetting all palette entries\n", __FILE__, __LINE__);		
 	}
 	
-	for (i = 0; i < 256; i++){
-		outportb(PEGC_PALLETE_SEL_ADDR, i);
-		outportb(PEGC_RED_ADDR, 0x0);
-		outportb(PEGC_GREEN_ADDR, 0x0);
-		outportb(PEGC_BLUE_ADDR, 0x0);	
+	for (i = 0; i < PALETTES_TOTAL; i++){
+		pal_shadow[i][0] = 0;
+		pal_shadow[i][1] = 0;
+		pal_shadow[i][2] = 0;
+		pal_hw_valid[i] = 0;
+		pal_refs[i] = 0;
+		pal_owned[i] = 0;
 	}
+	pal_dirty_lo = 0;
+	pal_dirty_hi = PALETTES_TOTAL;
 	
 	reserved_palettes_used = 0;
 	free_palettes_used = 0;
@@ -166,14 +427,14 @@ void pal_ResetFree(){
 		printf("%s.%d\t Resetting free palette entries range (0-%d)\n", __FILE__, __LINE__, PALETTES_FREE);		
 	}
 	
+	// The entries are only marked unused, and keep their colours; 
+	// any that the next artwork also has are shared, and not uploaded again.
+	// Those taken by pal_Claim() stay taken.
 	for (i = 0; i < PALETTES_FREE; i++){
-		outportb(PEGC_PALLETE_SEL_ADDR, i);
-		outportb(PEGC_RED_ADDR, 0x0);
-		outportb(PEGC_GREEN_ADDR, 0x0);
-		outportb(PEGC_BLUE_ADDR, 0x0);	
+		pal_refs[i] = 0;
 	}
 	
-	free_palettes_used = 0;
+	free_palettes_used = pal_Claimed(0, PALETTES_FREE);
 	
 	return;
 }
@@ -184,10 +445,15 @@ void pal_Set(unsigned char idx, unsigned char r, unsigned char g, unsigned char
 		printf("%s.%d\t Set palette #%3d r:%3d g:%3d b:%3d\n", __FILE__, __LINE__, idx, r, g, b);
 	}
 	
-	outportb(PEGC_PALLETE_SEL_ADDR, idx);
-	outportb(PEGC_RED_ADDR, r);
-	outportb(PEGC_GREEN_ADDR, g);
-	outportb(PEGC_BLUE_ADDR, b);
+	pal_shadow[idx][0] = r;
+	pal_shadow[idx][1] = g;
+	pal_shadow[idx][2] = b;
+	if (idx < pal_dirty_lo){
+		pal_dirty_lo = idx;
+	}
+	if (idx >= pal_dirty_hi){
+		pal_dirty_hi = idx + 1;
+	}
 	
 	return;
 }
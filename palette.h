@@ -53,7 +53,18 @@ unsigned int free_palettes_used;			// Current number of palette entries used
 unsigned int reserved_palettes_used;		// Current number of palette entries used
 
 
+int		pal_Alloc(bmpdata_t *bmpdata, int first, int count);
+int		pal_AllocUsed(bmpdata_t *bmpdata, int first, int count, unsigned char *used, unsigned char *remap);
 int 		pal_BMP2Palette(bmpdata_t *bmpdata, int reserved);
+int		pal_BMPRemap(bmpdata_t *bmpdata, unsigned char *decoded);
+int		pal_Claim(int first, int count);
+int		pal_Claimed(int first, int count);
+int		pal_Commit();
+void		pal_Get(unsigned char idx, unsigned char *r, unsigned char *g, unsigned char *b);
+int		pal_Pending();
 void 	pal_ResetAll();
 void 	pal_ResetFree();
+void		pal_Release(bmpdata_t *bmpdata);
 void 	pal_Set(unsigned char idx, unsigned char r, unsigned char g, unsigned char b);
+void		pal_Unclaim(int idx);
+unsigned long	pal_WriteCount();
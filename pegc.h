@@ -41,6 +41,7 @@
 // ===========================
 
 #define PEGC_MODE_ADDR				0x6A 	// Toggles planar or packed-pixel/chunky mode
+#define PEGC_GDC_STATUS_ADDR			0xA0		// Status port of the graphics GDC (read)
 #define PEGC_GDC_COMMAND_ADDR		0xA2		// Command port for GPU mode (start, stop, reset, zoom, scroll etc)
 #define PEGC_DISP_SCREEN_SEL_ADDR	0xA4		// Select screen to display in multi-page mode
 #define PEGC_DRAW_SCREEN_SEL_ADDR	0xA6		// Select screen to write to in multi-page mode
@@ -57,6 +58,8 @@
 #define GDC_COMMAND_STOP1			0x0C
 #define GDC_COMMAND_START			0x0D
 
+#define GDC_STATUS_VSYNC				0x20		// Set in the GDC status while the display is in vertical blank
+
 
 // Memory mapped IO ports to the PEGC hardware itself
 #define PEGC_PIXELMODE_ADDR			0xE0100 // Sets the colour depth
@@ -0,0 +1,173 @@
+/* bmpbench.c, Times the BMP decoder of the pc98Launcher on the host.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Usage:
+//
+//	bmpbench [repeats] [image.bmp ...]
+//
+// Each image is opened and decoded with the same bmp_ReadImage() used by 
+// the launcher, 'repeats' times over. The average time per image is printed
+// for reading the header and colour table, and for reading the pixels. With no images given, 8bpp and 4bpp
+// screenshots are generated at 320x200 and 640x400 and timed instead.
+//
+// The files are read unbuffered, so that every fread() and fseek() goes to 
+// the OS, much as each one is a DOS call through the transfer buffer under
+// DJGPP. Times are still for the host, with the files in its disk cache, so 
+// they compare one version of the decoder with another rather than predict 
+// a PC-98.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../bmp.h"
+#include "bmpfile.h"
+
+#define BENCH_REPEATS	200
+
+typedef struct benchimage {
+	char	*path;
+	int		width;
+	int		height;
+	int		bpp;
+	int		colours;
+} benchimage_t;
+
+static benchimage_t bench_images[] = {
+	{ "bench8s.bmp",	320,	200,	8,	192 },
+	{ "bench4s.bmp",	320,	200,	4,	16 },
+	{ "bench8l.bmp",	640,	400,	8,	192 },
+	{ "bench4l.bmp",	640,	400,	4,	16 },
+};
+#define bench_images_total	(sizeof(bench_images) / sizeof(benchimage_t))
+
+static int bench_Generate(benchimage_t *image){
+	// Write one of the generated screenshots
+
+	static unsigned char	colours[256][3];
+	FILE			*out;
+	unsigned char	*pixels;
+	unsigned char	*data;
+	unsigned long	size;
+	int				i;
+
+	for (i = 0; i < 256; i++){
+		colours[i][0] = (i * 37) & 0xFF;
+		colours[i][1] = (i * 91) & 0xFF;
+		colours[i][2] = (i * 13) & 0xFF;
+	}
+	pixels = (unsigned char *) malloc((unsigned long) image->width * image->height);
+	data = (unsigned char *) malloc((unsigned long) image->width * image->height);
+	if ((pixels == NULL) || (data == NULL)){
+		return -1;
+	}
+	bmpfile_Screenshot(pixels, image->width, image->height, image->colours, 1);
+	size = bmpfile_Pack(pixels, image->width, image->height, image->bpp, data);
+	out = fopen(image->path, "wb");
+	if (out == NULL){
+		return -1;
+	}
+	bmpfile_Write(out, image->width, image->height, image->bpp, BMP_UNCOMPRESSED, colours, image->colours, data, size);
+	fclose(out);
+	free(pixels);
+	free(data);
+	return 0;
+}
+
+static int bench_Decode(char *path, int repeats){
+	// Decode one image over and over, and print the average time taken
+
+	FILE		*in;
+	bmpdata_t	*bmpdata;
+	clock_t		start;
+	clock_t		header_time;
+	clock_t		pixel_time;
+	long		file_size;
+	int			status;
+	int			i;
+
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	status = 0;
+	file_size = 0;
+	header_time = 0;
+	pixel_time = 0;
+	for (i = 0; (i < repeats) && (status == 0); i++){
+		in = fopen(path, "rb");
+		if (in == NULL){
+			printf("Error, unable to open %s\n", path);
+			return -1;
+		}
+		setvbuf(in, NULL, _IONBF, 0);
+		start = clock();
+		status = bmp_ReadImage(in, bmpdata, 1, 1, 0);
+		header_time += clock() - start;
+		if (status == 0){
+			start = clock();
+			status = bmp_ReadImage(in, bmpdata, 0, 0, 1);
+			pixel_time += clock() - start;
+		}
+		fseek(in, 0, SEEK_END);
+		file_size = ftell(in);
+		fclose(in);
+		if (status == 0){
+			free(bmpdata->pixels);
+			bmpdata->pixels = NULL;
+		}
+	}
+	if (status != 0){
+		printf("Error, unable to decode %s (error %d)\n", path, status);
+		return -1;
+	}
+	printf("%-12s %4dx%-4d %2dbpp %7ld bytes %8.1fus %8.1fus\n", path, bmpdata->width, bmpdata->height, bmpdata->bpp, file_size, 
+		((double) header_time * 1000000.0) / CLOCKS_PER_SEC / repeats,
+		((double) pixel_time * 1000000.0) / CLOCKS_PER_SEC / repeats);
+	free(bmpdata);
+	return 0;
+}
+
+int main(int argc, char **argv){
+
+	int repeats;
+	int i;
+
+	repeats = BENCH_REPEATS;
+	if (argc > 1){
+		repeats = atoi(argv[1]);
+		if (repeats < 1){
+			printf("Usage: %s [repeats] [image.bmp ...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	printf("Image         Size        Bpp  On disk        Header    Pixels\n");
+	if (argc > 2){
+		for (i = 2; i < argc; i++){
+			bench_Decode(argv[i], repeats);
+		}
+		return 0;
+	}
+	for (i = 0; i < bench_images_total; i++){
+		if (bench_Generate(&bench_images[i]) != 0){
+			printf("Error, unable to write %s\n", bench_images[i].path);
+			return 1;
+		}
+		bench_Decode(bench_images[i].path, repeats);
+		remove(bench_images[i].path);
+	}
+	return 0;
+}
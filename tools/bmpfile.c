@@ -0,0 +1,223 @@
+/* bmpfile.c, Writes test bitmaps for the host tools of the pc98Launcher.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bmpfile.h"
+
+static void put16(unsigned char *p, unsigned int v){
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+}
+
+static void put32(unsigned char *p, unsigned long v){
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF;
+	p[3] = (v >> 24) & 0xFF;
+}
+
+void bmpfile_Write(FILE *out, int width, int height, int bpp, int compression, unsigned char colours[][3], int n_colours, unsigned char *data, unsigned long data_size){
+	// Write a bitmap with a 40 byte info header, a colour table of n_colours 
+	// entries, and a data section that is already packed or encoded. 
+	// A negative height is written as it is, for a top-down image.
+
+	unsigned char	hdr[54];
+	unsigned char	colour[4];
+	unsigned long	offset;
+	int				i;
+
+	offset = sizeof(hdr) + (n_colours * 4);
+	memset(hdr, 0, sizeof(hdr));
+	hdr[0] = 'B';
+	hdr[1] = 'M';
+	put32(hdr + 2, offset + data_size);
+	put32(hdr + 10, offset);
+	put32(hdr + 14, 40);
+	put32(hdr + 18, (unsigned long) width);
+	put32(hdr + 22, (unsigned long) height);
+	put16(hdr + 26, 1);
+	put16(hdr + 28, bpp);
+	put32(hdr + 30, compression);
+	put32(hdr + 34, data_size);
+	put32(hdr + 46, n_colours);
+	fwrite(hdr, 1, sizeof(hdr), out);
+	for (i = 0; i < n_colours; i++){
+		colour[0] = colours[i][2];
+		colour[1] = colours[i][1];
+		colour[2] = colours[i][0];
+		colour[3] = 0;
+		fwrite(colour, 1, 4, out);
+	}
+	fwrite(data, 1, data_size, out);
+}
+
+unsigned long bmpfile_Pack(unsigned char *pixels, int width, int height, int bpp, unsigned char *data){
+	// Pack an image into the padded, bottom-up rows of an uncompressed 
+	// 1, 4 or 8 bpp data section. Returns the size of the data section.
+
+	unsigned long	row_size;
+	unsigned char	*src;
+	unsigned char	*dst;
+	int				x, y;
+
+	row_size = ((((unsigned long) width * bpp) + 31) / 32) * 4;
+	memset(data, 0, row_size * height);
+	for (y = 0; y < height; y++){
+		src = pixels + ((unsigned long) y * width);
+		dst = data + ((unsigned long) (height - 1 - y) * row_size);
+		for (x = 0; x < width; x++){
+			if (bpp == 8){
+				dst[x] = src[x];
+			} else if (bpp == 4){
+				dst[x >> 1] |= (x & 1) ? (src[x] & 0x0F) : (src[x] << 4);
+			} else {
+				dst[x >> 3] |= (src[x] & 1) << (7 - (x & 7));
+			}
+		}
+	}
+	return row_size * height;
+}
+
+unsigned long bmpfile_PackRGB(unsigned char *rgb, int width, int height, int bpp, unsigned char *data){
+	// Pack an image of r, g, b bytes per pixel into the padded, bottom-up 
+	// rows of a 16bpp (5-5-5) or 24bpp data section. Returns the size of 
+	// the data section.
+
+	unsigned long	row_size;
+	unsigned char	*src;
+	unsigned char	*dst;
+	unsigned int	p;
+	int				x, y;
+
+	row_size = ((((unsigned long) width * bpp) + 31) / 32) * 4;
+	memset(data, 0, row_size * height);
+	for (y = 0; y < height; y++){
+		src = rgb + ((unsigned long) y * width * 3);
+		dst = data + ((unsigned long) (height - 1 - y) * row_size);
+		for (x = 0; x < width; x++){
+			if (bpp == 24){
+				dst[0] = src[2];
+				dst[1] = src[1];
+				dst[2] = src[0];
+				dst += 3;
+			} else {
+				p = ((src[0] >> 3) << 10) | ((src[1] >> 3) << 5) | (src[2] >> 3);
+				dst[0] = p & 0xFF;
+				dst[1] = p >> 8;
+				dst += 2;
+			}
+			src += 3;
+		}
+	}
+	return row_size * height;
+}
+
+void bmpfile_Screenshot(unsigned char *pixels, int width, int height, int n_colours, unsigned long seed){
+	// Something like a game screenshot: flat areas of colour, with a noisy
+	// band across the middle such as a dithered or detailed background
+
+	int x, y;
+
+	for (y = 0; y < height; y++){
+		for (x = 0; x < width; x++){
+			if ((y > (height / 3)) && (y < ((height * 2) / 3))){
+				seed = (seed * 1103515245UL) + 12345UL;
+				pixels[((unsigned long) y * width) + x] = (seed >> 16) % n_colours;
+			} else {
+				pixels[((unsigned long) y * width) + x] = (((x / 40) + ((y / 25) * 3)) * 7) % n_colours;
+			}
+		}
+	}
+}
+
+static unsigned char *rle_Literal(unsigned char *dst, unsigned char *src, int n, int bpp){
+	// Write n pixels in absolute mode, padded to a 16bit boundary
+
+	unsigned char	*start;
+	int				i;
+
+	*dst++ = 0;
+	*dst++ = n;
+	start = dst;
+	for (i = 0; i < n; i++){
+		if (bpp == 8){
+			*dst++ = src[i];
+		} else if (i & 1){
+			dst[-1] |= src[i] & 0x0F;
+		} else {
+			*dst++ = src[i] << 4;
+		}
+	}
+	if ((dst - start) & 1){
+		*dst++ = 0;
+	}
+	return dst;
+}
+
+unsigned long bmpfile_EncodeRLE(unsigned char *pixels, int width, int height, int bpp, unsigned char *data){
+	// Encode an image as the bottom-up data section of an RLE8 (bpp 8) 
+	// or RLE4 (bpp 4) bitmap, as a simple encoder would: runs of two or 
+	// more pixels, absolute mode for three or more pixels that don't 
+	// repeat, an end-of-line after every row and an end-of-bitmap after
+	// the last. data must hold at least ((width * 2) + 4) * height + 2 bytes.
+	// Returns the size of the data section.
+
+	unsigned char	*src;
+	unsigned char	*dst;
+	int				x, y;
+	int				run;
+	int				i;
+
+	dst = data;
+	for (y = height - 1; y >= 0; y--){
+		src = pixels + ((unsigned long) y * width);
+		x = 0;
+		while (x < width){
+			run = 1;
+			while (((x + run) < width) && (run < 255) && (src[x + run] == src[x])){
+				run++;
+			}
+			if (run < 2){
+				// Up to the next pair of matching pixels
+				while (((x + run) < width) && (run < 255) && !(((x + run + 1) < width) && (src[x + run] == src[x + run + 1]))){
+					run++;
+				}
+				if (run >= 3){
+					dst = rle_Literal(dst, src + x, run, bpp);
+					x += run;
+					continue;
+				}
+				for (i = 0; i < run; i++){
+					*dst++ = 1;
+					*dst++ = (bpp == 8) ? src[x + i] : ((src[x + i] << 4) | (src[x + i] & 0x0F));
+				}
+				x += run;
+				continue;
+			}
+			*dst++ = run;
+			*dst++ = (bpp == 8) ? src[x] : ((src[x] << 4) | (src[x] & 0x0F));
+			x += run;
+		}
+		*dst++ = 0;
+		*dst++ = 0;
+	}
+	*dst++ = 0;
+	*dst++ = 1;
+	return dst - data;
+}
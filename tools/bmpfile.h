@@ -0,0 +1,25 @@
+/* bmpfile.h, Writes test bitmaps for the host tools of the pc98Launcher.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Images are given as one byte per pixel (or r, g, b bytes for bmpfile_PackRGB), 
+// top row first, whatever their bpp
+
+void			bmpfile_Write(FILE *out, int width, int height, int bpp, int compression, unsigned char colours[][3], int n_colours, unsigned char *data, unsigned long data_size);
+unsigned long	bmpfile_Pack(unsigned char *pixels, int width, int height, int bpp, unsigned char *data);
+unsigned long	bmpfile_PackRGB(unsigned char *rgb, int width, int height, int bpp, unsigned char *data);
+unsigned long	bmpfile_EncodeRLE(unsigned char *pixels, int width, int height, int bpp, unsigned char *data);
+void			bmpfile_Screenshot(unsigned char *pixels, int width, int height, int n_colours, unsigned long seed);
@@ -0,0 +1,731 @@
+/* bmptest.c, Checks the BMP decoder of the pc98Launcher on the host.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Usage:
+//
+//	bmptest
+//
+// Each test writes a small bitmap to a temporary file, decodes it with the
+// same bmp.c as the launcher, and compares the pixels with those expected.
+// Prints one line per test and exits with 1 if any of them failed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../bmp.h"
+#include "bmpfile.h"
+
+#define TEST_REMAP		100		// Added to every colour table index, as pal_Alloc() would remap them
+#define TEST_SURFACE_FILL	0xEE	// Surface pixels which should not be written
+
+static int test_failures;
+
+static unsigned char test_colours[256][3];
+
+static void test_Result(char *name, int ok){
+	// Record and print the result of one test
+
+	if (ok){
+		printf("ok    %s\n", name);
+	} else {
+		printf("FAIL  %s\n", name);
+		test_failures++;
+	}
+}
+
+static FILE *test_ImageColours(int width, int height, int bpp, int compression, unsigned char colours[][3], int n_colours, unsigned char *data, unsigned long data_size){
+	// Write a bitmap to a temporary file, ready to be read from the start
+
+	FILE	*f;
+
+	f = tmpfile();
+	if (f == NULL){
+		printf("Error, unable to create a temporary file\n");
+		exit(1);
+	}
+	bmpfile_Write(f, width, height, bpp, compression, colours, n_colours, data, data_size);
+	rewind(f);
+	return f;
+}
+
+static FILE *test_Image(int width, int height, int bpp, int compression, int n_colours, unsigned char *data, unsigned long data_size){
+	// Write a bitmap with a colour table of distinct colours
+
+	int i;
+
+	for (i = 0; i < 256; i++){
+		test_colours[i][0] = (i * 37) & 0xFF;
+		test_colours[i][1] = (i * 91) & 0xFF;
+		test_colours[i][2] = (i * 13) & 0xFF;
+	}
+	return test_ImageColours(width, height, bpp, compression, test_colours, n_colours, data, data_size);
+}
+
+static int test_Decode(FILE *f, bmpdata_t *bmpdata, int remap){
+	// Decode a bitmap into bmpdata->pixels, with every colour table
+	// index moved up by 'remap' palette entries
+
+	int status;
+	int i;
+
+	memset(bmpdata, 0, sizeof(bmpdata_t));
+	status = bmp_ReadImage(f, bmpdata, 1, 1, 0);
+	if (status != BMP_OK){
+		return status;
+	}
+	for (i = 0; i < bmpdata->colours; i++){
+		bmpdata->palette[i].new_palette_entry = i + remap;
+	}
+	return bmp_ReadImage(f, bmpdata, 0, 0, 1);
+}
+
+static void test_FreePixels(bmpdata_t *bmpdata){
+	// Free the pixels of a decoded image, but keep bmpdata for the next one
+
+	if (bmpdata->pixels != NULL){
+		free(bmpdata->pixels);
+		bmpdata->pixels = NULL;
+	}
+}
+
+static int test_Compare(bmpdata_t *bmpdata, unsigned char *expected, int remap){
+	// Are the decoded pixels those expected, once remapped
+
+	unsigned int i;
+
+	if (bmpdata->pixels == NULL){
+		return 0;
+	}
+	for (i = 0; i < (bmpdata->width * bmpdata->height); i++){
+		if (bmpdata->pixels[i] != (unsigned char) (expected[i] + remap)){
+			printf("      pixel %u,%u is %d, expected %d\n", i % bmpdata->width, i / bmpdata->width, bmpdata->pixels[i], expected[i] + remap);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// ============================
+//
+// RLE8 and RLE4
+//
+// ============================
+
+// A 6x4 RLE8 image using every escape; rows are stored bottom row first
+static unsigned char test_rle8_data[] = {
+	3, 1,				// Bottom row: a run of three 1's
+	0, 3, 2, 3, 1, 0,	// three literal pixels, padded
+	0, 0,				// end of line
+	0, 2, 2, 0,			// delta two pixels right
+	2, 3,				// a run of two 3's
+	0, 0,				// end of line, leaving the rest of the row
+	0, 2, 1, 1,			// delta one right and one up, skipping a whole row
+	9, 2,				// a run of 2's, clipped at the right hand edge
+	0, 1				// end of bitmap
+};
+static unsigned char test_rle8_pixels[] = {
+	0, 2, 2, 2, 2, 2,
+	0, 0, 0, 0, 0, 0,
+	0, 0, 3, 3, 0, 0,
+	1, 1, 1, 2, 3, 1
+};
+
+// A 5x4 RLE4 image that ends early, leaving the top row
+static unsigned char test_rle4_data[] = {
+	5, 0x12,			// Bottom row: a run of alternating 1's and 2's
+	0, 0,
+	0, 3, 0x34, 0x50,	// three literal pixels in two bytes, no padding
+	0, 0,
+	0, 5, 0x12, 0x34, 0x50, 0,	// five literal pixels in three bytes, padded
+	0, 1				// end of bitmap before the top row
+};
+static unsigned char test_rle4_pixels[] = {
+	0, 0, 0, 0, 0,
+	1, 2, 3, 4, 5,
+	3, 4, 5, 0, 0,
+	1, 2, 1, 2, 1
+};
+
+// A 4x3 RLE8 image whose data stops at the last end of line
+static unsigned char test_rle8_noeob_data[] = {
+	4, 7,
+	0, 0,
+	0, 2, 1, 1,			// delta to the second pixel of the top row
+	0, 3, 5, 6, 7, 0,
+	0, 0
+};
+static unsigned char test_rle8_noeob_pixels[] = {
+	0, 5, 6, 7,
+	0, 0, 0, 0,
+	7, 7, 7, 7
+};
+
+static void test_RLE(char *name, int width, int height, int compression, unsigned char *data, unsigned long data_size, unsigned char *expected){
+	// Decode a hand made RLE image with and without remapping
+
+	bmpdata_t	*bmpdata;
+	FILE		*f;
+	int			bpp;
+	int			ok;
+
+	bpp = (compression == BMP_RLE8) ? BMP_8BPP : BMP_4BPP;
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	f = test_Image(width, height, bpp, compression, 16, data, data_size);
+	ok = (test_Decode(f, bmpdata, 0) == BMP_OK) && test_Compare(bmpdata, expected, 0);
+	test_FreePixels(bmpdata);
+	rewind(f);
+	ok = ok && (test_Decode(f, bmpdata, TEST_REMAP) == BMP_OK) && test_Compare(bmpdata, expected, TEST_REMAP);
+	fclose(f);
+	bmp_Destroy(bmpdata);
+	test_Result(name, ok);
+}
+
+static void test_RLESurface(){
+	// Decode the RLE8 escapes image onto part of a larger surface; every
+	// pixel of the image must be written, and nothing around it
+
+	static unsigned char surface[8 * 6];
+	bmpdata_t	*bmpdata;
+	bmpdest_t	dest;
+	FILE		*f;
+	int			x, y;
+	int			ok;
+
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	f = test_Image(6, 4, BMP_8BPP, BMP_RLE8, 16, test_rle8_data, sizeof(test_rle8_data));
+	memset(surface, TEST_SURFACE_FILL, sizeof(surface));
+	dest.buffer = surface;
+	dest.pitch = 8;
+	dest.x = 1;
+	dest.y = 1;
+	dest.clip_x1 = 0;
+	dest.clip_y1 = 0;
+	dest.clip_x2 = 7;
+	dest.clip_y2 = 5;
+	dest.scale = 1;
+	ok = (bmp_ReadImage(f, bmpdata, 1, 1, 0) == BMP_OK) && (bmp_ReadImageTo(f, bmpdata, &dest) == BMP_OK);
+	for (y = 0; (y < 6) && ok; y++){
+		for (x = 0; (x < 8) && ok; x++){
+			if ((x >= 1) && (x <= 6) && (y >= 1) && (y <= 4)){
+				ok = (surface[(y * 8) + x] == test_rle8_pixels[((y - 1) * 6) + (x - 1)]);
+			} else {
+				ok = (surface[(y * 8) + x] == TEST_SURFACE_FILL);
+			}
+			if (!ok){
+				printf("      surface pixel %d,%d is %d\n", x, y, surface[(y * 8) + x]);
+			}
+		}
+	}
+	fclose(f);
+	free(bmpdata);
+	test_Result("RLE8 escapes onto a surface", ok);
+}
+
+static void test_Used(){
+	// Decode an image onto a surface, scaled down by 2 and clipped at the left,
+	// noting the pixel values written; only those of the pixels which land on
+	// the surface are marked, and bmp_Remap() moves exactly those pixels
+
+	static unsigned char surface[8 * 6];
+	unsigned char	pixels[8 * 4];
+	unsigned char	data[8 * 4];
+	unsigned char	used[256];
+	unsigned char	remap[256];
+	unsigned char	expected;
+	unsigned long	size;
+	bmpdata_t	*bmpdata;
+	bmpdest_t	dest;
+	FILE		*f;
+	int			x, y, i;
+	int			inside;
+	int			ok;
+
+	for (i = 0; i < (8 * 4); i++){
+		pixels[i] = i + 1;
+	}
+	size = bmpfile_Pack(pixels, 8, 4, 8, data);
+	f = test_Image(8, 4, BMP_8BPP, BMP_UNCOMPRESSED, 64, data, size);
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	memset(surface, TEST_SURFACE_FILL, sizeof(surface));
+	dest.buffer = surface;
+	dest.pitch = 8;
+	dest.x = -2;
+	dest.y = 1;
+	dest.clip_x1 = 0;
+	dest.clip_y1 = 0;
+	dest.clip_x2 = 7;
+	dest.clip_y2 = 5;
+	dest.scale = 2;
+	memset(used, 0, sizeof(used));
+	bmp_SetUsed(used);
+	ok = (bmp_ReadImage(f, bmpdata, 1, 1, 0) == BMP_OK) && (bmp_ReadImageTo(f, bmpdata, &dest) == BMP_OK);
+	bmp_SetUsed(NULL);
+
+	// Pixels 4 and 6 of rows 0 and 2 are the ones written, to 0,1 - 1,2
+	for (i = 0; (i < 256) && ok; i++){
+		inside = (i == pixels[4]) || (i == pixels[6]) || (i == pixels[20]) || (i == pixels[22]);
+		if (used[i] != inside){
+			printf("      value %d is %s\n", i, used[i] ? "marked" : "not marked");
+			ok = 0;
+		}
+		remap[i] = i ^ 0x80;
+	}
+	bmp_Remap(bmpdata, &dest, remap);
+	for (y = 0; (y < 6) && ok; y++){
+		for (x = 0; (x < 8) && ok; x++){
+			inside = (x <= 1) && (y >= 1) && (y <= 2);
+			expected = inside ? (pixels[(((y - 1) * 2) * 8) + 4 + (x * 2)] ^ 0x80) : TEST_SURFACE_FILL;
+			if (surface[(y * 8) + x] != expected){
+				printf("      surface pixel %d,%d is %d, expected %d\n", x, y, surface[(y * 8) + x], expected);
+				ok = 0;
+			}
+		}
+	}
+
+	// Into its own pixel buffer, every pixel is written and remapped
+	memset(used, 0, sizeof(used));
+	bmp_SetUsed(used);
+	ok = ok && (bmp_ReadImage(f, bmpdata, 0, 0, 1) == BMP_OK);
+	bmp_SetUsed(NULL);
+	if (ok){
+		bmp_Remap(bmpdata, NULL, remap);
+		for (i = 0; i < (8 * 4); i++){
+			ok = ok && used[pixels[i]] && (bmpdata->pixels[i] == (pixels[i] ^ 0x80));
+		}
+		ok = ok && !used[0] && !used[33];
+	}
+	fclose(f);
+	bmp_Destroy(bmpdata);
+	test_Result("Values written noted and remapped, scaled and clipped", ok);
+}
+
+static void test_RLEEncoded(char *name, int width, int height, int bpp, int n_colours){
+	// Encode a screenshot as a simple RLE encoder would, and check
+	// it decodes back to the same pixels
+
+	bmpdata_t		*bmpdata;
+	unsigned char	*pixels;
+	unsigned char	*data;
+	unsigned long	size;
+	FILE			*f;
+	int				ok;
+
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	pixels = (unsigned char *) malloc((unsigned long) width * height);
+	data = (unsigned char *) malloc((((unsigned long) width * 2) + 4) * height + 2);
+	bmpfile_Screenshot(pixels, width, height, n_colours, 1);
+	size = bmpfile_EncodeRLE(pixels, width, height, bpp, data);
+	f = test_Image(width, height, bpp, (bpp == 8) ? BMP_RLE8 : BMP_RLE4, n_colours, data, size);
+	ok = (test_Decode(f, bmpdata, 0) == BMP_OK) && test_Compare(bmpdata, pixels, 0);
+	fclose(f);
+	bmp_Destroy(bmpdata);
+	free(pixels);
+	free(data);
+	test_Result(name, ok);
+}
+
+// ============================
+//
+// Unpacking 4bpp and 1bpp, and quantizing 16bpp and 24bpp
+//
+// ============================
+
+// Widths which end on every possible part of a byte, and a whole screen
+static int test_widths[] = { 1, 2, 3, 7, 8, 9, 15, 16, 17, 320 };
+#define test_widths_total	(sizeof(test_widths) / sizeof(int))
+
+static void test_Packed(char *name, int bpp, int remap){
+	// Decode screenshots of each test width, packed at 'bpp', and with
+	// every colour table index moved up by 'remap' palette entries
+
+	bmpdata_t		*bmpdata;
+	unsigned char	*pixels;
+	unsigned char	*data;
+	unsigned long	size;
+	FILE			*f;
+	int				n_colours;
+	int				i;
+	int				ok;
+
+	n_colours = (bpp == 8) ? 192 : (1 << bpp);
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	pixels = (unsigned char *) malloc(320 * 9);
+	data = (unsigned char *) malloc(320 * 9);
+	ok = 1;
+	for (i = 0; (i < test_widths_total) && ok; i++){
+		bmpfile_Screenshot(pixels, test_widths[i], 9, n_colours, i + 1);
+		size = bmpfile_Pack(pixels, test_widths[i], 9, bpp, data);
+		f = test_Image(test_widths[i], 9, bpp, BMP_UNCOMPRESSED, n_colours, data, size);
+		ok = (test_Decode(f, bmpdata, remap) == BMP_OK) && test_Compare(bmpdata, pixels, remap);
+		if (!ok){
+			printf("      at width %d\n", test_widths[i]);
+		}
+		test_FreePixels(bmpdata);
+		fclose(f);
+	}
+	bmp_Destroy(bmpdata);
+	free(pixels);
+	free(data);
+	test_Result(name, ok);
+}
+
+// Colours and the entries of the fixed quantizer palette they are nearest to;
+// cube entries are ((r * 8) + g) * 4 + b, greys follow at 192
+static unsigned char test_quant_rgb[][3] = {
+	{ 0, 0, 0 },		// cube 0,0,0
+	{ 255, 255, 255 },	// cube 5,7,3
+	{ 255, 0, 0 },		// cube 5,0,0
+	{ 0, 255, 0 },		// cube 0,7,0
+	{ 0, 0, 255 },		// cube 0,0,3
+	{ 255, 128, 0 },	// cube 5,4,0
+	{ 128, 128, 128 },	// grey 8 (136), closer than cube 3,4,2 (153,145,170)
+	{ 64, 64, 64 },		// grey 4 (68)
+	{ 0, 0, 128 },		// cube 0,0,2
+	{ 100, 150, 200 }	// cube 2,4,2 (102,145,170)
+};
+static unsigned char test_quant_expected[] = { 0, 191, 160, 28, 3, 176, 200, 196, 2, 82 };
+#define test_quant_total	(sizeof(test_quant_expected))
+
+// A flat 50% blue (0, 0, 128), half way between cube levels 1 (85) and 2 (170), 
+// ordered dithered with the 4x4 Bayer matrix; rows counted from the top of the
+// image. Entry 2 is used where the matrix is 8 or more, a checkerboard...
+static unsigned char test_dither24_expected[16] = {
+	1, 2, 1, 2,
+	2, 1, 2, 1,
+	1, 2, 1, 2,
+	2, 1, 2, 1
+};
+
+// ...but as 5-5-5 the blue is 16, which expands to 132, and entry 2 is 
+// used where the matrix is 7 or more
+static unsigned char test_dither16_expected[16] = {
+	1, 2, 1, 2,
+	2, 1, 2, 1,
+	1, 2, 1, 2,
+	2, 2, 2, 1
+};
+
+static void test_Quant(char *name, int bpp){
+	// Quantize a row of each test colour without dithering
+
+	bmpdata_t		*bmpdata;
+	unsigned char	data[test_quant_total * 4];
+	unsigned long	size;
+	FILE			*f;
+	int				ok;
+
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	size = bmpfile_PackRGB(test_quant_rgb[0], test_quant_total, 1, bpp, data);
+	f = test_Image(test_quant_total, 1, bpp, BMP_UNCOMPRESSED, 0, data, size);
+	bmp_SetDither(0);
+	ok = (test_Decode(f, bmpdata, 0) == BMP_OK) && test_Compare(bmpdata, test_quant_expected, 0);
+	ok = ok && (bmpdata->colours == BMP_QUANT_COLOURS);
+	ok = ok && (bmpdata->palette[200].r == 136) && (bmpdata->palette[82].b == 170);
+	bmp_SetDither(1);
+	fclose(f);
+	bmp_Destroy(bmpdata);
+	test_Result(name, ok);
+}
+
+static void test_Dither(char *name, int bpp, unsigned char *pattern){
+	// Quantize a flat 8x8 image with dithering; the pattern must repeat 
+	// every 4 pixels across and down, starting from the top left
+
+	bmpdata_t		*bmpdata;
+	unsigned char	rgb[8 * 8 * 3];
+	unsigned char	expected[8 * 8];
+	unsigned char	data[8 * 8 * 3];
+	unsigned long	size;
+	FILE			*f;
+	int				i;
+	int				ok;
+
+	for (i = 0; i < (8 * 8); i++){
+		rgb[(i * 3)] = 0;
+		rgb[(i * 3) + 1] = 0;
+		rgb[(i * 3) + 2] = 128;
+		expected[i] = pattern[(((i / 8) & 0x03) * 4) + (i & 0x03)];
+	}
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	size = bmpfile_PackRGB(rgb, 8, 8, bpp, data);
+	f = test_Image(8, 8, bpp, BMP_UNCOMPRESSED, 0, data, size);
+	ok = (test_Decode(f, bmpdata, 0) == BMP_OK) && test_Compare(bmpdata, expected, 0);
+	fclose(f);
+	bmp_Destroy(bmpdata);
+	test_Result(name, ok);
+}
+
+// ============================
+//
+// Median cut reduction of large colour tables
+//
+// ============================
+
+static void test_Reduce(char *name, unsigned char colours[][3], int max_colours, int expect_colours, int max_error){
+	// Decode a 16x16 image using each entry of a 256 colour table once, 
+	// reduced to at most max_colours. Exactly expect_colours entries must
+	// be used, each within max_error of the colours mapped to it on every
+	// channel, and every pixel must point at the entry for its colour.
+
+	bmpdata_t		*bmpdata;
+	pal_entry_t		*entry;
+	unsigned char	pixels[256];
+	unsigned char	data[256];
+	unsigned char	used[256];
+	unsigned long	size;
+	FILE			*f;
+	int				n_used;
+	int				i, k;
+	int				ok;
+
+	for (i = 0; i < 256; i++){
+		pixels[i] = i;
+	}
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	size = bmpfile_Pack(pixels, 16, 16, 8, data);
+	f = test_ImageColours(16, 16, 8, BMP_UNCOMPRESSED, colours, 256, data, size);
+	bmp_SetMaxColours(max_colours);
+	ok = (bmp_ReadImage(f, bmpdata, 1, 1, 1) == BMP_OK);
+	bmp_SetMaxColours(BMP_MAX_COLOURS);
+
+	memset(used, 0, sizeof(used));
+	n_used = 0;
+	for (i = 0; (i < 256) && ok; i++){
+		entry = &bmpdata->palette[i];
+		if (entry->new_palette_entry >= max_colours){
+			printf("      colour %d is reduced to entry %d\n", i, entry->new_palette_entry);
+			ok = 0;
+			break;
+		}
+		if (!used[entry->new_palette_entry]){
+			used[entry->new_palette_entry] = 1;
+			n_used++;
+		}
+		for (k = 0; k < 3; k++){
+			if (abs((k == 0 ? entry->r : (k == 1 ? entry->g : entry->b)) - colours[i][k]) > max_error){
+				printf("      colour %d (%d,%d,%d) is reduced to %d,%d,%d\n", i, colours[i][0], colours[i][1], colours[i][2], entry->r, entry->g, entry->b);
+				ok = 0;
+				break;
+			}
+		}
+		if (ok && (bmpdata->pixels[i] != entry->new_palette_entry)){
+			printf("      pixel %d is %d, expected entry %d\n", i, bmpdata->pixels[i], entry->new_palette_entry);
+			ok = 0;
+		}
+	}
+	if (ok && (n_used != expect_colours)){
+		printf("      %d entries used, expected %d\n", n_used, expect_colours);
+		ok = 0;
+	}
+	fclose(f);
+	bmp_Destroy(bmpdata);
+	test_Result(name, ok);
+}
+
+static void test_Reduction(){
+	// Colour tables with a known best reduction
+
+	static unsigned char colours[256][3];
+	int i;
+
+	// Eight clusters of 32 close colours, at the corners of the RGB cube
+	for (i = 0; i < 256; i++){
+		colours[i][0] = (i & 0x20) ? 250 - (i & 0x03) : (i & 0x03);
+		colours[i][1] = (i & 0x40) ? 250 - ((i >> 2) & 0x03) : ((i >> 2) & 0x03);
+		colours[i][2] = (i & 0x80) ? 250 - ((i >> 4) & 0x01) : ((i >> 4) & 0x01);
+	}
+	test_Reduce("Median cut of 8 clusters to 8 colours", colours, 8, 8, 3);
+
+	// A ramp of every grey, cut into 16 boxes of 16
+	for (i = 0; i < 256; i++){
+		colours[i][0] = i;
+		colours[i][1] = i;
+		colours[i][2] = i;
+	}
+	test_Reduce("Median cut of 256 greys to 16 colours", colours, 16, 16, 8);
+
+	// Four colours, each repeated 64 times, need no more than four entries
+	for (i = 0; i < 256; i++){
+		colours[i][0] = (i & 0x01) ? 200 : 10;
+		colours[i][1] = (i & 0x02) ? 200 : 10;
+		colours[i][2] = 100;
+	}
+	test_Reduce("Median cut of 4 repeated colours", colours, 8, 4, 0);
+}
+
+// ============================
+//
+// Decode buffer pool
+//
+// ============================
+
+#define TEST_POOL_ROUNDS	2000	// Images decoded by the soak test
+#define TEST_POOL_HELD		4		// Most images held at once; more than there are pool buffers
+
+typedef struct testimage {
+	int				width;
+	int				height;
+	int				bpp;
+	unsigned long	cut;		// Bytes cut off the end of the data section, so decoding fails
+	unsigned char	*pixels;
+	FILE			*f;
+} testimage_t;
+
+static testimage_t test_pool_images[] = {
+	{ 320,	200,	8,	0 },	// Exactly one pool buffer
+	{ 16,	16,		8,	0 },
+	{ 37,	23,		4,	0 },
+	{ 400,	200,	8,	0 },	// Too big for a pool buffer
+	{ 160,	100,	1,	0 },
+	{ 320,	200,	4,	100 },	// Truncated
+};
+#define test_pool_images_total	(sizeof(test_pool_images) / sizeof(testimage_t))
+
+static void test_Pool(){
+	// Decode a long random sequence of images of mixed sizes with 
+	// bmp_ReadImagePooled(), holding several at once, and destroy each 
+	// one only after checking it was not overwritten while it was held.
+	// Both the pool and the fallback allocation must be used, and every 
+	// pool buffer must be free again at the end.
+
+	testimage_t		*image;
+	bmpdata_t		*held[TEST_POOL_HELD];
+	int				held_image[TEST_POOL_HELD];
+	unsigned char	*buffers[BMP_POOL_BUFFERS + 1];
+	unsigned char	*data;
+	unsigned long	size;
+	unsigned long	seed;
+	int				n_colours;
+	int				n_pooled, n_fallback, n_failed;
+	int				status;
+	int				round;
+	int				slot;
+	int				i;
+	int				ok;
+
+	data = (unsigned char *) malloc(400 * 200);
+	for (i = 0; i < test_pool_images_total; i++){
+		image = &test_pool_images[i];
+		image->pixels = (unsigned char *) malloc(image->width * image->height);
+		n_colours = (image->bpp == 8) ? 192 : (1 << image->bpp);
+		bmpfile_Screenshot(image->pixels, image->width, image->height, n_colours, i + 1);
+		size = bmpfile_Pack(image->pixels, image->width, image->height, image->bpp, data);
+		image->f = test_Image(image->width, image->height, image->bpp, BMP_UNCOMPRESSED, n_colours, data, size - image->cut);
+	}
+	free(data);
+
+	for (slot = 0; slot < TEST_POOL_HELD; slot++){
+		held[slot] = NULL;
+	}
+	ok = 1;
+	n_pooled = 0;
+	n_fallback = 0;
+	n_failed = 0;
+	seed = 1;
+	for (round = 0; (round < TEST_POOL_ROUNDS) && ok; round++){
+		seed = (seed * 1103515245UL) + 12345UL;
+		slot = (seed >> 16) % TEST_POOL_HELD;
+		if (held[slot] != NULL){
+			ok = test_Compare(held[slot], test_pool_images[held_image[slot]].pixels, 0);
+			bmp_Destroy(held[slot]);
+			held[slot] = NULL;
+			continue;
+		}
+		held_image[slot] = (seed >> 20) % test_pool_images_total;
+		image = &test_pool_images[held_image[slot]];
+		held[slot] = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+		rewind(image->f);
+		status = bmp_ReadImage(image->f, held[slot], 1, 1, 0);
+		if (status == BMP_OK){
+			status = bmp_ReadImagePooled(image->f, held[slot]);
+		}
+		if (image->cut){
+			// The buffer must have been handed back
+			ok = (status != BMP_OK) && (held[slot]->pixels == NULL);
+			bmp_Destroy(held[slot]);
+			held[slot] = NULL;
+			n_failed++;
+		} else if (status != BMP_OK){
+			ok = 0;
+		} else if (held[slot]->pooled){
+			n_pooled++;
+		} else {
+			n_fallback++;
+		}
+	}
+	for (slot = 0; slot < TEST_POOL_HELD; slot++){
+		if (held[slot] != NULL){
+			ok = ok && test_Compare(held[slot], test_pool_images[held_image[slot]].pixels, 0);
+			bmp_Destroy(held[slot]);
+		}
+	}
+	printf("      %d pooled, %d allocated, %d failed\n", n_pooled, n_fallback, n_failed);
+	ok = ok && (n_pooled > 0) && (n_fallback > 0) && (n_failed > 0);
+
+	// Nothing should still be holding a pool buffer
+	for (i = 0; i <= BMP_POOL_BUFFERS; i++){
+		buffers[i] = bmp_PoolAcquire(BMP_POOL_BUFFER_SIZE);
+	}
+	for (i = 0; i < BMP_POOL_BUFFERS; i++){
+		if (buffers[i] == NULL){
+			printf("      pool buffer %d was never handed back\n", i);
+			ok = 0;
+		} else {
+			bmp_PoolRelease(buffers[i]);
+		}
+	}
+	ok = ok && (buffers[BMP_POOL_BUFFERS] == NULL);
+
+	for (i = 0; i < test_pool_images_total; i++){
+		fclose(test_pool_images[i].f);
+		free(test_pool_images[i].pixels);
+	}
+	test_Result("Decode buffer pool soak", ok);
+}
+
+int main(int argc, char **argv){
+
+	test_RLE("RLE8 escapes", 6, 4, BMP_RLE8, test_rle8_data, sizeof(test_rle8_data), test_rle8_pixels);
+	test_RLE("RLE4 escapes, early end of bitmap", 5, 4, BMP_RLE4, test_rle4_data, sizeof(test_rle4_data), test_rle4_pixels);
+	test_RLE("RLE8 without an end of bitmap", 4, 3, BMP_RLE8, test_rle8_noeob_data, sizeof(test_rle8_noeob_data), test_rle8_noeob_pixels);
+	test_RLESurface();
+	test_Used();
+	test_RLEEncoded("RLE8 320x200 screenshot", 320, 200, 8, 192);
+	test_RLEEncoded("RLE8 37x23 screenshot", 37, 23, 8, 192);
+	test_RLEEncoded("RLE4 320x200 screenshot", 320, 200, 4, 16);
+	test_RLEEncoded("RLE4 37x23 screenshot", 37, 23, 4, 16);
+	test_Packed("8bpp", 8, 0);
+	test_Packed("8bpp remapped", 8, TEST_REMAP);
+	test_Packed("4bpp unpacking", 4, 0);
+	test_Packed("4bpp unpacking, remapped", 4, TEST_REMAP);
+	test_Packed("1bpp unpacking", 1, 0);
+	test_Packed("1bpp unpacking, remapped", 1, TEST_REMAP);
+	test_Quant("24bpp quantized to the fixed palette", 24);
+	test_Quant("16bpp quantized to the fixed palette", 16);
+	test_Dither("24bpp ordered dither", 24, test_dither24_expected);
+	test_Dither("16bpp ordered dither", 16, test_dither16_expected);
+	test_Reduction();
+	test_Pool();
+
+	if (test_failures){
+		printf("%d test(s) failed\n", test_failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
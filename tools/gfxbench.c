@@ -0,0 +1,302 @@
+/* gfxbench.c, Checks and times the drawing primitives of the pc98Launcher on the host.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Usage:
+//
+//	gfxbench [repeats]
+//
+// gfx.c is built against the stand-in DJGPP headers in host/, drawing into
+// vram_buffer as it does on the PC-98. Every primitive is first checked
+// against a plain loop writing one byte at a time, much as the primitives
+// did before they had span kernels, by drawing thousands of random (often
+// partly offscreen) boxes and bitmaps with both and comparing the screens.
+//
+// Then each primitive, and its byte loop, is timed drawing 40 row high
+// shapes of a range of widths, starting at each of the 4 alignments to a
+// word. Times are for the host, so they compare the two rather than
+// predict a PC-98.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../gfx.h"
+
+#define BENCH_CHECKS		20000	// Random shapes drawn when checking the primitives
+#define BENCH_PIXELS		4000000	// Pixels drawn by each timing, whatever the width
+#define BENCH_HEIGHT		40		// Height of the shapes timed
+#define BENCH_KEY			0		// Key colour of the keyed bitmaps
+
+enum {
+	BENCH_FILL,
+	BENCH_TRANSLUCENT,
+	BENCH_BOX,
+	BENCH_BITMAP,
+	BENCH_KEYED,
+	BENCH_PRIMITIVES
+};
+
+static char *bench_names[BENCH_PRIMITIVES] = {
+	"BoxFill",
+	"BoxFillTranslucent",
+	"Box",
+	"Bitmap",
+	"BitmapKeyed"
+};
+
+static int bench_widths[] = { 1, 3, 8, 17, 64, 320, 640 };
+#define bench_widths_total	(sizeof(bench_widths) / sizeof(int))
+
+static unsigned char	bench_screen[GFX_ROWS * GFX_COLS];	// Drawn by the byte loops
+static unsigned char	bench_pixels[GFX_ROWS * GFX_COLS];	// Pixels of the test bitmap
+
+static int bench_Clip(int *x1, int *y1, int *x2, int *y2){
+	// Order the corners of a box and clip it to the screen, as gfx.c does
+
+	int temp;
+
+	if (*y1 > *y2){
+		temp = *y1;
+		*y1 = *y2;
+		*y2 = temp;
+	}
+	if (*x1 > *x2){
+		temp = *x1;
+		*x1 = *x2;
+		*x2 = temp;
+	}
+	if ((*x2 < 0) || (*y2 < 0) || (*x1 >= GFX_COLS) || (*y1 >= GFX_ROWS)){
+		return 0;
+	}
+	if (*x1 < 0) *x1 = 0;
+	if (*y1 < 0) *y1 = 0;
+	if (*x2 >= GFX_COLS) *x2 = GFX_COLS - 1;
+	if (*y2 >= GFX_ROWS) *y2 = GFX_ROWS - 1;
+	return 1;
+}
+
+static void bench_BoxFill(int x1, int y1, int x2, int y2, unsigned char palette){
+
+	unsigned char	*p;
+	int				x, y;
+
+	if (!bench_Clip(&x1, &y1, &x2, &y2)){
+		return;
+	}
+	for (y = y1; y <= y2; y++){
+		p = bench_screen + (y * GFX_COLS) + x1;
+		for (x = x1; x <= x2; x++){
+			*p++ = palette;
+		}
+	}
+}
+
+static void bench_BoxFillTranslucent(int x1, int y1, int x2, int y2, unsigned char palette){
+
+	unsigned char	*p;
+	int				x, y;
+	int				flip;
+
+	if (!bench_Clip(&x1, &y1, &x2, &y2)){
+		return;
+	}
+	for (y = y1; y <= y2; y++){
+		p = bench_screen + (y * GFX_COLS) + x1;
+		flip = (x1 + y) & 1;
+		for (x = x1; x <= x2; x++){
+			if (!flip){
+				*p = palette;
+			}
+			p++;
+			flip = !flip;
+		}
+	}
+}
+
+static void bench_Box(int x1, int y1, int x2, int y2, unsigned char palette){
+
+	int left, right, top, bottom;
+	int x, y;
+
+	left = (x1 < x2) ? x1 : x2;
+	right = (x1 < x2) ? x2 : x1;
+	top = (y1 < y2) ? y1 : y2;
+	bottom = (y1 < y2) ? y2 : y1;
+	if (!bench_Clip(&x1, &y1, &x2, &y2)){
+		return;
+	}
+	for (x = x1; x <= x2; x++){
+		if (y1 == top){
+			bench_screen[(y1 * GFX_COLS) + x] = palette;
+		}
+		if (y2 == bottom){
+			bench_screen[(y2 * GFX_COLS) + x] = palette;
+		}
+	}
+	for (y = y1; y <= y2; y++){
+		if (x1 == left){
+			bench_screen[(y * GFX_COLS) + x1] = palette;
+		}
+		if (x2 == right){
+			bench_screen[(y * GFX_COLS) + x2] = palette;
+		}
+	}
+}
+
+static void bench_Bitmap(int x, int y, bmpdata_t *bmpdata, int keyed){
+
+	unsigned char	p;
+	int				sx, sy;
+
+	for (sy = 0; sy < bmpdata->height; sy++){
+		for (sx = 0; sx < bmpdata->width; sx++){
+			if (((x + sx) < 0) || ((y + sy) < 0) || ((x + sx) >= GFX_COLS) || ((y + sy) >= GFX_ROWS)){
+				continue;
+			}
+			p = bmpdata->pixels[(sy * bmpdata->width) + sx];
+			if (!keyed || (p != BENCH_KEY)){
+				bench_screen[((y + sy) * GFX_COLS) + x + sx] = p;
+			}
+		}
+	}
+}
+
+static void bench_Draw(int primitive, int byte_loop, int x1, int y1, int x2, int y2, unsigned char palette, bmpdata_t *bmpdata){
+	// Draw one shape with a primitive of gfx.c, or its byte loop
+
+	if (byte_loop){
+		switch (primitive){
+			case BENCH_FILL:		bench_BoxFill(x1, y1, x2, y2, palette); break;
+			case BENCH_TRANSLUCENT:	bench_BoxFillTranslucent(x1, y1, x2, y2, palette); break;
+			case BENCH_BOX:			bench_Box(x1, y1, x2, y2, palette); break;
+			case BENCH_BITMAP:		bench_Bitmap(x1, y1, bmpdata, 0); break;
+			default:				bench_Bitmap(x1, y1, bmpdata, 1); break;
+		}
+	} else {
+		switch (primitive){
+			case BENCH_FILL:		gfx_BoxFill(x1, y1, x2, y2, palette); break;
+			case BENCH_TRANSLUCENT:	gfx_BoxFillTranslucent(x1, y1, x2, y2, palette); break;
+			case BENCH_BOX:			gfx_Box(x1, y1, x2, y2, palette); break;
+			case BENCH_BITMAP:		gfx_Bitmap(x1, y1, bmpdata); break;
+			default:				gfx_BitmapKeyed(x1, y1, bmpdata, BENCH_KEY); break;
+		}
+	}
+}
+
+static int bench_Check(){
+	// Draw random shapes with both, and compare the screens after each one
+
+	bmpdata_t	bmpdata;
+	unsigned char	palette;
+	int			primitive;
+	int			x1, y1, x2, y2;
+	int			i;
+
+	memset(&bmpdata, 0, sizeof(bmpdata_t));
+	bmpdata.pixels = bench_pixels;
+	memset(vram_buffer, 0, sizeof(bench_screen));
+	memset(bench_screen, 0, sizeof(bench_screen));
+	srand(1);
+	for (i = 0; i < BENCH_CHECKS; i++){
+		primitive = rand() % BENCH_PRIMITIVES;
+		x1 = (rand() % (GFX_COLS + 160)) - 80;
+		y1 = (rand() % (GFX_ROWS + 100)) - 50;
+		x2 = x1 + (rand() % 140) - 20;
+		y2 = y1 + (rand() % 70) - 10;
+		bmpdata.width = 1 + (rand() % 100);
+		bmpdata.height = 1 + (rand() % 50);
+		palette = rand() & 0xFF;
+		bench_Draw(primitive, 0, x1, y1, x2, y2, palette, &bmpdata);
+		bench_Draw(primitive, 1, x1, y1, x2, y2, palette, &bmpdata);
+		if (memcmp(vram_buffer, bench_screen, sizeof(bench_screen)) != 0){
+			printf("Error, gfx_%s(%d, %d, %d, %d) differs from the byte loop\n", bench_names[primitive], x1, y1, x2, y2);
+			return -1;
+		}
+	}
+	printf("%d random shapes drawn the same by gfx.c and the byte loops\n\n", BENCH_CHECKS);
+	return 0;
+}
+
+static double bench_Time(int primitive, int byte_loop, int width, int repeats){
+	// Microseconds to draw one shape of a width, averaged over each alignment
+
+	bmpdata_t	bmpdata;
+	clock_t		start;
+	clock_t		elapsed;
+	int			n;
+	int			i, r;
+
+	memset(&bmpdata, 0, sizeof(bmpdata_t));
+	bmpdata.pixels = bench_pixels;
+	bmpdata.width = width;
+	bmpdata.height = BENCH_HEIGHT;
+	n = BENCH_PIXELS / (width * BENCH_HEIGHT);
+	if (n < 4){
+		n = 4;
+	}
+	elapsed = 0;
+	for (r = 0; r < repeats; r++){
+		start = clock();
+		for (i = 0; i < n; i++){
+			// Every alignment, and clipped at the right when 640 wide
+			bench_Draw(primitive, byte_loop, i & 0x03, 10, (i & 0x03) + width - 1, 10 + BENCH_HEIGHT - 1, i, &bmpdata);
+		}
+		elapsed += clock() - start;
+	}
+	return ((double) elapsed * 1000000.0) / CLOCKS_PER_SEC / ((double) n * repeats);
+}
+
+int main(int argc, char **argv){
+
+	int repeats;
+	int primitive;
+	int i;
+
+	repeats = 3;
+	if (argc > 1){
+		repeats = atoi(argv[1]);
+		if (repeats < 1){
+			printf("Usage: %s [repeats]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	for (i = 0; i < sizeof(bench_pixels); i++){
+		bench_pixels[i] = (i * 7) % 13;
+	}
+	if (bench_Check() != 0){
+		return 1;
+	}
+
+	printf("Microseconds per %d row shape, as byte loop -> gfx.c\n\n", BENCH_HEIGHT);
+	printf("Width ");
+	for (primitive = 0; primitive < BENCH_PRIMITIVES; primitive++){
+		printf(" %20s", bench_names[primitive]);
+	}
+	printf("\n");
+	for (i = 0; i < bench_widths_total; i++){
+		printf("%5d ", bench_widths[i]);
+		for (primitive = 0; primitive < BENCH_PRIMITIVES; primitive++){
+			printf("   %8.2f -> %7.2f",
+				bench_Time(primitive, 1, bench_widths[i], repeats),
+				bench_Time(primitive, 0, bench_widths[i], repeats));
+		}
+		printf("\n");
+	}
+	return 0;
+}
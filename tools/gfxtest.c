@@ -0,0 +1,255 @@
+/* gfxtest.c, Checks the vertical blank handling of the pc98Launcher on the host.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Usage:
+//
+//	gfxtest
+//
+// gfx.c is built against the stand-in DJGPP headers in host/, and reads
+// the GDC status port from a mock GDC instead. Its beam moves on by one
+// position every time the status is read, and is in vertical blank for
+// the last part of each frame. Each test flips with one of the vsync
+// modes, and checks where the beam was when the flip returned, and when
+// the palette was written, and that a GDC which never reports a blank
+// turns vsync off. Prints one line per test and exits with 1 if any of
+// them failed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../gfx.h"
+#include "../palette.h"
+#include "../pegc.h"
+#include "host.h"
+
+#define TEST_FRAME		400		// Status reads per frame of the mock GDC
+#define TEST_BLANK		40		// Of which the last are in vertical blank
+
+#define TEST_BEAM		0		// The mock GDC moves the beam
+#define TEST_STUCK_OFF	1		// The status never shows vertical blank
+#define TEST_STUCK_ON	2		// The status always shows vertical blank
+
+static int				test_gdc;			// One of TEST_BEAM or TEST_STUCK_*
+static unsigned long	test_beam;			// Status reads so far; the beam is at test_beam % TEST_FRAME
+static unsigned char	test_status;		// The last status read
+static unsigned long	test_blanks;		// Blanks seen to start by the status reads
+static unsigned long	test_pal_writes;	// Palette register writes
+static unsigned long	test_pal_outside;	// ... made when the last status read was not in blank
+static int				test_failures;
+
+static unsigned char test_Inport(unsigned short port){
+	// The mock GDC status
+
+	unsigned char status;
+
+	if (port != PEGC_GDC_STATUS_ADDR){
+		return 0;
+	}
+	switch (test_gdc){
+		case TEST_STUCK_OFF:
+			status = 0;
+			break;
+		case TEST_STUCK_ON:
+			status = GDC_STATUS_VSYNC;
+			break;
+		default:
+			status = ((test_beam % TEST_FRAME) >= (TEST_FRAME - TEST_BLANK)) ? GDC_STATUS_VSYNC : 0;
+			test_beam++;
+			break;
+	}
+	if (status && !test_status){
+		test_blanks++;
+	}
+	test_status = status;
+	return status;
+}
+
+static void test_Outport(unsigned short port, unsigned char value){
+	// The palette registers are only to be written in vertical blank
+
+	if ((port == PEGC_PALLETE_SEL_ADDR) || (port == PEGC_RED_ADDR) || (port == PEGC_GREEN_ADDR) || (port == PEGC_BLUE_ADDR)){
+		test_pal_writes++;
+		if (!test_status){
+			test_pal_outside++;
+		}
+	}
+}
+
+static void test_Result(char *name, int ok){
+	// Record and print the result of one test
+
+	if (ok){
+		printf("ok    %s\n", name);
+	} else {
+		printf("FAIL  %s\n", name);
+		test_failures++;
+	}
+}
+
+static void test_Reset(int gdc, unsigned long beam){
+	// A new mock GDC, with its beam at a position of the frame
+
+	test_gdc = gdc;
+	test_beam = beam;
+	test_status = 0;
+	test_blanks = 0;
+	test_pal_writes = 0;
+	test_pal_outside = 0;
+	host_inports = 0;
+	host_movedata_calls = 0;
+	host_movedata_bytes = 0;
+}
+
+static int test_AtBlankStart(){
+	// Was the last status read the first one of a vertical blank
+
+	if (!test_status || (((test_beam - 1) % TEST_FRAME) != (TEST_FRAME - TEST_BLANK))){
+		printf("      returned at beam position %lu\n", (test_beam - 1) % TEST_FRAME);
+		return 0;
+	}
+	return 1;
+}
+
+static void test_Wait(){
+	// A flip waits for the start of the next blank, then copies and uploads the palette
+
+	int ok;
+
+	gfx_SetVsync(GFX_VSYNC_WAIT);
+
+	test_Reset(TEST_BEAM, 0);
+	gfx_Dirty(0, 0, GFX_COLS - 1, 99);
+	pal_Set(7, 10, 20, 30);
+	gfx_Flip();
+	ok = test_AtBlankStart() && (test_blanks == 1) && (host_movedata_bytes == (100 * GFX_COLS));
+	ok = ok && (test_pal_writes == 4) && (test_pal_outside == 0);
+	test_Result("Flip waits for the next blank, and writes the palette in it", ok);
+
+	// Part way through a blank; too late to start, so it waits for the one after
+	test_Reset(TEST_BEAM, TEST_FRAME - (TEST_BLANK / 2));
+	test_status = GDC_STATUS_VSYNC;
+	gfx_Dirty(0, 0, 9, 9);
+	gfx_Flip();
+	ok = test_AtBlankStart() && (test_beam > TEST_FRAME) && (test_blanks == 1);
+	test_Result("Flip started in a blank waits for the next one", ok);
+
+	// A palette change on its own still waits
+	test_Reset(TEST_BEAM, 0);
+	pal_Set(7, 40, 50, 60);
+	gfx_Flip();
+	ok = test_AtBlankStart() && (host_movedata_calls == 0) && (test_pal_writes == 4) && (test_pal_outside == 0);
+	test_Result("Palette change alone is written in the next blank", ok);
+
+	// Nothing to do, nothing to wait for
+	test_Reset(TEST_BEAM, 0);
+	gfx_Flip();
+	test_Result("Flip with nothing damaged does not wait", host_inports == 0);
+}
+
+static void test_Split(){
+	// A large copy is spread over as many blanks as the budget needs
+
+	unsigned long bytes;
+	unsigned long blanks;
+	int ok;
+
+	gfx_SetVsync(GFX_VSYNC_SPLIT);
+	test_Reset(TEST_BEAM, 0);
+	gfx_Dirty(0, 0, GFX_COLS - 1, GFX_ROWS - 1);
+	gfx_Flip();
+	bytes = GFX_COLS * GFX_ROWS;
+	blanks = (bytes + GFX_VSYNC_BUDGET - 1) / GFX_VSYNC_BUDGET;
+	ok = (host_movedata_bytes == bytes) && (host_movedata_calls == blanks) && (test_blanks == blanks);
+	if (!ok){
+		printf("      %lu bytes in %lu copies over %lu blanks, expected %lu blanks\n", host_movedata_bytes, host_movedata_calls, test_blanks, blanks);
+	}
+	test_Result("Split flip copies no more than the budget per blank", ok);
+
+	// Small copies fit in one blank
+	test_Reset(TEST_BEAM, 0);
+	gfx_Dirty(0, 0, GFX_COLS - 1, 9);
+	gfx_Flip();
+	test_Result("Split flip of a small copy waits for one blank", (test_blanks == 1) && (host_movedata_calls == 1));
+}
+
+static int test_TimedOut(unsigned long inports){
+	// Did a wait give up after GFX_VSYNC_TIMEOUT polls; each of the two 
+	// loops of the wait reads the status once more as it stops
+
+	if ((inports < GFX_VSYNC_TIMEOUT) || (inports > (GFX_VSYNC_TIMEOUT + 2))){
+		printf("      %lu status reads\n", inports);
+		return 0;
+	}
+	return 1;
+}
+
+static void test_Timeout(){
+	// A GDC which never changes its status turns vsync off, and the flip still copies
+
+	unsigned long inports;
+	int ok;
+
+	gfx_SetVsync(GFX_VSYNC_WAIT);
+	test_Reset(TEST_STUCK_OFF, 0);
+	gfx_Dirty(0, 0, GFX_COLS - 1, 9);
+	gfx_Flip();
+	inports = host_inports;
+	ok = test_TimedOut(inports) && (host_movedata_bytes == (10 * GFX_COLS));
+	gfx_Dirty(0, 0, GFX_COLS - 1, 9);
+	gfx_Flip();
+	ok = ok && (host_inports == inports);
+	test_Result("No blank reported; flip times out and vsync is turned off", ok);
+
+	gfx_SetVsync(GFX_VSYNC_SPLIT);
+	test_Reset(TEST_STUCK_ON, 0);
+	gfx_Dirty(0, 0, GFX_COLS - 1, GFX_ROWS - 1);
+	gfx_Flip();
+	inports = host_inports;
+	ok = test_TimedOut(inports) && (host_movedata_bytes == (GFX_COLS * GFX_ROWS));
+	gfx_Dirty(0, 0, GFX_COLS - 1, 9);
+	gfx_Flip();
+	ok = ok && (host_inports == inports);
+	test_Result("Blank never ending; split flip times out, copies it all and turns vsync off", ok);
+
+	// Off means no polling at all
+	gfx_SetVsync(GFX_VSYNC_OFF);
+	test_Reset(TEST_BEAM, 0);
+	gfx_Dirty(0, 0, GFX_COLS - 1, 9);
+	pal_Set(7, 70, 80, 90);
+	gfx_Flip();
+	test_Result("Flip with vsync off reads no status", (host_inports == 0) && (test_pal_writes == 4));
+}
+
+int main(int argc, char **argv){
+
+	host_inport = test_Inport;
+	host_outport = test_Outport;
+	pal_ResetAll();
+	pal_Commit();
+
+	test_Wait();
+	test_Split();
+	test_Timeout();
+
+	if (test_failures){
+		printf("%d test(s) failed\n", test_failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
@@ -0,0 +1,30 @@
+/* djgpp.h, Host stand-ins for what DJGPP adds to the standard headers.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Included ahead of every source file (gcc -include) by the host tests,
+// for what the launcher takes from DJGPP's own <time.h>
+
+#ifndef __HOST_DJGPP_H
+#define __HOST_DJGPP_H
+
+typedef long long	uclock_t;
+
+#define UCLOCKS_PER_SEC	1193180
+
+uclock_t	uclock(void);
+
+#endif
@@ -0,0 +1,36 @@
+/* dpmi.h, Host stand-in for the DJGPP header of the same name.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Only declared here; each host test defines any of these it links against
+
+#ifndef __HOST_DPMI_H
+#define __HOST_DPMI_H
+
+typedef struct {
+	unsigned long	handle;
+	unsigned long	size;
+	unsigned long	address;
+} __dpmi_meminfo;
+
+int		__dpmi_physical_address_mapping(__dpmi_meminfo *info);
+int		__dpmi_free_physical_address_mapping(__dpmi_meminfo *info);
+int		__dpmi_allocate_ldt_descriptors(int count);
+int		__dpmi_set_segment_base_address(int selector, unsigned long address);
+int		__dpmi_set_segment_limit(int selector, unsigned long limit);
+int		__djgpp_nearptr_enable(void);
+
+#endif
@@ -0,0 +1,29 @@
+/* go32.h, Host stand-in for the DJGPP header of the same name.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Only declared here; each host test defines any of these it links against
+
+#ifndef __HOST_GO32_H
+#define __HOST_GO32_H
+
+extern int	_dos_ds;
+
+int		_my_ds(void);
+void	_farpokeb(unsigned short selector, unsigned long offset, unsigned char value);
+void	movedata(unsigned source_selector, unsigned source_offset, unsigned dest_selector, unsigned dest_offset, unsigned length);
+
+#endif
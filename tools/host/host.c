@@ -0,0 +1,110 @@
+/* host.c, Host stand-ins for the DJGPP library calls of the launcher.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Enough of DJGPP for gfx.c to link and run on the host; nothing reaches
+// any hardware. movedata() only counts, as the launcher's offsets are
+// 32bit DOS addresses and selectors rather than host pointers.
+
+#include <time.h>
+
+#include "pc.h"
+#include "dos.h"
+#include "go32.h"
+#include "dpmi.h"
+#include "host.h"
+
+unsigned char	(*host_inport)(unsigned short port);
+void			(*host_outport)(unsigned short port, unsigned char value);
+unsigned long	host_inports;
+unsigned long	host_movedata_calls;
+unsigned long	host_movedata_bytes;
+
+int				_dos_ds;
+
+unsigned char inportb(unsigned short port){
+
+	host_inports++;
+	if (host_inport != NULL){
+		return host_inport(port);
+	}
+	return 0;
+}
+
+void outportb(unsigned short port, unsigned char value){
+
+	if (host_outport != NULL){
+		host_outport(port, value);
+	}
+}
+
+void outportw(unsigned short port, unsigned short value){
+
+	outportb(port, value & 0xFF);
+	outportb(port + 1, value >> 8);
+}
+
+void delay(unsigned int msec){
+}
+
+int _my_ds(void){
+
+	return 0;
+}
+
+void _farpokeb(unsigned short selector, unsigned long offset, unsigned char value){
+}
+
+void movedata(unsigned source_selector, unsigned source_offset, unsigned dest_selector, unsigned dest_offset, unsigned length){
+
+	host_movedata_calls++;
+	host_movedata_bytes += length;
+}
+
+int __dpmi_physical_address_mapping(__dpmi_meminfo *info){
+
+	return 0;
+}
+
+int __dpmi_free_physical_address_mapping(__dpmi_meminfo *info){
+
+	return 0;
+}
+
+int __dpmi_allocate_ldt_descriptors(int count){
+
+	return 1;
+}
+
+int __dpmi_set_segment_base_address(int selector, unsigned long address){
+
+	return 0;
+}
+
+int __dpmi_set_segment_limit(int selector, unsigned long limit){
+
+	return 0;
+}
+
+int __djgpp_nearptr_enable(void){
+
+	return 1;
+}
+
+uclock_t uclock(void){
+
+	return ((uclock_t) clock() * UCLOCKS_PER_SEC) / CLOCKS_PER_SEC;
+}
@@ -0,0 +1,29 @@
+/* host.h, Hooks into the host stand-ins of the DJGPP library.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// The stand-ins of host.c do nothing but count, unless a test hooks them
+
+#ifndef __HOST_HOST_H
+#define __HOST_HOST_H
+
+extern unsigned char	(*host_inport)(unsigned short port);	// Answers inportb(); reads as 0 if not set
+extern void			(*host_outport)(unsigned short port, unsigned char value);	// Sees every outportb()
+extern unsigned long	host_inports;			// inportb() calls
+extern unsigned long	host_movedata_calls;	// movedata() calls, and the bytes they would have copied
+extern unsigned long	host_movedata_bytes;
+
+#endif
@@ -0,0 +1,27 @@
+/* pc.h, Host stand-in for the DJGPP header of the same name.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Only declared here; each host test defines these as mocks of the hardware
+
+#ifndef __HOST_PC_H
+#define __HOST_PC_H
+
+unsigned char	inportb(unsigned short port);
+void			outportb(unsigned short port, unsigned char value);
+void			outportw(unsigned short port, unsigned short value);
+
+#endif
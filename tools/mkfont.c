@@ -0,0 +1,115 @@
+/* mkfont.c, Converts a bitmap font to the packed font format of the pc98Launcher.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Usage:
+//
+//	mkfont font8x16.bmp font8x16.fnt 8 16 [ascii_start] [unknown_symbol]
+//
+// The bitmap is decoded with the same bmp_ReadFont() used by the
+// launcher, so the packed glyphs are identical to those it would
+// build itself. Plane colours are stored as entries of the colour
+// table, which is written to the file as-is.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../bmp.h"
+
+int main(int argc, char **argv){
+
+	FILE		*in;
+	FILE		*out;
+	bmpdata_t	*bmpdata;
+	fontdata_t	*fontdata;
+	unsigned char	hdr[BMP_FONT_HEADER_SIZE];
+	unsigned char	colour[4];
+	int		status;
+	int		i;
+
+	if (argc < 5){
+		printf("Usage: %s input.bmp output.fnt width height [ascii_start] [unknown_symbol]\n", argv[0]);
+		return 1;
+	}
+
+	in = fopen(argv[1], "rb");
+	if (in == NULL){
+		printf("Error, unable to open %s\n", argv[1]);
+		return 1;
+	}
+
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	fontdata = (fontdata_t *) calloc(1, sizeof(fontdata_t));
+	status = bmp_ReadFont(in, bmpdata, fontdata, 1, 1, 1, atoi(argv[3]), atoi(argv[4]));
+	fclose(in);
+	if (status != BMP_OK){
+		printf("Error, unable to decode %s as a font (error %d)\n", argv[1], status);
+		return 1;
+	}
+
+	fontdata->ascii_start = 32;
+	fontdata->unknown_symbol = '?' - 32;
+	if (argc > 5){
+		fontdata->ascii_start = atoi(argv[5]);
+	}
+	if (argc > 6){
+		fontdata->unknown_symbol = atoi(argv[6]);
+	}
+
+	// Header, laid out as described in bmp.h
+	memset(hdr, 0, sizeof(hdr));
+	hdr[0] = 'P';
+	hdr[1] = 'F';
+	hdr[2] = 'N';
+	hdr[3] = 'T';
+	hdr[4] = BMP_FONT_VERSION;
+	hdr[5] = fontdata->width;
+	hdr[6] = fontdata->height;
+	hdr[7] = fontdata->ascii_start;
+	hdr[8] = fontdata->n_symbols;
+	hdr[9] = fontdata->unknown_symbol;
+	hdr[10] = fontdata->n_planes;
+	hdr[11] = fontdata->bg_colour;
+	hdr[12] = fontdata->bytes_per_row;
+	hdr[14] = bmpdata->colours & 0xFF;
+	hdr[15] = (bmpdata->colours >> 8) & 0xFF;
+	for (i = 0; i < fontdata->n_planes; i++){
+		hdr[16 + i] = fontdata->plane_colour[i];
+	}
+
+	out = fopen(argv[2], "wb");
+	if (out == NULL){
+		printf("Error, unable to create %s\n", argv[2]);
+		return 1;
+	}
+	fwrite(hdr, 1, BMP_FONT_HEADER_SIZE, out);
+	for (i = 0; i < bmpdata->colours; i++){
+		colour[0] = bmpdata->palette[i].b;
+		colour[1] = bmpdata->palette[i].g;
+		colour[2] = bmpdata->palette[i].r;
+		colour[3] = 0;
+		fwrite(colour, 1, 4, out);
+	}
+	fwrite(fontdata->glyphs, 1, fontdata->n_symbols * fontdata->glyph_size, out);
+	fclose(out);
+
+	printf("%s: %dx%d, %d symbols, %d colour planes, %d bytes of glyphs\n", argv[2], fontdata->width, fontdata->height, fontdata->n_symbols, fontdata->n_planes, fontdata->n_symbols * fontdata->glyph_size);
+
+	bmp_DestroyFont(fontdata);
+	bmp_Destroy(bmpdata);
+	return 0;
+}
@@ -0,0 +1,211 @@
+/* mkthm.c, Packs the bitmaps of a UI theme into a theme archive for the pc98Launcher.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Usage:
+//
+//	mkthm light.thm light/light.bmp light/select.bmp ...
+//
+// Each bitmap is decoded with the same bmp_ReadImage() used by the
+// launcher, and stored under its file name, without the path or
+// extension. The colours that are actually used by the pixels of all
+// of the bitmaps are merged into one colour table, and the pixels are
+// stored as entries of it. See bmp.h for the layout of the file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../bmp.h"
+
+#define MKTHM_RESERVED	32	// Palette entries the launcher has for all of the UI bitmaps
+
+static unsigned char	colours[256][3];
+static int			n_colours;
+
+static void put16(unsigned char *p, unsigned int v){
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+}
+
+static void put32(unsigned char *p, unsigned long v){
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF;
+	p[3] = (v >> 24) & 0xFF;
+}
+
+static int add_colour(pal_entry_t *c){
+	// Entry of the shared colour table with this colour, adding it if it is new
+
+	int i;
+
+	for (i = 0; i < n_colours; i++){
+		if ((colours[i][0] == c->r) && (colours[i][1] == c->g) && (colours[i][2] == c->b)){
+			return i;
+		}
+	}
+	if (n_colours == 256){
+		return -1;
+	}
+	colours[n_colours][0] = c->r;
+	colours[n_colours][1] = c->g;
+	colours[n_colours][2] = c->b;
+	return n_colours++;
+}
+
+static void image_name(char *path, char *name){
+	// File name of path, without any directory or extension
+
+	char *p;
+	char *start;
+	int i;
+
+	start = path;
+	for (p = path; *p != '\0'; p++){
+		if ((*p == '/') || (*p == '\\') || (*p == ':')){
+			start = p + 1;
+		}
+	}
+	memset(name, 0, BMP_THEME_NAME_SIZE);
+	for (i = 0; (i < (BMP_THEME_NAME_SIZE - 1)) && (start[i] != '\0') && (start[i] != '.'); i++){
+		name[i] = start[i];
+	}
+}
+
+int main(int argc, char **argv){
+
+	FILE		*in;
+	FILE		*out;
+	bmpdata_t	*bmpdata[BMP_THEME_MAX_IMAGES];
+	char		name[BMP_THEME_NAME_SIZE];
+	unsigned char	hdr[BMP_THEME_HEADER_SIZE];
+	unsigned char	entry[BMP_THEME_ENTRY_SIZE];
+	unsigned char	colour[4];
+	unsigned char	used[256];
+	unsigned long	offset;
+	unsigned long	total;
+	int		n_images;
+	int		status;
+	int		i, j;
+
+	if (argc < 3){
+		printf("Usage: %s output.thm input.bmp [input.bmp ...]\n", argv[0]);
+		return 1;
+	}
+	n_images = argc - 2;
+	if (n_images > BMP_THEME_MAX_IMAGES){
+		printf("Error, at most %d images can be packed\n", BMP_THEME_MAX_IMAGES);
+		return 1;
+	}
+
+	// Decode all of the bitmaps, and point the colours their pixels use at the shared colour table
+	n_colours = 0;
+	for (i = 0; i < n_images; i++){
+		in = fopen(argv[i + 2], "rb");
+		if (in == NULL){
+			printf("Error, unable to open %s\n", argv[i + 2]);
+			return 1;
+		}
+		bmpdata[i] = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+		status = bmp_ReadImage(in, bmpdata[i], 1, 1, 1);
+		fclose(in);
+		if ((status != BMP_OK) || (bmpdata[i]->bpp > BMP_8BPP)){
+			printf("Error, unable to decode %s as an indexed bitmap (error %d)\n", argv[i + 2], status);
+			return 1;
+		}
+
+		memset(used, 0, sizeof(used));
+		for (j = 0; j < bmpdata[i]->size; j++){
+			used[bmpdata[i]->pixels[j]] = 1;
+		}
+		for (j = 0; j < 256; j++){
+			if (used[j]){
+				status = add_colour(&bmpdata[i]->palette[j]);
+				if (status < 0){
+					printf("Error, the images use more than 256 colours between them\n");
+					return 1;
+				}
+				bmpdata[i]->palette[j].new_palette_entry = status;
+			}
+		}
+		for (j = 0; j < bmpdata[i]->size; j++){
+			bmpdata[i]->pixels[j] = bmpdata[i]->palette[bmpdata[i]->pixels[j]].new_palette_entry;
+		}
+	}
+	if (n_colours > MKTHM_RESERVED){
+		printf("Warning, %d colours; the launcher only has %d palette entries for the UI, and will approximate the rest\n", n_colours, MKTHM_RESERVED);
+	}
+
+	out = fopen(argv[1], "wb");
+	if (out == NULL){
+		printf("Error, unable to create %s\n", argv[1]);
+		return 1;
+	}
+
+	// Header and shared colour table
+	memset(hdr, 0, sizeof(hdr));
+	hdr[0] = 'P';
+	hdr[1] = 'T';
+	hdr[2] = 'H';
+	hdr[3] = 'M';
+	hdr[4] = BMP_THEME_VERSION;
+	put16(hdr + 6, n_images);
+	put16(hdr + 8, n_colours);
+	put16(hdr + 10, BMP_THEME_ALIGN);
+	fwrite(hdr, 1, BMP_THEME_HEADER_SIZE, out);
+	for (i = 0; i < n_colours; i++){
+		colour[0] = colours[i][2];
+		colour[1] = colours[i][1];
+		colour[2] = colours[i][0];
+		colour[3] = 0;
+		fwrite(colour, 1, 4, out);
+	}
+
+	// Directory, with the pixels of each image starting on the next aligned offset
+	offset = BMP_THEME_HEADER_SIZE + (n_colours * 4) + (n_images * BMP_THEME_ENTRY_SIZE);
+	for (i = 0; i < n_images; i++){
+		offset = (offset + BMP_THEME_ALIGN - 1) & ~((unsigned long) BMP_THEME_ALIGN - 1);
+		image_name(argv[i + 2], name);
+		memset(entry, 0, sizeof(entry));
+		memcpy(entry, name, BMP_THEME_NAME_SIZE);
+		put16(entry + 12, bmpdata[i]->width);
+		put16(entry + 14, bmpdata[i]->height);
+		put32(entry + 16, offset);
+		fwrite(entry, 1, BMP_THEME_ENTRY_SIZE, out);
+		offset += bmpdata[i]->size;
+	}
+
+	// Pixels
+	total = 0;
+	for (i = 0; i < n_images; i++){
+		offset = ftell(out);
+		while (offset % BMP_THEME_ALIGN){
+			fputc(0, out);
+			offset++;
+		}
+		fwrite(bmpdata[i]->pixels, 1, bmpdata[i]->size, out);
+		total += bmpdata[i]->size;
+		image_name(argv[i + 2], name);
+		printf("%s: %s, %dx%d at %ld\n", argv[1], name, bmpdata[i]->width, bmpdata[i]->height, offset);
+		bmp_Destroy(bmpdata[i]);
+	}
+	offset = ftell(out);
+	fclose(out);
+
+	printf("%s: %d images, %d colours, %ld bytes of pixels, %ld bytes in all\n", argv[1], n_images, n_colours, total, offset);
+	return 0;
+}
@@ -0,0 +1,286 @@
+/* paltest.c, Checks the shadow palette of the pc98Launcher on the host.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Usage:
+//
+//	paltest
+//
+// palette.c is built against the stand-in DJGPP headers in host/, with
+// outportb() logging every write to the palette registers instead. Each
+// test changes the palette through the same calls as the launcher, and
+// checks which entries pal_Commit() writes to the registers.
+// Prints one line per test and exits with 1 if any of them failed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../palette.h"
+#include "../pegc.h"
+
+#define TEST_MAX_WRITES	4096
+
+typedef struct portwrite {
+	unsigned short	port;
+	unsigned char	value;
+} portwrite_t;
+
+static portwrite_t	test_writes[TEST_MAX_WRITES];	// Every port write since the last test_Clear()
+static int			test_n_writes;
+static int			test_failures;
+
+void outportb(unsigned short port, unsigned char value){
+	// The palette registers
+
+	if (test_n_writes < TEST_MAX_WRITES){
+		test_writes[test_n_writes].port = port;
+		test_writes[test_n_writes].value = value;
+	}
+	test_n_writes++;
+}
+
+static void test_Result(char *name, int ok){
+	// Record and print the result of one test
+
+	if (ok){
+		printf("ok    %s\n", name);
+	} else {
+		printf("FAIL  %s\n", name);
+		test_failures++;
+	}
+}
+
+static void test_Clear(){
+	// Forget the port writes made so far
+
+	test_n_writes = 0;
+}
+
+static int test_Written(int n, unsigned char *entries){
+	// Were exactly n entries written, in this order, each as a select then
+	// red, green and blue write of the colour the shadow palette holds
+
+	unsigned char	r, g, b;
+	portwrite_t		*w;
+	int				i;
+
+	if (test_n_writes != (n * 4)){
+		printf("      %d port writes, expected %d\n", test_n_writes, n * 4);
+		return 0;
+	}
+	for (i = 0; i < n; i++){
+		w = &test_writes[i * 4];
+		pal_Get(entries[i], &r, &g, &b);
+		if ((w[0].port != PEGC_PALLETE_SEL_ADDR) || (w[0].value != entries[i]) ||
+			(w[1].port != PEGC_RED_ADDR) || (w[1].value != r) ||
+			(w[2].port != PEGC_GREEN_ADDR) || (w[2].value != g) ||
+			(w[3].port != PEGC_BLUE_ADDR) || (w[3].value != b)){
+			printf("      write %d is not entry %d (%d,%d,%d)\n", i, entries[i], r, g, b);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void test_ResetAll(){
+	// After a full reset every entry is uploaded once, whatever its colour
+
+	unsigned char	entries[PALETTES_TOTAL];
+	unsigned long	count;
+	int				i;
+	int				ok;
+
+	for (i = 0; i < PALETTES_TOTAL; i++){
+		entries[i] = i;
+	}
+	count = pal_WriteCount();
+	pal_ResetAll();
+	pal_Set(PALETTE_UI_WHITE, 255, 255, 255);
+	pal_Set(PALETTE_UI_RED, 220, 0, 0);
+	test_Clear();
+	ok = pal_Pending() && (pal_Commit() == PALETTES_TOTAL) && test_Written(PALETTES_TOTAL, entries);
+	ok = ok && ((pal_WriteCount() - count) == (PALETTES_TOTAL * 4)) && !pal_Pending();
+	test_Result("Reset uploads every entry", ok);
+
+	test_Clear();
+	count = pal_WriteCount();
+	ok = (pal_Commit() == 0) && test_Written(0, NULL) && (pal_WriteCount() == count);
+	test_Result("Commit with nothing set writes nothing", ok);
+}
+
+static void test_Changed(){
+	// Only entries whose colour differs from the hardware are written
+
+	static unsigned char entries[] = { 3, 200, 250 };
+	unsigned char	r, g, b;
+	unsigned long	count;
+	int				ok;
+
+	count = pal_WriteCount();
+	pal_Set(3, 10, 20, 30);
+	pal_Set(100, 0, 0, 0);		// The colour it already has
+	pal_Set(200, 1, 2, 3);
+	pal_Get(PALETTE_UI_WHITE, &r, &g, &b);
+	pal_Set(PALETTE_UI_WHITE, r, g, b);
+	pal_Set(250, 40, 50, 60);
+	test_Clear();
+	ok = pal_Pending() && (pal_Commit() == 3) && test_Written(3, entries);
+	ok = ok && ((pal_WriteCount() - count) == (3 * 4));
+	test_Result("Only changed entries are written", ok);
+
+	// Changed, and changed back again, before the commit
+	pal_Set(3, 99, 99, 99);
+	pal_Set(3, 10, 20, 30);
+	test_Clear();
+	count = pal_WriteCount();
+	ok = (pal_Commit() == 0) && test_Written(0, NULL) && (pal_WriteCount() == count);
+	test_Result("Entries set back to their colour are not written", ok);
+}
+
+static void test_Artwork(){
+	// Artwork which shares colours with the last artwork reuses the
+	// entries that still hold them, and only uploads the new colours
+
+	bmpdata_t		*bmpdata;
+	unsigned char	entries[4];
+	int				i;
+	int				ok;
+
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	bmpdata->colours = 4;
+	for (i = 0; i < 4; i++){
+		bmpdata->palette[i].r = 10 * i;
+		bmpdata->palette[i].g = 100;
+		bmpdata->palette[i].b = 200;
+	}
+	pal_ResetFree();
+	ok = (pal_BMP2Palette(bmpdata, 0) == 4);
+	for (i = 0; i < 4; i++){
+		entries[i] = bmpdata->palette[i].new_palette_entry;
+	}
+	test_Clear();
+	ok = ok && (pal_Commit() == 4) && test_Written(4, entries);
+	test_Result("New artwork uploads its colours", ok);
+
+	// The next artwork has one new colour
+	bmpdata->palette[2].g = 111;
+	pal_ResetFree();
+	ok = (pal_BMP2Palette(bmpdata, 0) == 4);
+	for (i = 0; i < 4; i++){
+		ok = ok && ((i == 2) || (bmpdata->palette[i].new_palette_entry == entries[i]));
+	}
+	entries[0] = bmpdata->palette[2].new_palette_entry;
+	test_Clear();
+	ok = ok && (pal_Commit() == 1) && test_Written(1, entries);
+	test_Result("Artwork sharing colours uploads only the new ones", ok);
+	free(bmpdata);
+}
+
+static void test_Used(){
+	// Artwork decoded before its entries are set only gets entries for the
+	// colours its pixels were decoded to; here colours 0 and 1 were reduced 
+	// to the same box, which is used, and colours 2 and 3 are not used
+	
+	static unsigned char decoded[4] = { 1, 1, 0, 2 };
+	bmpdata_t		*bmpdata;
+	unsigned char	used[256];
+	unsigned char	remap[256];
+	unsigned char	r, g, b;
+	int				i;
+	int				ok;
+	
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	bmpdata->colours = 4;
+	for (i = 0; i < 4; i++){
+		bmpdata->palette[i].r = 30 + (50 * decoded[i]);
+		bmpdata->palette[i].g = 40;
+		bmpdata->palette[i].b = 50;
+		bmpdata->palette[i].new_palette_entry = decoded[i];
+	}
+	memset(used, 0, sizeof(used));
+	used[1] = 1;
+	pal_ResetFree();
+	ok = (pal_AllocUsed(bmpdata, 0, PALETTES_FREE, used, remap) == 0) && (free_palettes_used == 1);
+	ok = ok && (bmpdata->palette[0].new_palette_entry == bmpdata->palette[1].new_palette_entry);
+	ok = ok && (bmpdata->palette[2].new_palette_entry == PALETTE_UI_BLACK) && (bmpdata->palette[3].new_palette_entry == PALETTE_UI_BLACK);
+	pal_Get(remap[1], &r, &g, &b);
+	ok = ok && (remap[1] == bmpdata->palette[1].new_palette_entry) && (r == 80) && (g == 40) && (b == 50);
+	for (i = 0; i < 256; i++){
+		ok = ok && ((i == 1) || (remap[i] == i));
+	}
+	test_Clear();
+	ok = ok && (pal_Commit() == 1);
+	test_Result("Artwork gets entries only for the colours its pixels use", ok);
+	
+	pal_Release(bmpdata);
+	test_Result("Releasing it frees just those entries", free_palettes_used == 0);
+	free(bmpdata);
+}
+
+static void test_Reserved(){
+	// The pixels of a UI bitmap are decoded before its entries are set; if
+	// its colour table was reduced, they hold the value of their colour's
+	// box rather than its colour table index, and must still end up on an
+	// entry of their own colour
+	
+	static unsigned char decoded[4] = { 1, 1, 0, 0 };	// Box of each colour
+	bmpdata_t		*bmpdata;
+	unsigned char	pixels[4];
+	unsigned char	r, g, b;
+	int				i;
+	int				ok;
+	
+	bmpdata = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	bmpdata->colours = 4;
+	bmpdata->size = 4;
+	bmpdata->pixels = pixels;
+	for (i = 0; i < 4; i++){
+		// The colours of each box are replaced by their average
+		bmpdata->palette[i].r = 50 + (100 * decoded[i]);
+		bmpdata->palette[i].g = 60;
+		bmpdata->palette[i].b = 70;
+		bmpdata->palette[i].new_palette_entry = decoded[i];
+		pixels[i] = decoded[i];
+	}
+	ok = (pal_BMP2Palette(bmpdata, 1) == 4);
+	for (i = 0; i < 4; i++){
+		pal_Get(pixels[i], &r, &g, &b);
+		if ((pixels[i] < PALETTES_FREE) || (r != bmpdata->palette[i].r) || (g != 60) || (b != 70)){
+			printf("      pixel %d is entry %d (%d,%d,%d)\n", i, pixels[i], r, g, b);
+			ok = 0;
+		}
+	}
+	test_Result("Reduced UI bitmap pixels are remapped to reserved entries of their colour", ok);
+	pal_Release(bmpdata);
+	free(bmpdata);
+}
+
+int main(int argc, char **argv){
+
+	test_ResetAll();
+	test_Changed();
+	test_Artwork();
+	test_Used();
+	test_Reserved();
+
+	if (test_failures){
+		printf("%d test(s) failed\n", test_failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
@@ -0,0 +1,362 @@
+/* txtbench.c, Checks and times the text drawing of the pc98Launcher on the host.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Usage:
+//
+//	txtbench [font.fnt] [repeats]
+//
+// gfx.c is built against the stand-in DJGPP headers in host/, and draws
+// with the launcher's own packed font, ../assets/font8x16.fnt by default.
+//
+// The text is first checked against two references drawing into a screen
+// of their own: the gfx_Puts() the launcher had before the glyph masks,
+// which sets the pixels of each packed colour plane in turn, and a plain
+// loop deciding every pixel on its own from the packed planes, the style
+// and the clip box. Thousands of random strings are drawn with both, in
+// random styles and often partly offscreen, and the screens compared.
+//
+// Then a full browser pane of text is timed with each; the 14 title lines,
+// clipped to the list box as ui_DrawTitle() does, and the footer line.
+// Times are for the host, so they compare the two rather than predict a
+// PC-98.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../gfx.h"
+
+#define BENCH_CHECKS		20000	// Random strings drawn when checking the text
+#define BENCH_PANES			2000	// Browser panes drawn by each timing
+#define BENCH_MAX_LEN		90		// Longest random string, wider than the screen
+#define BENCH_LINES			14		// Title lines of the browser pane, as ui.h
+#define BENCH_TITLE_X		40		// Position of the first title, as ui.h
+#define BENCH_TITLE_Y		16
+#define BENCH_TITLE_X2		286		// Right edge of the titles; list box x + width - margin
+#define BENCH_FOOTER_X		20		// Position of the footer line, as ui.h
+#define BENCH_FOOTER_Y		280
+
+static char *bench_titles[BENCH_LINES] = {
+	"Rusty",
+	"Policenauts",
+	"Snatcher",
+	"Princess Maker 2",
+	"Touhou Reiiden - Highly Responsive to Prayers",
+	"Brandish",
+	"Dragon Knight III",
+	"Sorcerian",
+	"Ys II - Ancient Ys Vanished: The Final Chapter",
+	"Lemmings",
+	"Silpheed",
+	"Star Cruiser 2",
+	"Farland Story",
+	"Rance IV - Kyoudan no Isan"
+};
+
+static unsigned char	bench_screen[GFX_ROWS * GFX_COLS];	// Drawn by the references
+
+static int bench_Pixel(fontdata_t *fontdata, unsigned char font_symbol, int col, int row){
+	// Mask value of one pixel of a glyph, from its packed planes; 0 for
+	// the background, else 1 + the last plane the pixel is set in
+
+	unsigned char	*src;
+	int				plane;
+	int				value;
+
+	value = 0;
+	src = fontdata->glyphs + (font_symbol * fontdata->glyph_size) + (row * fontdata->n_planes * fontdata->bytes_per_row);
+	for (plane = 0; plane < fontdata->n_planes; plane++){
+		if (src[col >> 3] & (0x80 >> (col & 0x07))){
+			value = plane + 1;
+		}
+		src += fontdata->bytes_per_row;
+	}
+	return value;
+}
+
+static unsigned char bench_Symbol(fontdata_t *fontdata, char c){
+	// Symbol of the font for a character
+
+	unsigned char i;
+
+	i = (unsigned char) c;
+	if ((i >= fontdata->ascii_start) && (i < (fontdata->ascii_start + fontdata->n_symbols))){
+		return i - fontdata->ascii_start;
+	}
+	return fontdata->unknown_symbol;
+}
+
+static void bench_PutsPlanes(int x, int y, fontdata_t *fontdata, char *c){
+	// gfx_Puts() as it was before the glyph masks; the background of each
+	// row is filled, then the pixels of each colour plane set in turn.
+	// It did not clip, so only strings inside the screen are drawn with it.
+
+	unsigned char	font_symbol;
+	unsigned char	font_row;
+	unsigned char	w;
+	unsigned char	pos;
+	unsigned char	plane;
+	unsigned char	bits;
+	unsigned char	*src, *dst, *px, *start;
+
+	if (strlen(c) < 1){
+		return;
+	}
+	start = bench_screen + (y * GFX_COLS) + x;
+	for (pos = 0; pos < strlen(c); pos += 1){
+		font_symbol = bench_Symbol(fontdata, c[pos]);
+		src = fontdata->glyphs + (font_symbol * fontdata->glyph_size);
+		for (font_row = 0; font_row < fontdata->height; font_row++){
+			dst = start + (font_row * GFX_COLS);
+			memset(dst, fontdata->bg_colour, fontdata->width);
+			for (plane = 0; plane < fontdata->n_planes; plane++){
+				for (w = 0; w < fontdata->bytes_per_row; w++){
+					bits = *src++;
+					px = dst + (w << 3);
+					while (bits){
+						if (bits & 0x80){
+							*px = fontdata->plane_colour[plane];
+						}
+						bits <<= 1;
+						px++;
+					}
+				}
+			}
+		}
+		start += fontdata->width;
+	}
+}
+
+static void bench_PutsPixels(int x, int y, fontdata_t *fontdata, textstyle_t *style, char *c){
+	// Every pixel of the string decided on its own, from the packed planes
+
+	unsigned char	colour;
+	int				len;
+	int				pos;
+	int				col, row;
+	int				sx, sy;
+	int				value;
+
+	len = strlen(c);
+	for (pos = 0; pos < len; pos++){
+		for (row = 0; row < fontdata->height; row++){
+			for (col = 0; col < fontdata->width; col++){
+				sx = x + (pos * fontdata->width) + col;
+				sy = y + row;
+				if ((sx < 0) || (sy < 0) || (sx >= GFX_COLS) || (sy >= GFX_ROWS)){
+					continue;
+				}
+				if ((sx < style->clip_x1) || (sy < style->clip_y1) || (sx > style->clip_x2) || (sy > style->clip_y2)){
+					continue;
+				}
+				value = bench_Pixel(fontdata, bench_Symbol(fontdata, c[pos]), col, row);
+				if (value == 0){
+					if (style->mode == GFX_TEXT_TRANSPARENT){
+						continue;
+					}
+					colour = fontdata->bg_colour;
+				} else if ((value == fontdata->n_planes) && (style->fg_colour != GFX_TEXT_FONT_COLOUR)){
+					colour = style->fg_colour;
+				} else {
+					colour = fontdata->plane_colour[value - 1];
+				}
+				bench_screen[(sy * GFX_COLS) + sx] = colour;
+			}
+		}
+	}
+}
+
+static void bench_RandomString(char *c){
+	// Printable characters, and now and then one the font does not have
+
+	int len;
+	int i;
+
+	len = rand() % (BENCH_MAX_LEN + 1);
+	for (i = 0; i < len; i++){
+		if ((rand() % 20) == 0){
+			c[i] = 1 + (rand() % 31);
+		} else {
+			c[i] = 32 + (rand() % 95);
+		}
+	}
+	c[len] = '\0';
+}
+
+static int bench_Check(fontdata_t *fontdata){
+	// Draw random strings with gfx.c and the references, and compare the screens
+
+	textstyle_t	style;
+	char		c[BENCH_MAX_LEN + 1];
+	int			x, y;
+	int			i;
+
+	memset(vram_buffer, 0, sizeof(bench_screen));
+	memset(bench_screen, 0, sizeof(bench_screen));
+	srand(1);
+	for (i = 0; i < BENCH_CHECKS; i++){
+		bench_RandomString(c);
+		x = (rand() % (GFX_COLS + 200)) - 100 - (fontdata->width * strlen(c) / 2);
+		y = (rand() % (GFX_ROWS + 40)) - 20;
+		gfx_TextStyleInit(&style);
+		if (rand() & 1){
+			style.mode = GFX_TEXT_TRANSPARENT;
+		}
+		if (rand() & 1){
+			style.fg_colour = rand() & 0xFF;
+		}
+		if (rand() & 1){
+			style.clip_x1 = (rand() % (GFX_COLS + 40)) - 20;
+			style.clip_y1 = (rand() % (GFX_ROWS + 40)) - 20;
+			style.clip_x2 = style.clip_x1 + (rand() % 400) - 20;
+			style.clip_y2 = style.clip_y1 + (rand() % 60) - 20;
+		}
+		gfx_PutsStyle(x, y, fontdata, &style, c);
+		bench_PutsPixels(x, y, fontdata, &style, c);
+		if (memcmp(vram_buffer, bench_screen, sizeof(bench_screen)) != 0){
+			printf("Error, gfx_PutsStyle(%d, %d, [%s]) differs from the pixel loop\n", x, y, c);
+			return -1;
+		}
+	}
+
+	// gfx_Puts() draws just as it did, wherever the string fits on the screen
+	for (i = 0; i < BENCH_CHECKS; i++){
+		bench_RandomString(c);
+		if ((fontdata->width * strlen(c)) > GFX_COLS){
+			c[GFX_COLS / fontdata->width] = '\0';
+		}
+		x = rand() % (GFX_COLS - (fontdata->width * strlen(c)) + 1);
+		y = rand() % (GFX_ROWS - fontdata->height + 1);
+		gfx_Puts(x, y, fontdata, c);
+		bench_PutsPlanes(x, y, fontdata, c);
+		if (memcmp(vram_buffer, bench_screen, sizeof(bench_screen)) != 0){
+			printf("Error, gfx_Puts(%d, %d, [%s]) differs from the plane loop\n", x, y, c);
+			return -1;
+		}
+	}
+	printf("%d random strings drawn the same by gfx.c and the references\n\n", BENCH_CHECKS * 2);
+	return 0;
+}
+
+static void bench_Pane(fontdata_t *fontdata, int planes){
+	// The text of one browser pane, with either the old gfx_Puts() or gfx.c
+
+	textstyle_t	style;
+	char		footer[64];
+	int			y;
+	int			i;
+
+	gfx_TextStyleInit(&style);
+	style.clip_x2 = BENCH_TITLE_X2;
+	y = BENCH_TITLE_Y;
+	for (i = 0; i < BENCH_LINES; i++){
+		if (planes){
+			// Nothing was clipped; titles ran on over the edge of the list box
+			bench_PutsPlanes(BENCH_TITLE_X, y, fontdata, bench_titles[i]);
+		} else {
+			gfx_PutsStyle(BENCH_TITLE_X, y, fontdata, &style, bench_titles[i]);
+		}
+		y += fontdata->height + 2;
+	}
+	sprintf(footer, "Line %02d/%02d             Page %02d/%02d", 3, BENCH_LINES, 1, 20);
+	if (planes){
+		bench_PutsPlanes(BENCH_FOOTER_X, BENCH_FOOTER_Y, fontdata, footer);
+	} else {
+		gfx_Puts(BENCH_FOOTER_X, BENCH_FOOTER_Y, fontdata, footer);
+	}
+}
+
+static double bench_Time(fontdata_t *fontdata, int planes, int repeats){
+	// Milliseconds to draw the text of one browser pane
+
+	clock_t		start;
+	clock_t		elapsed;
+	int			i, r;
+
+	elapsed = 0;
+	for (r = 0; r < repeats; r++){
+		start = clock();
+		for (i = 0; i < BENCH_PANES; i++){
+			bench_Pane(fontdata, planes);
+		}
+		elapsed += clock() - start;
+	}
+	return ((double) elapsed * 1000.0) / CLOCKS_PER_SEC / ((double) BENCH_PANES * repeats);
+}
+
+int main(int argc, char **argv){
+
+	FILE		*font_file;
+	fontdata_t	*fontdata;
+	bmpdata_t	bmpdata;
+	char		*font_name;
+	int			repeats;
+	int			status;
+	int			chars;
+	int			i;
+
+	font_name = "../assets/font8x16.fnt";
+	repeats = 3;
+	if (argc > 1){
+		font_name = argv[1];
+	}
+	if (argc > 2){
+		repeats = atoi(argv[2]);
+	}
+	if ((argc > 3) || (repeats < 1)){
+		printf("Usage: %s [font.fnt] [repeats]\n", argv[0]);
+		return 1;
+	}
+
+	font_file = fopen(font_name, "rb");
+	if (font_file == NULL){
+		printf("Error, unable to open %s\n", font_name);
+		return 1;
+	}
+	fontdata = (fontdata_t *) calloc(1, sizeof(fontdata_t));
+	memset(&bmpdata, 0, sizeof(bmpdata_t));
+	status = bmp_ReadPackedFont(font_file, &bmpdata, fontdata, 1, 0, 0);
+	if (status == 0){
+		status = bmp_ReadPackedFont(font_file, &bmpdata, fontdata, 0, 1, 0);
+	}
+	if (status == 0){
+		status = bmp_ReadPackedFont(font_file, &bmpdata, fontdata, 0, 0, 1);
+	}
+	fclose(font_file);
+	if (status != 0){
+		printf("Error, unable to read %s (%d)\n", font_name, status);
+		bmp_DestroyFont(fontdata);
+		return 1;
+	}
+	printf("%s: %dx%d, %d symbols, %d planes\n", font_name, fontdata->width, fontdata->height, fontdata->n_symbols, fontdata->n_planes);
+
+	if (bench_Check(fontdata) != 0){
+		bmp_DestroyFont(fontdata);
+		return 1;
+	}
+
+	chars = 0;
+	for (i = 0; i < BENCH_LINES; i++){
+		chars += strlen(bench_titles[i]);
+	}
+	printf("Milliseconds per browser pane; %d titles of %d characters in all, and the footer\n\n", BENCH_LINES, chars);
+	printf("Packed planes (old gfx_Puts) %8.3f\n", bench_Time(fontdata, 1, repeats));
+	printf("Glyph masks (gfx_PutsStyle)  %8.3f\n", bench_Time(fontdata, 0, repeats));
+	bmp_DestroyFont(fontdata);
+	return 0;
+}
@@ -0,0 +1,443 @@
+/* uitest.c, Checks the browser pane of the pc98Launcher on the host.
+ Copyright (C) 2020  John Snowdon
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Usage:
+//
+//	uitest [font.fnt]
+//
+// ui.c and gfx.c are built against the stand-in DJGPP headers in host/,
+// with the launcher's own packed font, ../assets/font8x16.fnt by default,
+// and a plain list box. The browser pane is driven through a list of games
+// as the main loop does for each keypress, and each test checks how many
+// titles were drawn from the title cache and how many rendered, that
+// a page drawn from the cache is the same as when it was rendered, and 
+// that nothing drawn for a keypress is presented before the main loop's
+// one flip for it.
+// Prints one line per test and exits with 1 if any of them failed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../data.h"
+#include "../gfx.h"
+#include "../palette.h"
+#include "../ui.h"
+
+// Set up by ui_LoadFonts() and ui_LoadAssets() in the launcher
+extern fontdata_t	*ui_font;
+extern bmpdata_t	*ui_list_bmp;
+
+#define TEST_GAMES		200
+#define TEST_STALE		0x55	// Fills the screen before drawing; none should be left where it is drawn over
+
+// Directory names, so no longer than MAX_STRING_SIZE with the number added;
+// the longest are wider than the list box, and clipped
+static char *test_names[] = {
+	"Rusty",
+	"Policenauts",
+	"Snatcher",
+	"Princess Maker 2",
+	"Touhou Reiiden",
+	"Brandish",
+	"Dragon Knight III",
+	"Sorcerian",
+	"Ys II - Ancient Ys Vanished",
+	"Lemmings",
+	"Silpheed",
+	"Star Cruiser 2",
+	"Farland Story",
+	"Rance IV - Kyoudan no Isan"
+};
+#define test_names_total	(sizeof(test_names) / sizeof(char *))
+
+static gamedata_t		*test_games;
+static state_t			*test_state;
+static unsigned char	test_screen[GFX_ROWS * GFX_COLS];	// A copy of vram_buffer
+static int				test_failures;
+
+gamedata_t * getGameid(int gameid, gamedata_t *gamedata){
+	// As data.c; the list is walked until the game is found
+
+	while (gamedata != NULL){
+		if (gamedata->gameid == gameid){
+			return gamedata;
+		}
+		gamedata = gamedata->next;
+	}
+	return NULL;
+}
+
+static void test_Result(char *name, int ok){
+	// Record and print the result of one test
+
+	if (ok){
+		printf("ok    %s\n", name);
+	} else {
+		printf("FAIL  %s\n", name);
+		test_failures++;
+	}
+}
+
+static void test_Stats(unsigned int *hits, unsigned int *misses){
+	// Titles drawn from the cache, and rendered, since the last call
+
+	static unsigned int last_hits;
+	static unsigned int last_misses;
+	unsigned int		total_hits;
+	unsigned int		total_misses;
+
+	ui_TitleCacheStats(&total_hits, &total_misses);
+	*hits = total_hits - last_hits;
+	*misses = total_misses - last_misses;
+	last_hits = total_hits;
+	last_misses = total_misses;
+}
+
+static int test_Expect(unsigned int hits, unsigned int misses){
+	// Were exactly this many titles drawn from the cache, and rendered
+
+	unsigned int got_hits;
+	unsigned int got_misses;
+
+	test_Stats(&got_hits, &got_misses);
+	if ((got_hits != hits) || (got_misses != misses)){
+		printf("      %u titles from the cache and %u rendered, expected %u and %u\n", got_hits, got_misses, hits, misses);
+		return 0;
+	}
+	return 1;
+}
+
+static void test_Page(int page){
+	// Page up or down to a page, as the main loop does in page mode
+
+	test_state->selected_page = page;
+	test_state->selected_line = 0;
+	ui_UpdateBrowserPane(test_state, test_games);
+	ui_UpdateBrowserPaneStatus(test_state);
+}
+
+static void test_Scroll(int lines){
+	// Move the selection up or down, as the main loop does in line scrolling mode
+
+	ui_BrowserScroll(test_state, lines);
+	ui_UpdateBrowserPane(test_state, test_games);
+	ui_UpdateBrowserPaneStatus(test_state);
+}
+
+static int test_PaneUnchanged(){
+	// Are the titles of the browser pane as they were when test_screen was copied
+
+	int y;
+	int start;
+
+	for (y = ui_browser_font_y_pos; y < (ui_browser_font_y_pos + (ui_browser_max_lines * (ui_font->height + 2))); y++){
+		start = (y * GFX_COLS) + ui_browser_font_x_pos;
+		if (memcmp(vram_buffer + start, test_screen + start, ui_list_bmp->width - ui_browser_font_x_pos) != 0){
+			printf("      row %d of the browser pane differs\n", y);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void test_PageMode(){
+	// Each page is rendered the first time it is shown, and copied from the cache after that
+
+	int line;
+	int ok;
+
+	test_Page(1);
+	test_Result("First page renders every title", test_Expect(0, ui_browser_max_lines));
+	memcpy(test_screen, vram_buffer, sizeof(test_screen));
+
+	for (line = 1; line < ui_browser_max_lines; line++){
+		test_state->selected_line = line;
+		ui_UpdateBrowserPane(test_state, test_games);
+		ui_UpdateBrowserPaneStatus(test_state);
+	}
+	test_Result("Moving within a page draws no titles", test_Expect(0, 0));
+
+	test_Page(2);
+	ok = test_Expect(0, ui_browser_max_lines);
+	test_Page(1);
+	ok = ok && test_Expect(ui_browser_max_lines, 0) && test_PaneUnchanged();
+	test_Result("Going back a page copies every title from the cache", ok);
+}
+
+static void test_ScrollMode(){
+	// Scrolling by a line draws the one title that comes into view
+
+	int line;
+	int ok;
+
+	test_state->browser_scroll = 1;
+	test_state->selected_top = 0;
+	test_state->selected_line = 0;
+	for (line = 1; line < ui_browser_max_lines; line++){
+		test_Scroll(1);
+	}
+	ok = test_Expect(0, 0);
+	test_Scroll(1);
+	ok = ok && test_Expect(1, 0);		// Rendered for page 2 already
+	test_Result("Scrolling down a line draws only the new title", ok);
+
+	for (line = 1; line < ui_browser_max_lines; line++){
+		test_Scroll(-1);
+	}
+	ok = test_Expect(0, 0);
+	test_Scroll(-1);
+	ok = ok && test_Expect(1, 0) && test_PaneUnchanged();
+	test_Result("Scrolling back up draws the first page as it was rendered", ok);
+	test_state->browser_scroll = 0;
+}
+
+static void test_Session(){
+	// Browse down three pages and back, then scroll down a page and back,
+	// and report how many titles came from the cache
+
+	unsigned int	hits, misses;
+	unsigned int	all_hits, all_misses;
+	int				i;
+
+	ui_TitleCacheFlush();
+	test_Stats(&hits, &misses);
+	all_hits = 0;
+	all_misses = 0;
+	for (i = 2; i <= 4; i++){
+		test_Page(i);
+	}
+	for (i = 3; i >= 1; i--){
+		test_Page(i);
+	}
+	test_Stats(&hits, &misses);
+	test_Result("Browsing three pages and back renders each title once", (hits == (2 * ui_browser_max_lines)) && (misses == (4 * ui_browser_max_lines)));
+	all_hits += hits;
+	all_misses += misses;
+
+	test_state->browser_scroll = 1;
+	test_state->selected_top = 0;
+	test_state->selected_line = 0;
+	for (i = 0; i < (2 * ui_browser_max_lines); i++){
+		test_Scroll(1);
+	}
+	for (i = 0; i < (2 * ui_browser_max_lines); i++){
+		test_Scroll(-1);
+	}
+	test_state->browser_scroll = 0;
+	test_Stats(&hits, &misses);
+	test_Result("Scrolling a page and back renders no title again", misses == 0);
+	all_hits += hits;
+	all_misses += misses;
+
+	printf("      Session: %u titles drawn, %u from the cache (%u%%)\n", all_hits + all_misses, all_hits, (100 * all_hits) / (all_hits + all_misses));
+}
+
+static int test_Presented(char *name, unsigned long presents){
+	// The main loop flips once after handling each keypress; the 
+	// drawing for it should be presented by that flip and no other
+
+	unsigned long before;
+
+	before = gfx_FlipCount();
+	gfx_Flip();
+	if ((before != presents) || (gfx_FlipCount() != (presents + 1))){
+		printf("      %s: %lu present(s) while drawing, %lu by the flip\n", name, before - presents, gfx_FlipCount() - before);
+		return 0;
+	}
+	return 1;
+}
+
+static void test_Presents(){
+	// Drawing for each keypress presents nothing until the main loop flips
+
+	unsigned long presents;
+	int ok;
+
+	gfx_Flip();
+
+	presents = gfx_FlipCount();
+	test_Page(3);
+	ok = test_Presented("page down", presents);
+	presents = gfx_FlipCount();
+	test_state->selected_line = 1;
+	ui_UpdateBrowserPane(test_state, test_games);
+	ui_UpdateBrowserPaneStatus(test_state);
+	ok = ok && test_Presented("down", presents);
+	presents = gfx_FlipCount();
+	test_state->browser_scroll = 1;
+	test_state->selected_top = (test_state->selected_page - 1) * ui_browser_max_lines;
+	test_Scroll(-2);
+	test_state->browser_scroll = 0;
+	ok = ok && test_Presented("scroll up", presents);
+	presents = gfx_FlipCount();
+	ui_DrawFilterPrePopup(test_state, 0);
+	ok = ok && test_Presented("filter", presents);
+	presents = gfx_FlipCount();
+	ui_DrawFilterPrePopup(test_state, 1);
+	ok = ok && test_Presented("filter down", presents);
+	presents = gfx_FlipCount();
+	ui_PopupCloseAll();
+	ok = ok && test_Presented("cancel", presents);
+	presents = gfx_FlipCount();
+	gfx_Flip();
+	ok = ok && (gfx_FlipCount() == presents);
+	test_Result("Each keypress is presented by the one flip of the main loop", ok);
+}
+
+static int test_NoStale(int x1, int y1, int x2, int y2){
+	// Has all of an area been drawn over since the screen was filled with TEST_STALE
+
+	int x, y;
+
+	for (y = y1; y <= y2; y++){
+		for (x = x1; x <= x2; x++){
+			if (vram_buffer[(y * GFX_COLS) + x] == TEST_STALE){
+				printf("      pixel %d,%d was left as it was\n", x, y);
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static void test_Missing(){
+	// A list box whose pixels cannot be read is filled instead, so that
+	// nothing already on screen shows through the titles
+
+	unsigned char	*pixels;
+	int				y;
+	int				ok;
+
+	pixels = ui_list_bmp->pixels;
+	ui_list_bmp->pixels = NULL;
+
+	memset(vram_buffer, TEST_STALE, GFX_COLS * GFX_ROWS);
+	test_Page(5);
+	ok = test_NoStale(ui_browser_panel_x_pos, ui_browser_panel_y_pos, ui_browser_panel_x_pos + ui_list_bmp->width - 1, ui_browser_panel_y_pos + ui_list_bmp->height - 1);
+	test_Result("List box without pixels is filled when a page is drawn", ok);
+
+	// Scrolling down from the last line clears just the new bottom line
+	test_state->browser_scroll = 1;
+	test_state->selected_top = (test_state->selected_page - 1) * ui_browser_max_lines;
+	test_state->selected_line = ui_browser_max_lines - 1;
+	memset(vram_buffer, TEST_STALE, GFX_COLS * GFX_ROWS);
+	test_Scroll(1);
+	test_state->browser_scroll = 0;
+	y = ui_browser_font_y_pos + ((ui_browser_max_lines - 1) * (ui_font->height + 2));
+	ok = test_NoStale(ui_browser_font_x_pos, y, ui_browser_panel_x_pos + ui_list_bmp->width - ui_browser_right_margin, y + ui_font->height + 1);
+	test_Result("List box without pixels is filled when a line scrolls in", ok);
+
+	ui_list_bmp->pixels = pixels;
+}
+
+static int test_Init(char *font_name){
+	// The font, a plain list box, and a list of games with names of all lengths
+
+	FILE		*font_file;
+	bmpdata_t	bmpdata;
+	gamedata_t	*game;
+	int			status;
+	int			i;
+
+	font_file = fopen(font_name, "rb");
+	if (font_file == NULL){
+		printf("Error, unable to open %s\n", font_name);
+		return -1;
+	}
+	ui_font = (fontdata_t *) calloc(1, sizeof(fontdata_t));
+	memset(&bmpdata, 0, sizeof(bmpdata_t));
+	status = bmp_ReadPackedFont(font_file, &bmpdata, ui_font, 1, 0, 0);
+	if (status == 0){
+		status = bmp_ReadPackedFont(font_file, &bmpdata, ui_font, 0, 1, 0);
+	}
+	if (status == 0){
+		status = bmp_ReadPackedFont(font_file, &bmpdata, ui_font, 0, 0, 1);
+	}
+	fclose(font_file);
+	if (status != 0){
+		printf("Error, unable to read %s (%d)\n", font_name, status);
+		return -1;
+	}
+	ui_font->ascii_start = ui_font_ascii_start;
+	ui_font->n_symbols = ui_font_total_syms;
+	ui_font->unknown_symbol = ui_font_unknown;
+
+	// The size of the light theme's list box
+	ui_list_bmp = (bmpdata_t *) calloc(1, sizeof(bmpdata_t));
+	ui_list_bmp->width = 280;
+	ui_list_bmp->height = 290;
+	ui_list_bmp->size = ui_list_bmp->width * ui_list_bmp->height;
+	ui_list_bmp->pixels = (unsigned char *) malloc(ui_list_bmp->size);
+	memset(ui_list_bmp->pixels, PALETTE_UI_LGREY, ui_list_bmp->size);
+
+	test_state = (state_t *) calloc(1, sizeof(state_t));
+	test_games = NULL;
+	for (i = TEST_GAMES - 1; i >= 0; i--){
+		game = (gamedata_t *) calloc(1, sizeof(gamedata_t));
+		game->gameid = i;
+		sprintf(game->name, "%s %d", test_names[i % test_names_total], i);
+		game->next = test_games;
+		test_games = game;
+		test_state->selected_list[i] = i;
+	}
+	test_state->selected_max = TEST_GAMES;
+	test_state->total_pages = (TEST_GAMES + ui_browser_max_lines - 1) / ui_browser_max_lines;
+	test_state->selected_page = 1;
+	return 0;
+}
+
+static void test_Free(){
+
+	gamedata_t *game;
+
+	ui_TitleCacheFlush();
+	while (test_games != NULL){
+		game = test_games->next;
+		free(test_games);
+		test_games = game;
+	}
+	free(test_state);
+	free(ui_list_bmp->pixels);
+	free(ui_list_bmp);
+	bmp_DestroyFont(ui_font);
+}
+
+int main(int argc, char **argv){
+
+	if (argc > 2){
+		printf("Usage: %s [font.fnt]\n", argv[0]);
+		return 1;
+	}
+	if (test_Init((argc > 1) ? argv[1] : "../assets/font8x16.fnt") != 0){
+		return 1;
+	}
+
+	test_PageMode();
+	test_ScrollMode();
+	test_Session();
+	test_Presents();
+	test_Missing();
+	test_Free();
+
+	if (test_failures){
+		printf("%d test(s) failed\n", test_failures);
+		return 1;
+	}
+	printf("All tests passed\n");
+	return 0;
+}
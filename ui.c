@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "data.h"
 #include "gfx.h"
@@ -45,6 +46,32 @@ bmpdata_t 	*ui_select_bmp;
 bmpdata_t 	*ui_path_bmp;
 bmpdata_t	*ui_font_bmp;		// Generic, just used during loading each font and then freed
 
+// Run length encoded copies of bitmaps drawn as overlays
+spritedata_t	*ui_select_sprite;
+static int	ui_select_sprite_ypos = -1;	// Where the selection cursor was last drawn
+
+// With browser_highlight, a cursor is drawn on every line of the browser pane in 
+// a palette entry of its own, which is the background colour on all but the selected line
+static int			ui_highlight_entry[ui_browser_max_lines];
+static int			ui_highlight_line = -1;	// Line whose entry is set to the cursor colour, if any
+static int			ui_highlight_status;		// 0 until the entries are claimed, then 1, or -1 if they could not be
+static unsigned char	ui_highlight_on[3];		// Colour of the cursor
+static unsigned char	ui_highlight_off[3];		// Colour of the list box behind it
+
+// Titles of the browser pane, as rendered, so a page can be redrawn with copies of them
+static titlestrip_t	ui_title_cache[ui_title_cache_entries];
+static unsigned int	ui_title_cache_bytes;	// Bytes held by all entries
+static unsigned int	ui_title_cache_clock;	// Incremented on every use of an entry
+static unsigned int	ui_title_cache_hits;
+static unsigned int	ui_title_cache_misses;
+static int			ui_browser_drawn_start = -1;	// Range of selected_list on screen; -1 if the pane needs drawing
+static int			ui_browser_drawn_end;
+
+// Save-under stack of the open popups
+static popupsave_t	ui_popups[ui_popup_max_depth];
+static int			ui_popup_depth;		// Number of popups saved
+static int			ui_popup_lost;		// Set if a popup was opened that could not be saved
+
 // Fonts
 fontdata_t      *ui_font;
 
@@ -57,6 +84,325 @@ FILE 		*ui_asset_reader;
 static int      ui_fonts_status;
 static int      ui_assets_status;
 
+// The most recently displayed artwork, decoded into a buffer from 
+// the bmp decode buffer pool, so that it can be redrawn without
+// reading it from disk again. Its colour table is kept as well, 
+// so that its palette entries can be released for the next one.
+static char			ui_artwork_shown[65];	// Artwork still whole in the artwork window, if any
+static bmpdata_t		ui_artwork_bmp;
+
+
+// Manifest of the UI bitmaps. All of them are registered by ui_LoadAssets(), 
+// which sets their palette entries, but only those needed for the first frame
+// are read then; the rest are read on first use, by ui_AssetUse(). Those only 
+// drawn into the background layer are freed again once it has been saved. They 
+// are read from the theme archive, by name, or if there is none, from their own bitmap.
+static uiasset_t ui_assets[] = {
+	{ "select",		ui_select,				&ui_select_bmp,			0,	0 },
+	{ "cb_check",	ui_check_box,			&ui_checkbox_bmp,			0,	0 },
+	{ "cb_empty",	ui_check_box_unchecked,	&ui_checkbox_empty_bmp,	0,	1 },
+	{ "light",		ui_main,				&ui_main_bmp,				1,	1 },
+	{ "box_list",	ui_list_box,			&ui_list_bmp,				1,	1 },
+	{ "box_art",		ui_art_box,				&ui_art_bmp,				0,	0 },
+	{ "box_titl",	ui_title_box,			&ui_title_bmp,			0,	1 },
+	{ "box_year",	ui_year_box,			&ui_year_bmp,				0,	1 },
+	{ "box_genr",	ui_genre_box,			&ui_genre_bmp,			0,	1 },
+	{ "box_comp",	ui_company_box,			&ui_company_bmp,			0,	1 },
+	{ "box_seri",	ui_series_box,			&ui_series_bmp,			0,	1 },
+	{ "box_path",	ui_path_box,			&ui_path_bmp,				0,	1 },
+};
+#define ui_assets_total	(sizeof(ui_assets) / sizeof(uiasset_t))
+
+// Directory and shared colour table of the theme archive; NULL if the 
+// bitmaps were registered from their own files
+static themedata_t		*ui_theme_dir = NULL;
+static bmpdata_t		*ui_theme_bmp = NULL;
+static FILE			*ui_theme_file = NULL;	// Only kept open whilst ui_LoadAssets() runs
+
+// Returned by ui_AssetUse() if a bitmap cannot be read; it has no pixels, so draws nothing
+static bmpdata_t		ui_missing_bmp;
+
+static unsigned long	ui_asset_bytes;		// Pixels of UI bitmaps currently held
+static unsigned long	ui_asset_bytes_max;
+static unsigned int	ui_asset_loads;
+static unsigned int	ui_asset_evictions;
+
+static void ui_FreeAssets(){
+	// Free all of the UI bitmaps that have been registered, and the theme archive directory
+	
+	int i;
+	
+	for (i = 0; i < ui_assets_total; i++){
+		if (*ui_assets[i].bmp != NULL){
+			bmp_Destroy(*ui_assets[i].bmp);
+			*ui_assets[i].bmp = NULL;
+		}
+	}
+	if (ui_theme_dir != NULL){
+		free(ui_theme_dir);
+		free(ui_theme_bmp);
+		ui_theme_dir = NULL;
+		ui_theme_bmp = NULL;
+	}
+	if (ui_select_sprite != NULL){
+		gfx_SpriteDestroy(ui_select_sprite);
+		ui_select_sprite = NULL;
+	}
+	ui_asset_bytes = 0;
+}
+
+static void ui_ArtworkPalette(bmpdata_t *bmpdata, unsigned char *used, unsigned char *remap){
+	// Set the free region palette entries for the colours of bmpdata, in place of
+	// those of the image drawn there before; first the splash logo, then artwork.
+	// Its pixels have already been decoded, marking used[], and only the colours
+	// they use are given entries; remap[] is filled in to move them there.
+	// Entries of the same colour are shared with whoever else is using them.
+	
+	pal_Release(&ui_artwork_bmp);
+	pal_AllocUsed(bmpdata, 0, PALETTES_FREE, used, remap);
+	ui_artwork_bmp.colours = bmpdata->colours;
+	memcpy(ui_artwork_bmp.palette, bmpdata->palette, bmpdata->colours * sizeof(pal_entry_t));
+}
+
+static int ui_LoadTheme(){
+	// Read the directory and colour table of the theme archive, and set the 
+	// palette entries of the colour table, which is shared by all of its images
+	
+	int status;
+	
+	ui_theme_file = fopen(ui_theme, "rb");
+	if (ui_theme_file == NULL){
+		if (UI_VERBOSE){
+			printf("%s.%d\t No theme archive, using each bitmap\n", __FILE__, __LINE__);
+		}
+		return UI_ERR_FILE;
+	}
+	
+	ui_theme_dir = (themedata_t *) malloc(sizeof(themedata_t));
+	ui_theme_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
+	status = UI_ERR_BMP;
+	if ((ui_theme_dir != NULL) && (ui_theme_bmp != NULL)){
+		ui_theme_bmp->pixels = NULL;
+		status = bmp_ReadTheme(ui_theme_file, ui_theme_bmp, ui_theme_dir, 1, 1);
+	}
+	
+	if (status != 0){
+		if (UI_VERBOSE){
+			printf("%s.%d\t Error %d reading theme archive, using each bitmap\n", __FILE__, __LINE__, status);
+		}
+		fclose(ui_theme_file);
+		ui_theme_file = NULL;
+		free(ui_theme_dir);
+		free(ui_theme_bmp);
+		ui_theme_dir = NULL;
+		ui_theme_bmp = NULL;
+		return UI_ERR_BMP;
+	}
+	pal_Alloc(ui_theme_bmp, PALETTES_FREE, PALETTES_RESERVED);
+	return UI_OK;
+}
+
+static int ui_AssetRegister(uiasset_t *asset){
+	// Set up the bitmap structure of a UI bitmap, with its size and colours, 
+	// and set its palette entries, without reading any of its pixels
+	
+	themeentry_t	*image;
+	bmpdata_t	*bmp;
+	int			status;
+	
+	bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
+	if (bmp == NULL){
+		return UI_ERR_BMP;
+	}
+	*asset->bmp = bmp;
+	bmp->pixels = NULL;
+	
+	if (ui_theme_dir != NULL){
+		// The palette entries are already set, for the whole archive
+		image = bmp_FindThemeImage(ui_theme_dir, asset->name);
+		if (image == NULL){
+			return UI_ERR_BMP;
+		}
+		bmp->width = image->width;
+		bmp->height = image->height;
+		bmp->size = image->width * image->height;
+		return UI_OK;
+	}
+	
+	if (BMP_VERBOSE){
+		printf("%s.%d\t Registering %s\n", __FILE__, __LINE__, asset->path);
+	}
+	ui_asset_reader = fopen(asset->path, "rb");
+	if (ui_asset_reader == NULL){
+		return UI_ERR_FILE;
+	}
+	status = bmp_ReadImage(ui_asset_reader, bmp, 1, 1, 0);
+	fclose(ui_asset_reader);
+	if (status != 0){
+		return UI_ERR_BMP;
+	}
+	pal_BMP2Palette(bmp, 1);
+	return UI_OK;
+}
+
+static int ui_AssetLoad(uiasset_t *asset){
+	// Read the pixels of a registered UI bitmap; they are remapped as they 
+	// are read to the palette entries set when it was registered
+	
+	bmpdata_t	*bmp;
+	uclock_t		start_time;
+	int			status;
+	
+	bmp = *asset->bmp;
+	start_time = uclock();
+	if (ui_theme_file != NULL){
+		ui_asset_reader = ui_theme_file;
+	} else if (ui_theme_dir != NULL){
+		ui_asset_reader = fopen(ui_theme, "rb");
+	} else {
+		ui_asset_reader = fopen(asset->path, "rb");
+	}
+	if (ui_asset_reader == NULL){
+		return UI_ERR_FILE;
+	}
+	if (ui_theme_dir != NULL){
+		status = bmp_ReadThemeImage(ui_asset_reader, ui_theme_bmp, ui_theme_dir, asset->name, bmp);
+	} else {
+		// Only the header again; reading the colour table would reset the remap
+		status = bmp_ReadImage(ui_asset_reader, bmp, 1, 0, 0);
+		if (status == 0){
+			status = bmp_ReadImage(ui_asset_reader, bmp, 0, 0, 1);
+		}
+	}
+	if (ui_asset_reader != ui_theme_file){
+		fclose(ui_asset_reader);
+	}
+	if ((status != 0) || (bmp->pixels == NULL)){
+		if (UI_VERBOSE){
+			printf("%s.%d\t Error %d reading UI bitmap [%s]\n", __FILE__, __LINE__, status, asset->name);
+		}
+		bmp->pixels = NULL;
+		return UI_ERR_BMP;
+	}
+	
+	ui_asset_loads++;
+	ui_asset_bytes += bmp->size;
+	if (ui_asset_bytes > ui_asset_bytes_max){
+		ui_asset_bytes_max = ui_asset_bytes;
+	}
+	if (UI_VERBOSE){
+		printf("%s.%d\t Read UI bitmap [%s], %d bytes in %ldus\n", __FILE__, __LINE__, asset->name, bmp->size, 
+			(long) (((uclock() - start_time) * 1000000) / UCLOCKS_PER_SEC));
+	}
+	return UI_OK;
+}
+
+static bmpdata_t *ui_AssetUse(bmpdata_t *bmp){
+	// A UI bitmap, with its pixels; they are read if this is the 
+	// first time it has been used, or it has been evicted since
+	
+	int i;
+	
+	if ((bmp != NULL) && (bmp->pixels != NULL)){
+		return bmp;
+	}
+	for (i = 0; i < ui_assets_total; i++){
+		if ((bmp != NULL) && (*ui_assets[i].bmp == bmp)){
+			if (ui_AssetLoad(&ui_assets[i]) == UI_OK){
+				return bmp;
+			}
+			break;
+		}
+	}
+	return &ui_missing_bmp;
+}
+
+static int ui_DrawAsset(int x, int y, bmpdata_t *bmp){
+	// Draw a UI bitmap, reading its pixels first if need be. If they cannot
+	// be read, its area is filled instead, so that whatever was drawn there 
+	// before does not show through. Returns -1 if so.
+	
+	bmpdata_t *drawn;
+	
+	drawn = ui_AssetUse(bmp);
+	if (drawn->pixels == NULL){
+		if (UI_VERBOSE){
+			printf("%s.%d\t No pixels to draw UI bitmap at x:%d y:%d\n", __FILE__, __LINE__, x, y);
+		}
+		if (bmp != NULL){
+			gfx_BoxFill(x, y, x + bmp->width - 1, y + bmp->height - 1, PALETTE_UI_BLACK);
+		}
+		return -1;
+	}
+	return gfx_Bitmap(x, y, drawn);
+}
+
+static unsigned long ui_AssetsEvict(unsigned char background){
+	// Free the pixels of all UI bitmaps when memory runs short, or only those drawn 
+	// into the background layer, once it is saved. Those that are needed again 
+	// are read again; their palette entries are kept, and anything drawn with 
+	// them already is left as it is. Returns the bytes freed.
+	
+	bmpdata_t		*bmp;
+	unsigned long	freed;
+	int			i;
+	
+	freed = 0;
+	for (i = 0; i < ui_assets_total; i++){
+		bmp = *ui_assets[i].bmp;
+		if ((bmp != NULL) && (bmp->pixels != NULL) && (ui_assets[i].background || !background)){
+			free(bmp->pixels);
+			bmp->pixels = NULL;
+			freed += bmp->size;
+			ui_asset_evictions++;
+		}
+	}
+	ui_asset_bytes -= freed;
+	if (UI_VERBOSE){
+		printf("%s.%d\t Evicted UI bitmaps, %lu bytes freed\n", __FILE__, __LINE__, freed);
+	}
+	return freed;
+}
+
+static spritedata_t *ui_SelectSprite(){
+	// The cursor is drawn as a sprite, with its top left pixel colour transparent;
+	// it is made from the cursor bitmap the first time it is drawn.
+	// Returns NULL if the bitmap could not be read or the sprite not made, 
+	// in which case the cursor bitmap is drawn keyed instead.
+	
+	bmpdata_t *bmp;
+	
+	if (ui_select_sprite == NULL){
+		bmp = ui_AssetUse(ui_select_bmp);
+		if (bmp->pixels == NULL){
+			return NULL;
+		}
+		ui_select_sprite = (spritedata_t *) malloc(sizeof(spritedata_t));
+		if (ui_select_sprite == NULL){
+			if (UI_VERBOSE){
+				printf("%s.%d\t Unable to allocate selection sprite\n", __FILE__, __LINE__);
+			}
+			return NULL;
+		}
+		if (gfx_SpriteFromBitmap(bmp, ui_select_sprite, bmp->pixels[0]) != 0){
+			if (UI_VERBOSE){
+				printf("%s.%d\t Unable to make selection sprite, using bitmap\n", __FILE__, __LINE__);
+			}
+			free(ui_select_sprite);
+			ui_select_sprite = NULL;
+			return NULL;
+		}
+	}
+	return ui_select_sprite;
+}
+
+void ui_AssetStats(){
+	// Print a summary of the reading and eviction of UI bitmaps
+	
+	printf("UI bitmaps: %u registered, %u reads, %u evictions\n", (unsigned int) ui_assets_total, ui_asset_loads, ui_asset_evictions);
+	printf("- Pixels: %lu bytes held, %lu at most\n", ui_asset_bytes, ui_asset_bytes_max);
+}
+
 
 void ui_Init(){
 	
@@ -68,20 +414,19 @@ void ui_Init(){
 }
 
 void ui_Close(){
-	if (ui_assets_status == UI_ASSETS_LOADED){
-		bmp_Destroy(ui_checkbox_bmp);
-		bmp_Destroy(ui_checkbox_empty_bmp);
-		bmp_Destroy(ui_main_bmp);
-		bmp_Destroy(ui_list_bmp);
-		bmp_Destroy(ui_art_bmp);
-		bmp_Destroy(ui_title_bmp);
-		bmp_Destroy(ui_year_bmp);
-		bmp_Destroy(ui_genre_bmp);
-		bmp_Destroy(ui_company_bmp);
-		bmp_Destroy(ui_series_bmp);
-		bmp_Destroy(ui_path_bmp);
-		bmp_Destroy(ui_select_bmp);
+	ui_FreeAssets();
+	ui_TitleCacheFlush();
+	ui_PopupDiscardAll();
+}
+
+void ui_ClearArtwork(){
+	// Clear the artwork window back to the background layer, 
+	// and forget whatever artwork was shown in it
+	
+	if (gfx_BackgroundRestore(ui_artwork_xpos, ui_artwork_ypos, ui_artwork_xpos + 320, ui_artwork_ypos + 200) != 0){
+		gfx_BoxFill(ui_artwork_xpos, ui_artwork_ypos, ui_artwork_xpos + 320, ui_artwork_ypos + 200, PALETTE_UI_BLACK);
 	}
+	ui_artwork_shown[0] = '\0';
 }
 
 int ui_DisplayArtwork(FILE *screenshot_file, bmpdata_t *screenshot_bmp, state_t *state, imagefile_t *imagefile){
@@ -89,6 +434,10 @@ int ui_DisplayArtwork(FILE *screenshot_file, bmpdata_t *screenshot_bmp, state_t
 	int status;
 	int has_screenshot;
 	char msg[65];
+	bmpdest_t dest;
+	unsigned char used[256];
+	unsigned char remap[256];
+	uclock_t start_time;
 	
 	// Restart artwork display
 	// =======================
@@ -99,8 +448,6 @@ int ui_DisplayArtwork(FILE *screenshot_file, bmpdata_t *screenshot_bmp, state_t
 		screenshot_file = NULL;
 	}
 	
-	// Clear artwork window
-	gfx_BoxFill(ui_artwork_xpos, ui_artwork_ypos, ui_artwork_xpos + 320, ui_artwork_ypos + 200, PALETTE_UI_BLACK);
 	memset(state->selected_image, '\0', sizeof(state->selected_image)); 
 	
 	// Construct full path of image
@@ -110,12 +457,25 @@ int ui_DisplayArtwork(FILE *screenshot_file, bmpdata_t *screenshot_bmp, state_t
 		printf("%s.%d\t Selected artwork filename [%s]\n", __FILE__, __LINE__, imagefile->next->filename);
 	}
 	
+	// =======================
+	// The same artwork as last time is still on screen, 
+	// and its palette entries are still held
+	// =======================
+	if (strcmp(ui_artwork_shown, state->selected_image) == 0){
+		if (UI_VERBOSE){
+			printf("%s.%d\t Artwork already shown\n", __FILE__, __LINE__);	
+		}
+		return UI_OK;
+	}
+	ui_ClearArtwork();
+	
 	// =======================
 	// Open new screenshot file, ready parse
 	// =======================
 	if (UI_VERBOSE){
 		printf("%s.%d\t Opening artwork file\n", __FILE__, __LINE__);	
 	}
+	start_time = uclock();
 	screenshot_file = fopen(state->selected_image, "rb");
 	if (screenshot_file == NULL){
 		if (UI_VERBOSE){
@@ -125,12 +485,12 @@ int ui_DisplayArtwork(FILE *screenshot_file, bmpdata_t *screenshot_bmp, state_t
 	} 
 	else {
 		// =======================
-		// Load header of screenshot bmp
+		// Load header and palette of screenshot bmp
 		// =======================
 		if (UI_VERBOSE){
-			printf("%s.%d\t Reading BMP data\n", __FILE__, __LINE__);	
+			printf("%s.%d\t Reading BMP header\n", __FILE__, __LINE__);	
 		}
-		status = bmp_ReadImage(screenshot_file, screenshot_bmp, 1, 1, 1);
+		status = bmp_ReadImage(screenshot_file, screenshot_bmp, 1, 1, 0);
 		if (status != 0){
 			if (UI_VERBOSE){
 				printf("%s.%d\t Error, BMP read call returned error\n", __FILE__, __LINE__);	
@@ -139,34 +499,150 @@ int ui_DisplayArtwork(FILE *screenshot_file, bmpdata_t *screenshot_bmp, state_t
 		} else {
 			has_screenshot = 1;	
 		}
+		
 		if (has_screenshot){
-			// Reset free palette region
+			// Decode the pixel data straight into the buffer, centred in and 
+			// clipped to the artwork window. No copy of the image is held in memory.
+			// The colours of the pixels which are written are noted as they are.
 			if (UI_VERBOSE){
-				printf("%s.%d\t Resetting free palette region entries\n", __FILE__, __LINE__);	
+				printf("%s.%d\t Decoding BMP to buffer\n", __FILE__, __LINE__);	
 			}
-			pal_ResetFree();
-			// Set free palette region
+			// Images larger than the artwork window (e.g. full screen 640x400 captures) 
+			// are scaled down by a whole factor as they are decoded, rather than cropped
+			dest.scale = bmp_FitScale(screenshot_bmp, ui_artwork_width, ui_artwork_height);
 			if (UI_VERBOSE){
-				printf("%s.%d\t Setting new palette entries\n", __FILE__, __LINE__);	
+				printf("%s.%d\t Artwork is %dx%d, scaling down by %d\n", __FILE__, __LINE__, screenshot_bmp->width, screenshot_bmp->height, dest.scale);	
 			}
-			pal_BMP2Palette(screenshot_bmp, 0);
-			// Display bitmap
+			dest.buffer = vram_buffer;
+			dest.pitch = GFX_COLS;
+			dest.x = ui_artwork_xpos + ((ui_artwork_width - (int) (screenshot_bmp->width / dest.scale)) / 2);
+			dest.y = ui_artwork_ypos + ((ui_artwork_height - (int) (screenshot_bmp->height / dest.scale)) / 2);
+			dest.clip_x1 = ui_artwork_xpos;
+			dest.clip_y1 = ui_artwork_ypos;
+			dest.clip_x2 = ui_artwork_xpos + ui_artwork_width - 1;
+			dest.clip_y2 = ui_artwork_ypos + ui_artwork_height - 1;
+			gfx_Dirty(dest.clip_x1, dest.clip_y1, dest.clip_x2, dest.clip_y2);
+			memset(used, 0, sizeof(used));
+			bmp_SetUsed(used);
+			status = bmp_ReadImageTo(screenshot_file, screenshot_bmp, &dest);
+			bmp_SetUsed(NULL);
+			
+			// Set free palette region for just those colours, releasing the entries
+			// of the previous artwork, and move the pixels onto them; including
+			// any decoded before an error.
 			if (UI_VERBOSE){
-				printf("%s.%d\t Rendering BMP to buffer\n", __FILE__, __LINE__);	
+				printf("%s.%d\t Setting new palette entries\n", __FILE__, __LINE__);	
+			}
+			ui_ArtworkPalette(screenshot_bmp, used, remap);
+			bmp_Remap(screenshot_bmp, &dest, remap);
+			if (status != 0){
+				if (UI_VERBOSE){
+					printf("%s.%d\t Error, BMP decode call returned error\n", __FILE__, __LINE__);	
+				}
+			} else {
+				// Showing it again while it is still on screen reads nothing
+				strcpy(ui_artwork_shown, state->selected_image);
 			}
-			gfx_Bitmap(ui_artwork_xpos + ((320 - screenshot_bmp->width) / 2) , ui_artwork_ypos + ((200 - screenshot_bmp->height) / 2), screenshot_bmp);
 		}
+		fclose(screenshot_file);
 	}
 	if (UI_VERBOSE){
 		printf("%s.%d\t Call to display %s complete\n", __FILE__, __LINE__, imagefile->next->filename);	
+		printf("%s.%d\t Artwork loaded in %ldms\n", __FILE__, __LINE__, (long) (((uclock() - start_time) * 1000) / UCLOCKS_PER_SEC));
 	}
-	fclose(screenshot_file);
 	return UI_OK;
 }
 
+static void ui_PopupOpen(int x1, int y1, int x2, int y2){
+	// Save the area a popup is about to cover, including its drop-shadow.
+	// Drawing the same popup again, e.g. to move its selection, saves nothing.
+	
+	popupsave_t *popup;
+	
+	if (x1 < 0){
+		x1 = 0;
+	}
+	if (y1 < 0){
+		y1 = 0;
+	}
+	if (x2 >= GFX_COLS){
+		x2 = GFX_COLS - 1;
+	}
+	if (y2 >= GFX_ROWS){
+		y2 = GFX_ROWS - 1;
+	}
+	if (ui_popup_depth > 0){
+		popup = &ui_popups[ui_popup_depth - 1];
+		if ((popup->x == x1) && (popup->y == y1) && (popup->width == (x2 - x1 + 1)) && (popup->height == (y2 - y1 + 1))){
+			return;
+		}
+	}
+	if (ui_popup_depth == ui_popup_max_depth){
+		if (UI_VERBOSE){
+			printf("%s.%d\t Too many popups open, unable to save popup area\n", __FILE__, __LINE__);
+		}
+		ui_popup_lost = 1;
+		return;
+	}
+	popup = &ui_popups[ui_popup_depth];
+	popup->x = x1;
+	popup->y = y1;
+	popup->width = x2 - x1 + 1;
+	popup->height = y2 - y1 + 1;
+	popup->pixels = (unsigned char *) malloc(popup->width * popup->height);
+	if ((popup->pixels == NULL) && (ui_AssetsEvict(0) > 0)){
+		popup->pixels = (unsigned char *) malloc(popup->width * popup->height);
+	}
+	if (popup->pixels == NULL){
+		if (UI_VERBOSE){
+			printf("%s.%d\t Unable to allocate %d bytes to save popup area\n", __FILE__, __LINE__, popup->width * popup->height);
+		}
+		ui_popup_lost = 1;
+		return;
+	}
+	gfx_SaveRect(popup->x, popup->y, popup->width, popup->height, popup->pixels);
+	ui_popup_depth++;
+}
+
+int ui_PopupCloseAll(){
+	// Close all open popups, putting back the pixels they covered, newest first.
+	// If any popup could not be saved the screen can't be fully restored, 
+	// so an error is returned and the caller must redraw the main window.
+	
+	int status;
+	
+	status = UI_OK;
+	if (ui_popup_lost || (ui_popup_depth == 0)){
+		status = UI_ERR_FUNCTION_CALL;
+	}
+	while (ui_popup_depth > 0){
+		ui_popup_depth--;
+		if (status == UI_OK){
+			gfx_RestoreRect(ui_popups[ui_popup_depth].x, ui_popups[ui_popup_depth].y, ui_popups[ui_popup_depth].width, ui_popups[ui_popup_depth].height, ui_popups[ui_popup_depth].pixels);
+		}
+		free(ui_popups[ui_popup_depth].pixels);
+		ui_popups[ui_popup_depth].pixels = NULL;
+	}
+	ui_popup_lost = 0;
+	return status;
+}
+
+void ui_PopupDiscardAll(){
+	// Forget all open popups without restoring them, as the screen has been redrawn
+	
+	while (ui_popup_depth > 0){
+		ui_popup_depth--;
+		free(ui_popups[ui_popup_depth].pixels);
+		ui_popups[ui_popup_depth].pixels = NULL;
+	}
+	ui_popup_lost = 0;
+}
+
 int	ui_DrawConfirmPopup(state_t *state, gamedata_t *gamedata, launchdat_t *launchdat){
 	// Draw a confirmation box to start the game
 	
+	ui_PopupOpen(ui_launch_popup_xpos + 50, ui_launch_popup_ypos - 40, ui_launch_popup_xpos + 260, ui_launch_popup_ypos + 50);
+	
 	// Draw drop-shadow
 	gfx_BoxFillTranslucent(ui_launch_popup_xpos + 60, ui_launch_popup_ypos - 30, ui_launch_popup_xpos + 260, ui_launch_popup_ypos + 50, PALETTE_UI_DGREY);
 	
@@ -188,6 +664,8 @@ int	ui_DrawConfirmPopup(state_t *state, gamedata_t *gamedata, launchdat_t *launc
 int ui_DrawFilterPrePopup(state_t *state, int toggle){
 	// Draw a popup that allows the user to toggle filter mode between genre, series and off
 
+	ui_PopupOpen(ui_launch_popup_xpos, ui_launch_popup_ypos, ui_launch_popup_xpos + 10 + ui_launch_popup_width, ui_launch_popup_ypos + 10 + ui_launch_popup_height + 30);
+	
 	// Draw drop-shadow
 	gfx_BoxFillTranslucent(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 10, ui_launch_popup_xpos + 10 + ui_launch_popup_width, ui_launch_popup_ypos + 10 + ui_launch_popup_height + 30, PALETTE_UI_DGREY);
 	
@@ -224,21 +702,21 @@ int ui_DrawFilterPrePopup(state_t *state, int toggle){
 	
 	if (state->selected_filter == FILTER_NONE){
 		// none
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 35, ui_checkbox_bmp);
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 65, ui_checkbox_empty_bmp);
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 95, ui_checkbox_empty_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 35, ui_checkbox_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 65, ui_checkbox_empty_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 95, ui_checkbox_empty_bmp);
 	}
 	if (state->selected_filter == FILTER_GENRE){
 		// genre
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 35, ui_checkbox_empty_bmp);
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 65, ui_checkbox_bmp);
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 95, ui_checkbox_empty_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 35, ui_checkbox_empty_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 65, ui_checkbox_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 95, ui_checkbox_empty_bmp);
 	}
 	if (state->selected_filter == FILTER_SERIES){
 		// series
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 35, ui_checkbox_empty_bmp);
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 65, ui_checkbox_empty_bmp);
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 95, ui_checkbox_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 35, ui_checkbox_empty_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 65, ui_checkbox_empty_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 95, ui_checkbox_bmp);
 	}
 	
 	return UI_OK;
@@ -250,6 +728,8 @@ int ui_DrawFilterPopup(state_t *state, int toggle){
 	int i;
 	int status;
 	
+	ui_PopupOpen(30, 40, GFX_COLS - 30, GFX_ROWS - 20);
+	
 	// Draw drop-shadow
 	gfx_BoxFillTranslucent(40, 50, GFX_COLS - 30, GFX_ROWS - 20, PALETTE_UI_DGREY);
 	
@@ -288,9 +768,9 @@ int ui_DrawFilterPopup(state_t *state, int toggle){
 			// Column 1
 			if (i < 11){
 				if (i == state->selected_filter_string){
-					gfx_Bitmap(45, 70 + (i * 25), ui_checkbox_bmp);
+					ui_DrawAsset(45, 70 + (i * 25), ui_checkbox_bmp);
 				} else {
-					gfx_Bitmap(45, 70 + (i * 25), ui_checkbox_empty_bmp);
+					ui_DrawAsset(45, 70 + (i * 25), ui_checkbox_empty_bmp);
 				}
 				gfx_Puts(70, 70 + (i * 25), ui_font, state->filter_strings[i]);
 			}
@@ -298,9 +778,9 @@ int ui_DrawFilterPopup(state_t *state, int toggle){
 			// Column 2
 			if ((i >= 11) && (i < 22)){
 				if (i == state->selected_filter_string){
-					gfx_Bitmap(230, 70 + ((i - 11) * 25), ui_checkbox_bmp);
+					ui_DrawAsset(230, 70 + ((i - 11) * 25), ui_checkbox_bmp);
 				} else {
-					gfx_Bitmap(230, 70 + ((i - 11) * 25), ui_checkbox_empty_bmp);
+					ui_DrawAsset(230, 70 + ((i - 11) * 25), ui_checkbox_empty_bmp);
 				}
 				gfx_Puts(255, 70 + ((i - 11) * 25), ui_font, state->filter_strings[i]);
 			}
@@ -308,9 +788,9 @@ int ui_DrawFilterPopup(state_t *state, int toggle){
 			// Column 3
 			if (i >= 22){
 				if (i == state->selected_filter_string){
-					gfx_Bitmap(420, 70 + ((i - 22) * 25), ui_checkbox_bmp);
+					ui_DrawAsset(420, 70 + ((i - 22) * 25), ui_checkbox_bmp);
 				} else {
-					gfx_Bitmap(420, 70 + ((i - 22) * 25), ui_checkbox_empty_bmp);
+					ui_DrawAsset(420, 70 + ((i - 22) * 25), ui_checkbox_empty_bmp);
 				}
 				gfx_Puts(445, 70 + ((i - 22) * 25), ui_font, state->filter_strings[i]);
 			}	
@@ -348,6 +828,8 @@ int	ui_DrawLaunchPopup(state_t *state, gamedata_t *gamedata, launchdat_t *launch
 	
 	int status;	
 	
+	ui_PopupOpen(ui_launch_popup_xpos, ui_launch_popup_ypos, ui_launch_popup_xpos + 10 + ui_launch_popup_width, ui_launch_popup_ypos + 10 + ui_launch_popup_height);
+	
 	// Draw drop-shadow
 	gfx_BoxFillTranslucent(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 10, ui_launch_popup_xpos + 10 + ui_launch_popup_width, ui_launch_popup_ypos + 10 + ui_launch_popup_height, PALETTE_UI_DGREY);
 	
@@ -371,26 +853,87 @@ int	ui_DrawLaunchPopup(state_t *state, gamedata_t *gamedata, launchdat_t *launch
 	
 	if (state->selected_start == 0){
 		// Checkbox for start
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 35, ui_checkbox_bmp);
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 65, ui_checkbox_empty_bmp);		
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 35, ui_checkbox_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 65, ui_checkbox_empty_bmp);		
 	} else {
 		// Checkbox for alt_start
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 35, ui_checkbox_empty_bmp);
-		gfx_Bitmap(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 65, ui_checkbox_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 35, ui_checkbox_empty_bmp);
+		ui_DrawAsset(ui_launch_popup_xpos + 10, ui_launch_popup_ypos + 65, ui_checkbox_bmp);
 	}
 	
 	return UI_OK;
 }
 
 
+static int ui_ComposeBackground(){
+	// Build the static background layer; the main window with all of the 
+	// panes and boxes drawn empty, as they are before any text goes in them
+	
+	int status;
+	
+	status = ui_DrawAsset(0, 0, ui_main_bmp);
+	
+	// Browser pane
+	ui_DrawAsset(ui_browser_panel_x_pos, ui_browser_panel_y_pos, ui_list_bmp);
+	
+	// Artwork window
+	gfx_BoxFill(ui_artwork_xpos, ui_artwork_ypos, ui_artwork_xpos + 320, ui_artwork_ypos + 200, PALETTE_UI_BLACK);
+	
+	// Info pane text boxes
+	ui_DrawAsset(ui_info_name_xpos, ui_info_name_ypos, ui_title_bmp);
+	ui_DrawAsset(ui_info_company_xpos, ui_info_company_ypos, ui_company_bmp);
+	ui_DrawAsset(ui_info_path_xpos, ui_info_path_ypos, ui_path_bmp);
+	ui_DrawAsset(ui_info_year_xpos, ui_info_year_ypos, ui_year_bmp);
+	ui_DrawAsset(ui_info_genre_xpos, ui_info_genre_ypos, ui_genre_bmp);
+	ui_DrawAsset(ui_info_series_xpos, ui_info_series_ypos, ui_series_bmp);
+	
+	// Info pane checkboxes
+	ui_DrawAsset(ui_checkbox_has_metadata_xpos, ui_checkbox_has_metadata_ypos, ui_checkbox_empty_bmp);
+	ui_DrawAsset(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_empty_bmp);
+	ui_DrawAsset(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_empty_bmp);
+	ui_DrawAsset(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_empty_bmp);
+	ui_DrawAsset(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_empty_bmp);
+	ui_DrawAsset(ui_checkbox_filter_active_xpos, ui_checkbox_filter_active_ypos, ui_checkbox_empty_bmp);
+	
+	// Keep it; if there isn't the memory for it, even once the UI bitmaps 
+	// are evicted, everything is just drawn from the bitmaps each time instead
+	if ((gfx_BackgroundSave() != 0) && ((ui_AssetsEvict(0) == 0) || (gfx_BackgroundSave() != 0))){
+		if (UI_VERBOSE){
+			printf("%s.%d\t Unable to save background layer\n", __FILE__, __LINE__);
+		}
+	} else {
+		// Everything drawn into it is restored from it from now on, so those 
+		// bitmaps are only needed again if it has to be composed again
+		ui_AssetsEvict(1);
+	}
+	return status;
+}
+
+static void ui_ClearBox(int x, int y, bmpdata_t *box){
+	// Clear the area under one of the boxes back to the background layer,
+	// or draw the box again if there is no background layer
+	
+	if (gfx_BackgroundRestore(x, y, x + box->width - 1, y + box->height - 1) != 0){
+		ui_DrawAsset(x, y, box);
+	}
+}
+
 int	ui_DrawMainWindow(){
 	// Draw the background of the main user interface window
 	
 	int status;
 	
-	// Initially, we can use a single solid bmp, with all of the ui elements on, but later as we overlay other things on top of it,
-	// we'll need to refresh various individual elements
-	status = gfx_Bitmap(0, 0, ui_main_bmp);
+	// The static background is composed once, and after that is copied 
+	// back from the background layer, rather than drawn from each bitmap
+	status = gfx_BackgroundRestore(0, 0, GFX_COLS - 1, GFX_ROWS - 1);
+	if (status != 0){
+		status = ui_ComposeBackground();
+	}
+	
+	// Everything has been painted over, including the browser pane, the artwork and any popups
+	ui_browser_drawn_start = -1;
+	ui_artwork_shown[0] = '\0';
+	ui_PopupDiscardAll();
 	if (status == 0){
 		return UI_OK;
 	} else {
@@ -406,6 +949,8 @@ int ui_DrawSplash(){
 	*/
 	int			status;
 	bmpdata_t 	*logo_bmp;
+	unsigned char	used[256];
+	unsigned char	remap[256];
 	
 	// Load splash logo
 	ui_asset_reader = fopen(splash_logo, "rb");
@@ -415,7 +960,21 @@ int ui_DrawSplash(){
 	}
 	logo_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
 	logo_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, logo_bmp, 1, 1, 1);
+	status = bmp_ReadImage(ui_asset_reader, logo_bmp, 1, 1, 0);
+	
+	// It is only drawn once, so it is decoded into a pool buffer if it can be.
+	// Then the palette entries are set for just the colours its pixels use,
+	// and the pixels moved onto them.
+	if (status == 0){
+		memset(used, 0, sizeof(used));
+		bmp_SetUsed(used);
+		status = bmp_ReadImagePooled(ui_asset_reader, logo_bmp);
+		bmp_SetUsed(NULL);
+	}
+	if (status == 0){
+		ui_ArtworkPalette(logo_bmp, used, remap);
+		bmp_Remap(logo_bmp, NULL, remap);
+	}
 	if (status != 0){
 		printf("Unable to read BMP\n");
 		fclose(ui_asset_reader);
@@ -423,10 +982,6 @@ int ui_DrawSplash(){
 	}
 	fclose(ui_asset_reader);
 	
-	// Set the palette entries for the splash logo
-	pal_ResetFree();
-	pal_BMP2Palette(logo_bmp, 0);
-	
 	gfx_Bitmap((GFX_COLS / 2) - (logo_bmp->width / 2), (GFX_ROWS / 2) - (logo_bmp->height / 2), logo_bmp);
 	
 	// Destroy in-memory bitmap
@@ -471,264 +1026,43 @@ int ui_DrawSplashProgress(int redraw, int progress_width){
 }
 
 int ui_LoadAssets(){
-	// Load all UI bitmap assets from disk
+	// Register all UI bitmap assets, and read those needed for the first frame
 	
-	int status;
+	uclock_t	start_time;
+	int		status;
+	int		i;
 	
 	// Default to assets not loaded
 	ui_assets_status = UI_ASSETS_MISSING;
 	
-	// list select bmp
-	ui_ProgressMessage("Loading browser select icon...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_select);
-	}
-	ui_asset_reader = fopen(ui_select, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_select_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_select_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_select_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_select_bmp, 1);
-	//pal_BMPRemap(ui_checkbox_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
-	}
-	fclose(ui_asset_reader);
-	
-	// Checkbox
-	ui_ProgressMessage("Loading checkbox...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_check_box);
-	}
-	ui_asset_reader = fopen(ui_check_box, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_checkbox_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_checkbox_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_checkbox_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_checkbox_bmp, 1);
-	//pal_BMPRemap(ui_checkbox_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
-	}
-	fclose(ui_asset_reader);
-	
-	// Checkbox - empty
-	ui_ProgressMessage("Loading checkbox (empty) ...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_check_box_unchecked);
-	}
-	ui_asset_reader = fopen(ui_check_box_unchecked, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_checkbox_empty_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_checkbox_empty_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_checkbox_empty_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_checkbox_empty_bmp, 1);
-	//pal_BMPRemap(ui_checkbox_empty_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
-	}
-	fclose(ui_asset_reader);
-	
-	// Main background
-	ui_ProgressMessage("Loading main UI background ...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_main);
-	}
-	ui_asset_reader = fopen(ui_main, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_main_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_main_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_main_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_main_bmp, 1);
-	//pal_BMPRemap(ui_main_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
-	}
-	fclose(ui_asset_reader);
-	
-	// List window
-	ui_ProgressMessage("Loading browser background ...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_list_box);
-	}
-	ui_asset_reader = fopen(ui_list_box, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_list_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_list_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_list_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_list_bmp, 1);
-	//pal_BMPRemap(ui_list_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
-	}
-	fclose(ui_asset_reader);
-	
-	// Art window
-	ui_ProgressMessage("Loading artwork background ...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_art_box);
-	}
-	ui_asset_reader = fopen(ui_art_box, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_art_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_art_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_art_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_art_bmp, 1);
-	//pal_BMPRemap(ui_art_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
-	}
-	fclose(ui_asset_reader);
-	
-	// Game title bar
-	ui_ProgressMessage("Loading text entry (title) ...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_title_box);
-	}
-	ui_asset_reader = fopen(ui_title_box, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_title_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_title_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_title_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_title_bmp, 1);
-	//pal_BMPRemap(ui_title_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
-	}
-	fclose(ui_asset_reader);
-	
-	// Game year bar
-	ui_ProgressMessage("Loading text entry (year) ...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_year_box);
-	}
-	ui_asset_reader = fopen(ui_year_box, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_year_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_year_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_year_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_year_bmp, 1);
-	//pal_BMPRemap(ui_year_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
-	}
-	fclose(ui_asset_reader);
-	
-	// Game genre bar
-	ui_ProgressMessage("Loading text entry (genre) ...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_genre_box);
-	}
-	ui_asset_reader = fopen(ui_genre_box, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_genre_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_genre_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_genre_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_genre_bmp, 1);
-	//pal_BMPRemap(ui_genre_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
-	}
-	fclose(ui_asset_reader);
-	
-	// Game company bar
-	ui_ProgressMessage("Loading text entry (company) ...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_company_box);
-	}
-	ui_asset_reader = fopen(ui_company_box, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_company_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_company_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_company_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_company_bmp, 1);
-	//pal_BMPRemap(ui_company_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
-	}
-	fclose(ui_asset_reader);
-	
-	// Game series bar
-	ui_ProgressMessage("Loading text entry (series) ...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_series_box);
-	}
-	ui_asset_reader = fopen(ui_series_box, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
-	}
-	ui_series_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_series_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_series_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_series_bmp, 1);
-	//pal_BMPRemap(ui_series_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
+	start_time = uclock();
+	ui_LoadTheme();
+	for (i = 0; i < ui_assets_total; i++){
+		status = ui_AssetRegister(&ui_assets[i]);
+		if ((status == UI_OK) && ui_assets[i].startup){
+			status = ui_AssetLoad(&ui_assets[i]);
+		}
+		if (status != UI_OK){
+			if (UI_VERBOSE){
+				printf("%s.%d\t Unable to load UI bitmap [%s]\n", __FILE__, __LINE__, ui_assets[i].name);
+			}
+			break;
+		}
 	}
-	fclose(ui_asset_reader);
 	
-	// Path bar
-	ui_ProgressMessage("Loading text entry (path) ...");
-	gfx_Flip();
-	if (BMP_VERBOSE){
-		printf("%s.%d\t Loading %s\n", __FILE__, __LINE__, ui_path_box);
+	// The rest are read from the archive as they are needed
+	if (ui_theme_file != NULL){
+		fclose(ui_theme_file);
+		ui_theme_file = NULL;
 	}
-	ui_asset_reader = fopen(ui_path_box, "rb");
-	if (ui_asset_reader == NULL){
-			return UI_ERR_FILE;     
+	if (status != UI_OK){
+		ui_FreeAssets();
+		return status;
 	}
-	ui_path_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_path_bmp->pixels = NULL;
-	status = bmp_ReadImage(ui_asset_reader, ui_path_bmp, 1, 1, 1);
-	pal_BMP2Palette(ui_path_bmp, 1);
-	//pal_BMPRemap(ui_path_bmp);
-	if (status != 0){
-			fclose(ui_asset_reader);
-			return UI_ERR_BMP;
+	if (UI_VERBOSE){
+		printf("%s.%d\t UI bitmaps registered in %ldus, %lu bytes of pixels read\n", __FILE__, __LINE__, 
+			(long) (((uclock() - start_time) * 1000000) / UCLOCKS_PER_SEC), ui_asset_bytes);
 	}
-	fclose(ui_asset_reader);
 	
 	// Set assets loaded status
 	ui_assets_status = UI_ASSETS_LOADED;
@@ -744,22 +1078,43 @@ int ui_LoadFonts(){
 	// =========================
 	// main font
 	// =========================
+	ui_font = (fontdata_t *) malloc(sizeof(fontdata_t));
+	ui_font->glyphs = NULL;
+	ui_font->masks = NULL;
+	ui_font_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
+	ui_font_bmp->pixels = NULL;
+	
 	ui_asset_reader = fopen(ui_font_name, "rb");
-	if (ui_asset_reader == NULL){
+	if (ui_asset_reader != NULL){
+		// Packed font; the glyphs are read in one go, with no bitmap decoding
+		status = bmp_ReadPackedFont(ui_asset_reader, ui_font_bmp, ui_font, 1, 0, 0);
+		if (status == 0){
+			status = bmp_ReadPackedFont(ui_asset_reader, ui_font_bmp, ui_font, 0, 1, 0);
+		}
+		if (status == 0){
+			pal_BMP2Palette(ui_font_bmp, 1);
+			status = bmp_ReadPackedFont(ui_asset_reader, ui_font_bmp, ui_font, 0, 0, 1);
+		}
+	} else {
+		// Fall back to decoding the font bitmap
 		if (UI_VERBOSE){
-				printf("%s.%d\t Error loading UI font data\n", __FILE__, __LINE__);
+				printf("%s.%d\t No packed font, loading %s\n", __FILE__, __LINE__, ui_font_bmp_name);
+		}
+		ui_asset_reader = fopen(ui_font_bmp_name, "rb");
+		if (ui_asset_reader == NULL){
+			if (UI_VERBOSE){
+					printf("%s.%d\t Error loading UI font data\n", __FILE__, __LINE__);
+			}
+			free(ui_font);
+			free(ui_font_bmp);
+			return UI_ERR_FILE;     
 		}
-		return UI_ERR_FILE;     
+		status = bmp_ReadFont(ui_asset_reader, ui_font_bmp, ui_font, 1, 0, 0, ui_font_width, ui_font_height);
+		status = bmp_ReadFont(ui_asset_reader, ui_font_bmp, ui_font, 0, 1, 0, ui_font_width, ui_font_height);
+		pal_BMP2Palette(ui_font_bmp, 1);
+		status = bmp_ReadFont(ui_asset_reader, ui_font_bmp, ui_font, 0, 0, 1, ui_font_width, ui_font_height);
 	}
 	
-	ui_font = (fontdata_t *) malloc(sizeof(fontdata_t));
-	ui_font_bmp = (bmpdata_t *) malloc(sizeof(bmpdata_t));
-	ui_font_bmp->pixels = NULL;
-	status = bmp_ReadFont(ui_asset_reader, ui_font_bmp, ui_font, 1, 0, 0, ui_font_width, ui_font_height);
-	status = bmp_ReadFont(ui_asset_reader, ui_font_bmp, ui_font, 0, 1, 0, ui_font_width, ui_font_height);
-	pal_BMP2Palette(ui_font_bmp, 1);
-	status = bmp_ReadFont(ui_asset_reader, ui_font_bmp, ui_font, 0, 0, 1, ui_font_width, ui_font_height);
-	
 	if (status != 0){
 		if (UI_VERBOSE){
 				printf("%s.%d\t Error processing UI font data\n", __FILE__, __LINE__);
@@ -781,7 +1136,7 @@ int ui_LoadFonts(){
 int ui_ProgressMessage(char *c){
 	int x;
 	
-	x = (GFX_COLS / 2) - ((ui_font->width * strlen(c)) / 2);
+	x = (GFX_COLS / 2) - (gfx_TextWidth(ui_font, c) / 2);
 
 	// Mask out anything that was on this line before
 	gfx_BoxFill(0, ui_progress_font_y_pos - 1, GFX_COLS, ui_progress_font_y_pos + ui_font->height, PALETTE_UI_BLACK);
@@ -790,6 +1145,59 @@ int ui_ProgressMessage(char *c){
 	return gfx_Puts(x, ui_progress_font_y_pos, ui_font, c);
 }
 
+static int ui_BrowserStart(state_t *state){
+	// Index in selected_list of the first line shown in the browser pane
+	
+	int startpos;
+	
+	if (state->browser_scroll){
+		return state->selected_top;
+	}
+	
+	// Don't allow startpos to go negative
+	startpos = (state->selected_page - 1) * ui_browser_max_lines;
+	if (startpos < 0){
+		startpos = 0;	
+	}
+	return startpos;
+}
+
+void ui_BrowserScroll(state_t *state, int lines){
+	// Move the selection up (lines < 0) or down the selected list, in line 
+	// scrolling mode. The list scrolls just enough to keep the selection
+	// onscreen, and wraps around when moving past either end.
+	
+	int pos;
+	int top;
+	
+	if (state->selected_max == 0){
+		return;
+	}
+	pos = state->selected_top + state->selected_line;
+	top = state->selected_top;
+	
+	if ((pos + lines) < 0){
+		// Past the first game; wrap to the last, unless we are not at the first yet
+		pos = (pos == 0) ? (state->selected_max - 1) : 0;
+	} else if ((pos + lines) >= (int) state->selected_max){
+		// Past the last game; wrap to the first, unless we are not at the last yet
+		pos = (pos == (state->selected_max - 1)) ? 0 : (state->selected_max - 1);
+	} else {
+		pos += lines;
+	}
+	
+	if (pos < top){
+		top = pos;
+	}
+	if (pos >= (top + ui_browser_max_lines)){
+		top = pos - ui_browser_max_lines + 1;
+	}
+	
+	state->selected_top = top;
+	state->selected_line = pos - top;
+	state->selected_page = (top / ui_browser_max_lines) + 1;
+}
+
 int	ui_ReselectCurrentGame(state_t *state){
 	// Simply updates the selected_gameid with whatever line / page is currently selected
 	// Should be called every time up/down/pageup/pagedown is detected whilst in browser pane
@@ -800,11 +1208,7 @@ int	ui_ReselectCurrentGame(state_t *state){
 	int	selected;	// Counter to match the selected_line number
 	int	gameid;		// ID of the current game we are iterating through in the selected_list
 	
-	// Don't allow startpos to go negative
-	startpos = (state->selected_page - 1) * ui_browser_max_lines;
-	if (startpos < 0){
-		startpos = 0;	
-	}
+	startpos = ui_BrowserStart(state);
 	
 	// If we're on the last page, then make sure we only loop over the number of entries
 	// that are on this page... not just all 22
@@ -845,6 +1249,211 @@ int ui_StatusMessage(char *c){
 	return gfx_Puts(0, 380, ui_font, c);
 }
 
+void ui_TitleCacheFlush(){
+	// Free all rendered titles
+	
+	int i;
+	
+	for (i = 0; i < ui_title_cache_entries; i++){
+		if (ui_title_cache[i].pixels != NULL){
+			free(ui_title_cache[i].pixels);
+			ui_title_cache[i].pixels = NULL;
+		}
+		ui_title_cache[i].gameid = -1;
+	}
+	ui_title_cache_bytes = 0;
+	if (UI_VERBOSE){
+		printf("%s.%d\t Title cache: %d hits, %d misses\n", __FILE__, __LINE__, ui_title_cache_hits, ui_title_cache_misses);
+	}
+}
+
+void ui_TitleCacheStats(unsigned int *hits, unsigned int *misses){
+	// Titles drawn from the cache, and those that had to be rendered, since startup
+	
+	*hits = ui_title_cache_hits;
+	*misses = ui_title_cache_misses;
+}
+
+static titlestrip_t *ui_TitleCacheGet(int gameid, fontdata_t *font, unsigned int size){
+	// Find the cached title of a game, or if there is none, make room for
+	// a new one of size bytes, evicting the least recently used titles.
+	// The pixels of a new entry are NULL until it is filled in.
+	
+	int i;
+	titlestrip_t *entry;
+	titlestrip_t *oldest;
+	
+	ui_title_cache_clock++;
+	for (i = 0; i < ui_title_cache_entries; i++){
+		entry = &ui_title_cache[i];
+		if ((entry->pixels != NULL) && (entry->gameid == gameid) && (entry->font == font)){
+			entry->last_used = ui_title_cache_clock;
+			ui_title_cache_hits++;
+			return entry;
+		}
+	}
+	ui_title_cache_misses++;
+	
+	if (size > ui_title_cache_size){
+		return NULL;
+	}
+	
+	// Evict until there is a free entry and enough bytes of the budget for this title
+	for (;;){
+		entry = NULL;
+		oldest = NULL;
+		for (i = 0; i < ui_title_cache_entries; i++){
+			if (ui_title_cache[i].pixels == NULL){
+				entry = &ui_title_cache[i];
+			} else if ((oldest == NULL) || (ui_title_cache[i].last_used < oldest->last_used)){
+				oldest = &ui_title_cache[i];
+			}
+		}
+		if ((entry != NULL) && ((ui_title_cache_bytes + size) <= ui_title_cache_size)){
+			break;
+		}
+		ui_title_cache_bytes -= oldest->width * oldest->height;
+		free(oldest->pixels);
+		oldest->pixels = NULL;
+		oldest->gameid = -1;
+	}
+	entry->gameid = gameid;
+	entry->font = font;
+	entry->last_used = ui_title_cache_clock;
+	return entry;
+}
+
+static void ui_DrawTitle(int x, int y, gamedata_t *game){
+	// Draw the title of a game in the browser pane, from the cache if it 
+	// has been rendered before, otherwise rendering it and keeping a copy
+	
+	textstyle_t		style;
+	titlestrip_t	*entry;
+	int			width;
+	
+	gfx_TextStyleInit(&style);
+	style.clip_x2 = ui_browser_panel_x_pos + ui_list_bmp->width - ui_browser_right_margin;
+	
+	width = gfx_TextWidth(ui_font, game->name);
+	if (width > (style.clip_x2 - x + 1)){
+		width = style.clip_x2 - x + 1;
+	}
+	if (width <= 0){
+		return;
+	}
+	
+	entry = ui_TitleCacheGet(game->gameid, ui_font, width * ui_font->height);
+	if ((entry != NULL) && (entry->pixels != NULL)){
+		gfx_RestoreRect(x, y, entry->width, entry->height, entry->pixels);
+		return;
+	}
+	
+	gfx_PutsStyle(x, y, ui_font, &style, game->name);
+	if (entry != NULL){
+		entry->pixels = (unsigned char *) malloc(width * ui_font->height);
+		if (entry->pixels == NULL){
+			entry->gameid = -1;
+			return;
+		}
+		entry->width = width;
+		entry->height = ui_font->height;
+		ui_title_cache_bytes += width * ui_font->height;
+		gfx_SaveRect(x, y, entry->width, entry->height, entry->pixels);
+	}
+}
+
+static int ui_HighlightInit(){
+	// Claim a palette entry for the cursor of each line of the browser pane, 
+	// all set to the colour of the list box behind the cursor, for now.
+	// Those left over in the reserved region are used first, then the free
+	// region, at the cost of a few artwork colours.
+	// Returns 0 if there were enough entries, otherwise the moving cursor is used.
+	
+	int i;
+	int count[PALETTES_TOTAL];
+	unsigned int pos;
+	unsigned char key;
+	bmpdata_t *select_bmp;
+	bmpdata_t *list_bmp;
+	
+	if (ui_highlight_status != 0){
+		return (ui_highlight_status > 0) ? 0 : -1;
+	}
+	
+	// The cursors are drawn solid from the sprite; without one only 
+	// the moving cursor can be drawn, from the bitmap
+	if (ui_SelectSprite() == NULL){
+		ui_highlight_status = -1;
+		return -1;
+	}
+	
+	// Both colours are taken from the pixels of the bitmaps, under
+	// the first cursor for the list box; without them, there is nothing
+	// to set the entries to
+	select_bmp = ui_AssetUse(ui_select_bmp);
+	list_bmp = ui_AssetUse(ui_list_bmp);
+	pos = ((ui_browser_font_y_pos - ui_browser_panel_y_pos) * list_bmp->width) + (ui_browser_cursor_xpos - ui_browser_panel_x_pos);
+	if ((select_bmp->pixels == NULL) || (select_bmp->size == 0) || (list_bmp->pixels == NULL) || (pos >= list_bmp->size)){
+		if (UI_VERBOSE){
+			printf("%s.%d\t No cursor or list box pixels to take colours from, highlight disabled\n", __FILE__, __LINE__);
+		}
+		ui_highlight_status = -1;
+		return -1;
+	}
+	
+	for (i = 0; i < ui_browser_max_lines; i++){
+		ui_highlight_entry[i] = pal_Claim(PALETTES_FREE, PALETTES_RESERVED);
+		if (ui_highlight_entry[i] < 0){
+			ui_highlight_entry[i] = pal_Claim(0, PALETTES_FREE);
+		}
+		if (ui_highlight_entry[i] < 0){
+			if (UI_VERBOSE){
+				printf("%s.%d\t Only %d unused palette entries, highlight disabled\n", __FILE__, __LINE__, i);
+			}
+			// Give back those already taken, so that images can still use them
+			while (i > 0){
+				i--;
+				pal_Unclaim(ui_highlight_entry[i]);
+			}
+			ui_highlight_status = -1;
+			return -1;
+		}
+	}
+	
+	// Artwork is reduced to the free region entries that are left
+	bmp_SetMaxColours(PALETTES_FREE - pal_Claimed(0, PALETTES_FREE));
+	
+	// The cursor colour is the most common colour of the cursor bitmap
+	memset(count, 0, sizeof(count));
+	key = select_bmp->pixels[0];
+	for (i = 0; i < select_bmp->size; i++){
+		if (select_bmp->pixels[i] != key){
+			count[select_bmp->pixels[i]]++;
+		}
+	}
+	key = 0;
+	for (i = 0; i < PALETTES_TOTAL; i++){
+		if (count[i] > count[key]){
+			key = i;
+		}
+	}
+	pal_Get(key, &ui_highlight_on[0], &ui_highlight_on[1], &ui_highlight_on[2]);
+	
+	// ... and the background is whatever the list box has under the first cursor
+	key = list_bmp->pixels[pos];
+	pal_Get(key, &ui_highlight_off[0], &ui_highlight_off[1], &ui_highlight_off[2]);
+	
+	for (i = 0; i < ui_browser_max_lines; i++){
+		pal_Set(ui_highlight_entry[i], ui_highlight_off[0], ui_highlight_off[1], ui_highlight_off[2]);
+	}
+	ui_highlight_line = -1;
+	ui_highlight_status = 1;
+	if (UI_VERBOSE){
+		printf("%s.%d\t Highlight using palette entries %d to %d\n", __FILE__, __LINE__, ui_highlight_entry[0], ui_highlight_entry[ui_browser_max_lines - 1]);
+	}
+	return 0;
+}
+
 int ui_UpdateBrowserPane(state_t *state, gamedata_t *gamedata){
 	// UPdate the contents of the game browser pane
 
@@ -858,15 +1467,15 @@ int ui_UpdateBrowserPane(state_t *state, gamedata_t *gamedata){
 	int			y;				// Vertical position offset for each row
 	int 			i;				// Loop counter
 	int 			gameid;			// ID of each game in selected_list
-	char		msg[64];		// Message buffer for each row
 	int			startpos;			// Index of first displayable element of state->selected_items
 	int			endpos;			// Index to last displayable element of state->selected_items
+	unsigned int	hits;			// Cache hits before this update
+	uclock_t		start_time;
+	int			row_height;		// Height of each line, including the gap below it
+	int			x2;				// Right hand edge of the titles
+	bmpdata_t	*list_bmp;		// List box, to clear a line with if there is no background layer
 	
-	// Don't allow startpos to go negative
-	startpos = (state->selected_page - 1) * ui_browser_max_lines;
-	if (startpos < 0){
-		startpos = 0;	
-	}
+	startpos = ui_BrowserStart(state);
 	
 	// If we're on the last page, then make sure we only draw the number of lines
 	// that are on this page... not just all 22
@@ -876,8 +1485,64 @@ int ui_UpdateBrowserPane(state_t *state, gamedata_t *gamedata){
 		endpos = startpos + ui_browser_max_lines;
 	}
 	
+	// The same page is already onscreen; only the cursor moves, 
+	// and that is drawn by ui_UpdateBrowserPaneStatus()
+	if ((startpos == ui_browser_drawn_start) && (endpos == ui_browser_drawn_end)){
+		return UI_OK;
+	}
+	start_time = uclock();
+	hits = ui_title_cache_hits;
+	
+	// Scrolled by one line from a full page that is already onscreen; move 
+	// the lines that are still shown and only draw the one that is new.
+	// The list box background is plain behind the titles, so it can move with them.
+	if ((ui_browser_drawn_start >= 0) && (abs(startpos - ui_browser_drawn_start) == 1) && ((endpos - startpos) == ui_browser_max_lines) && ((ui_browser_drawn_end - ui_browser_drawn_start) == ui_browser_max_lines)){
+		row_height = ui_font->height + 2;
+		x2 = ui_browser_panel_x_pos + ui_list_bmp->width - ui_browser_right_margin;
+		if (startpos > ui_browser_drawn_start){
+			gfx_ScrollRect(ui_browser_font_x_pos, ui_browser_font_y_pos, x2, ui_browser_font_y_pos + (ui_browser_max_lines * row_height) - 1, -row_height);
+			i = endpos - 1;
+			y = ui_browser_font_y_pos + ((ui_browser_max_lines - 1) * row_height);
+		} else {
+			gfx_ScrollRect(ui_browser_font_x_pos, ui_browser_font_y_pos, x2, ui_browser_font_y_pos + (ui_browser_max_lines * row_height) - 1, row_height);
+			i = startpos;
+			y = ui_browser_font_y_pos;
+		}
+		ui_browser_drawn_start = startpos;
+		ui_browser_drawn_end = endpos;
+		
+		// Clear the old text from the uncovered line, then draw the new title
+		if (gfx_BackgroundRestore(ui_browser_font_x_pos, y, x2, y + row_height - 1) != 0){
+			list_bmp = ui_AssetUse(ui_list_bmp);
+			if (list_bmp->pixels != NULL){
+				gfx_BitmapPart(ui_browser_font_x_pos, y, list_bmp, ui_browser_font_x_pos - ui_browser_panel_x_pos, y - ui_browser_panel_y_pos, x2 - ui_browser_font_x_pos + 1, row_height);
+			} else {
+				gfx_BoxFill(ui_browser_font_x_pos, y, x2, y + row_height - 1, PALETTE_UI_BLACK);
+			}
+		}
+		selected_game = getGameid(state->selected_list[i], gamedata);
+		ui_DrawTitle(ui_browser_font_x_pos, y, selected_game);
+		
+		if (UI_VERBOSE){
+			printf("%s.%d\t Browser pane scrolled in %ldus, %d/1 titles from cache\n", __FILE__, __LINE__, 
+				(long) (((uclock() - start_time) * 1000000) / UCLOCKS_PER_SEC), ui_title_cache_hits - hits);
+		}
+		return UI_OK;
+	}
+	ui_browser_drawn_start = startpos;
+	ui_browser_drawn_end = endpos;
+	
 	// Clear all lines
-	gfx_Bitmap(ui_browser_panel_x_pos, ui_browser_panel_y_pos, ui_list_bmp);
+	ui_ClearBox(ui_browser_panel_x_pos, ui_browser_panel_y_pos, ui_list_bmp);
+	
+	// Cursors for every line, in their own palette entries; the selection is 
+	// then moved by ui_UpdateBrowserPaneStatus() without drawing anything
+	// ui_HighlightInit() only succeeds once the sprite has been made
+	if (state->browser_highlight && (ui_HighlightInit() == 0)){
+		for (i = 0; i < (endpos - startpos); i++){
+			gfx_SpriteSolid(ui_browser_cursor_xpos, ui_browser_font_y_pos + ((ui_font->height + 2) * i), ui_SelectSprite(), ui_highlight_entry[i]);
+		}
+	}
 	
 	// Display the entries for this page
 	gamedata_head = gamedata;
@@ -892,12 +1557,17 @@ int ui_UpdateBrowserPane(state_t *state, gamedata_t *gamedata){
 		if (UI_VERBOSE){
 			printf("%s.%d\t - Line %d: Game ID %d, %s\n", __FILE__, __LINE__, i, gameid, selected_game->name);
 		}
-		sprintf(msg, "%s", selected_game->name);
-		gfx_Puts(ui_browser_font_x_pos, y, ui_font, msg);
+		ui_DrawTitle(ui_browser_font_x_pos, y, selected_game);
 		y += ui_font->height + 2;
 	}
 	gamedata = gamedata_head;
 	
+	if (UI_VERBOSE && (endpos > startpos)){
+		printf("%s.%d\t Browser pane drawn in %ldus, %d/%d titles from cache (%d%% overall)\n", __FILE__, __LINE__, 
+			(long) (((uclock() - start_time) * 1000000) / UCLOCKS_PER_SEC), 
+			ui_title_cache_hits - hits, endpos - startpos,
+			(100 * ui_title_cache_hits) / (ui_title_cache_hits + ui_title_cache_misses));
+	}
 	return UI_OK;
 }
 
@@ -905,19 +1575,56 @@ int ui_UpdateBrowserPaneStatus(state_t *state){
 	// Draw browser pane status message in status panel
 	char	msg[64];		// Message buffer for the status bar
 	int y_pos;
-	// Blank out any previous selection cursor
-	gfx_BoxFill(ui_browser_cursor_xpos, ui_browser_font_y_pos, ui_browser_cursor_xpos + ui_select_bmp->width, ui_browser_footer_font_ypos, PALETTE_UI_BLACK);
+	int width, height;		// Size of the selection cursor
+	spritedata_t *sprite;
+	bmpdata_t *select_bmp;
 
-	// Insert selection cursor
-	if (state->selected_line == 0){
-		y_pos = 0;
+	if (state->browser_highlight && (ui_HighlightInit() == 0)){
+		// The cursors are already drawn on every line, so 
+		// only the entries of the old and new lines change
+		if (ui_highlight_line != (int) state->selected_line){
+			if (ui_highlight_line >= 0){
+				pal_Set(ui_highlight_entry[ui_highlight_line], ui_highlight_off[0], ui_highlight_off[1], ui_highlight_off[2]);
+			}
+			ui_highlight_line = state->selected_line;
+			pal_Set(ui_highlight_entry[ui_highlight_line], ui_highlight_on[0], ui_highlight_on[1], ui_highlight_on[2]);
+		}
 	} else {
-		y_pos = (ui_font->height + 2 ) * (state->selected_line);
-	}
-	if (UI_VERBOSE){
-		printf("%s.%d\t Drawing selection icon at line %d, x:%d y:%d\n", __FILE__, __LINE__, state->selected_line, ui_browser_cursor_xpos, (ui_browser_font_y_pos + y_pos));
+		// Insert selection cursor
+		if (state->selected_line == 0){
+			y_pos = 0;
+		} else {
+			y_pos = (ui_font->height + 2 ) * (state->selected_line);
+		}
+		
+		// The sprite, or failing that the cursor bitmap itself, keyed
+		sprite = ui_SelectSprite();
+		select_bmp = NULL;
+		if (sprite != NULL){
+			width = sprite->width;
+			height = sprite->height;
+		} else {
+			select_bmp = ui_AssetUse(ui_select_bmp);
+			width = select_bmp->width;
+			height = select_bmp->height;
+		}
+		
+		// Blank out the previous selection cursor, if it has moved
+		if ((ui_select_sprite_ypos >= 0) && (ui_select_sprite_ypos != (ui_browser_font_y_pos + y_pos)) && (width > 0) && (height > 0)){
+			if (gfx_BackgroundRestore(ui_browser_cursor_xpos, ui_select_sprite_ypos, ui_browser_cursor_xpos + width - 1, ui_select_sprite_ypos + height - 1) != 0){
+				gfx_BoxFill(ui_browser_cursor_xpos, ui_select_sprite_ypos, ui_browser_cursor_xpos + width - 1, ui_select_sprite_ypos + height - 1, PALETTE_UI_BLACK);
+			}
+		}
+		ui_select_sprite_ypos = ui_browser_font_y_pos + y_pos;
+		if (UI_VERBOSE){
+			printf("%s.%d\t Drawing selection icon at line %d, x:%d y:%d\n", __FILE__, __LINE__, state->selected_line, ui_browser_cursor_xpos, (ui_browser_font_y_pos + y_pos));
+		}
+		if (sprite != NULL){
+			gfx_Sprite(ui_browser_cursor_xpos, ui_browser_font_y_pos + y_pos, sprite);
+		} else if (select_bmp->pixels != NULL){
+			gfx_BitmapKeyed(ui_browser_cursor_xpos, ui_browser_font_y_pos + y_pos, select_bmp, select_bmp->pixels[0]);
+		}
 	}
-	gfx_Bitmap(ui_browser_cursor_xpos, ui_browser_font_y_pos + y_pos, ui_select_bmp);
 	
 	// Text at bottom of browser pane
 	sprintf(msg, "Line %02d/%02d             Page %02d/%02d", state->selected_line, ui_browser_max_lines, state->selected_page, state->total_pages);
@@ -926,6 +1633,20 @@ int ui_UpdateBrowserPaneStatus(state_t *state){
 	return UI_OK;
 }
 
+static int ui_PutsInBox(int x, int y, int box_x, int box_y, bmpdata_t *box, char *c){
+	// Print text inside one of the info pane text boxes, clipped 
+	// so that long text does not run past the edge of the box
+	
+	textstyle_t style;
+	
+	gfx_TextStyleInit(&style);
+	style.clip_x1 = box_x;
+	style.clip_y1 = box_y;
+	style.clip_x2 = box_x + box->width - 2;
+	style.clip_y2 = box_y + box->height - 1;
+	return gfx_PutsStyle(x, y, ui_font, &style, c);
+}
+
 int ui_UpdateInfoPane(state_t *state, gamedata_t *gamedata, launchdat_t *launchdat){
 	// Draw the contents of the info panel with current selected game, current filter mode, etc
 	
@@ -951,22 +1672,22 @@ int ui_UpdateInfoPane(state_t *state, gamedata_t *gamedata, launchdat_t *launchd
 	
 	// Clear all existing text
 	// title
-	gfx_Bitmap(ui_info_name_xpos, ui_info_name_ypos, ui_title_bmp);
+	ui_ClearBox(ui_info_name_xpos, ui_info_name_ypos, ui_title_bmp);
 	// company
-	gfx_Bitmap(ui_info_company_xpos, ui_info_company_ypos, ui_company_bmp);
+	ui_ClearBox(ui_info_company_xpos, ui_info_company_ypos, ui_company_bmp);
 	// path
-	gfx_Bitmap(ui_info_path_xpos, ui_info_path_ypos, ui_path_bmp);
+	ui_ClearBox(ui_info_path_xpos, ui_info_path_ypos, ui_path_bmp);
 	// year
-	gfx_Bitmap(ui_info_year_xpos, ui_info_year_ypos, ui_year_bmp);
+	ui_ClearBox(ui_info_year_xpos, ui_info_year_ypos, ui_year_bmp);
 	// genre
-	gfx_Bitmap(ui_info_genre_xpos, ui_info_genre_ypos, ui_genre_bmp);
+	ui_ClearBox(ui_info_genre_xpos, ui_info_genre_ypos, ui_genre_bmp);
 	// series
-	gfx_Bitmap(ui_info_series_xpos, ui_info_series_ypos, ui_series_bmp);
+	ui_ClearBox(ui_info_series_xpos, ui_info_series_ypos, ui_series_bmp);
 	
 	if (state->selected_filter != 0){
-		gfx_Bitmap(ui_checkbox_filter_active_xpos, ui_checkbox_filter_active_ypos, ui_checkbox_bmp);
+		ui_DrawAsset(ui_checkbox_filter_active_xpos, ui_checkbox_filter_active_ypos, ui_checkbox_bmp);
 	} else {
-		gfx_Bitmap(ui_checkbox_filter_active_xpos, ui_checkbox_filter_active_ypos, ui_checkbox_empty_bmp);	
+		ui_ClearBox(ui_checkbox_filter_active_xpos, ui_checkbox_filter_active_ypos, ui_checkbox_empty_bmp);	
 	}
 	
 	if (UI_VERBOSE){
@@ -987,11 +1708,11 @@ int ui_UpdateInfoPane(state_t *state, gamedata_t *gamedata, launchdat_t *launchd
 				// Unable to load launch.dat	 from disk
 				// ======================
 				sprintf(status_msg, "ERROR: Unable to load metadata file: %s\%s", state->selected_game->path, GAMEDAT);
-				gfx_Bitmap(ui_checkbox_has_metadata_xpos, ui_checkbox_has_metadata_ypos, ui_checkbox_bmp);
-				gfx_Bitmap(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_empty_bmp);
-				gfx_Bitmap(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_empty_bmp);
-				gfx_Bitmap(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_empty_bmp);
-				gfx_Bitmap(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_empty_bmp);
+				ui_DrawAsset(ui_checkbox_has_metadata_xpos, ui_checkbox_has_metadata_ypos, ui_checkbox_bmp);
+				ui_ClearBox(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_empty_bmp);
+				ui_ClearBox(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_empty_bmp);
+				ui_ClearBox(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_empty_bmp);
+				ui_ClearBox(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_empty_bmp);
 				sprintf(info_name, " %s", state->selected_game->name);
 				sprintf(info_year, "N/A");
 				sprintf(info_company, " N/A");
@@ -1012,30 +1733,30 @@ int ui_UpdateInfoPane(state_t *state, gamedata_t *gamedata, launchdat_t *launchd
 					printf("%s.%d\t Info - midi serial: [%s]\n", __FILE__, __LINE__, launchdat->midi_serial);
 				}
 				
-				gfx_Bitmap(ui_checkbox_has_metadata_xpos, ui_checkbox_has_metadata_ypos, ui_checkbox_bmp);
+				ui_DrawAsset(ui_checkbox_has_metadata_xpos, ui_checkbox_has_metadata_ypos, ui_checkbox_bmp);
 				
 				if (state->has_images == 1){
-					gfx_Bitmap(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_bmp);
+					ui_DrawAsset(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_bmp);
 				} else {
-					gfx_Bitmap(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_empty_bmp);	
+					ui_ClearBox(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_empty_bmp);	
 				}
 				
 				if (launchdat->midi == 1){
-					gfx_Bitmap(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_bmp);
+					ui_DrawAsset(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_bmp);
 				} else {
-					gfx_Bitmap(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_empty_bmp);
+					ui_ClearBox(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_empty_bmp);
 				}
 				
 				if (launchdat->midi_serial == 1){
-					gfx_Bitmap(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_bmp);
+					ui_DrawAsset(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_bmp);
 				} else {
-					gfx_Bitmap(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_empty_bmp);
+					ui_ClearBox(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_empty_bmp);
 				}
 				
 				if ((launchdat->start != NULL) && (strcmp(launchdat->start, "") != 0)){
-					gfx_Bitmap(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_bmp);
+					ui_DrawAsset(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_bmp);
 				} else {
-					gfx_Bitmap(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_empty_bmp);
+					ui_ClearBox(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_empty_bmp);
 				}
 				
 				if (launchdat->realname != NULL){
@@ -1097,11 +1818,11 @@ int ui_UpdateInfoPane(state_t *state, gamedata_t *gamedata, launchdat_t *launchd
 			// ======================
 			// We can only use the basic directory information
 			// ======================
-			gfx_Bitmap(ui_checkbox_has_metadata_xpos, ui_checkbox_has_metadata_ypos, ui_checkbox_empty_bmp);
-			gfx_Bitmap(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_empty_bmp);
-			gfx_Bitmap(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_empty_bmp);
-			gfx_Bitmap(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_empty_bmp);
-			gfx_Bitmap(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_empty_bmp);
+			ui_ClearBox(ui_checkbox_has_metadata_xpos, ui_checkbox_has_metadata_ypos, ui_checkbox_empty_bmp);
+			ui_ClearBox(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_empty_bmp);
+			ui_ClearBox(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_empty_bmp);
+			ui_ClearBox(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_empty_bmp);
+			ui_ClearBox(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_empty_bmp);
 				
 			sprintf(info_name, " %s", state->selected_game->name);
 			sprintf(info_year, "N/A");
@@ -1114,11 +1835,11 @@ int ui_UpdateInfoPane(state_t *state, gamedata_t *gamedata, launchdat_t *launchd
 		// ======================
 		// Error in logic, gameid is not set
 		// ======================
-		gfx_Bitmap(ui_checkbox_has_metadata_xpos, ui_checkbox_has_metadata_ypos, ui_checkbox_empty_bmp);
-		gfx_Bitmap(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_empty_bmp);
-		gfx_Bitmap(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_empty_bmp);
-		gfx_Bitmap(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_empty_bmp);
-		gfx_Bitmap(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_empty_bmp);
+		ui_ClearBox(ui_checkbox_has_metadata_xpos, ui_checkbox_has_metadata_ypos, ui_checkbox_empty_bmp);
+		ui_ClearBox(ui_checkbox_has_startbat_xpos, ui_checkbox_has_startbat_ypos, ui_checkbox_empty_bmp);
+		ui_ClearBox(ui_checkbox_has_images_xpos, ui_checkbox_has_images_ypos, ui_checkbox_empty_bmp);
+		ui_ClearBox(ui_checkbox_has_midi_xpos, ui_checkbox_has_midi_ypos, ui_checkbox_empty_bmp);
+		ui_ClearBox(ui_checkbox_has_midi_serial_xpos, ui_checkbox_has_midi_serial_ypos, ui_checkbox_empty_bmp);
 		sprintf(status_msg, "ERROR, unable to find gamedata object for ID %d", state->selected_gameid);
 		gfx_Puts(ui_info_name_text_xpos, ui_info_name_text_ypos, ui_font, status_msg);
 		gamedata = gamedata_head;
@@ -1128,12 +1849,12 @@ int ui_UpdateInfoPane(state_t *state, gamedata_t *gamedata, launchdat_t *launchd
 	// ===========================
 	// Now print out all data, regardless of source
 	// ===========================
-	gfx_Puts(ui_info_name_text_xpos, ui_info_name_text_ypos, ui_font, info_name);
-	gfx_Puts(ui_info_year_text_xpos, ui_info_year_text_ypos, ui_font, info_year);
-	gfx_Puts(ui_info_company_text_xpos, ui_info_company_text_ypos, ui_font, info_company);
-	gfx_Puts(ui_info_genre_text_xpos, ui_info_genre_text_ypos, ui_font, info_genre);
-	gfx_Puts(ui_info_series_text_xpos, ui_info_series_text_ypos, ui_font, info_series);
-	gfx_Puts(ui_info_path_text_xpos, ui_info_path_text_ypos, ui_font, info_path);
+	ui_PutsInBox(ui_info_name_text_xpos, ui_info_name_text_ypos, ui_info_name_xpos, ui_info_name_ypos, ui_title_bmp, info_name);
+	ui_PutsInBox(ui_info_year_text_xpos, ui_info_year_text_ypos, ui_info_year_xpos, ui_info_year_ypos, ui_year_bmp, info_year);
+	ui_PutsInBox(ui_info_company_text_xpos, ui_info_company_text_ypos, ui_info_company_xpos, ui_info_company_ypos, ui_company_bmp, info_company);
+	ui_PutsInBox(ui_info_genre_text_xpos, ui_info_genre_text_ypos, ui_info_genre_xpos, ui_info_genre_ypos, ui_genre_bmp, info_genre);
+	ui_PutsInBox(ui_info_series_text_xpos, ui_info_series_text_ypos, ui_info_series_xpos, ui_info_series_ypos, ui_series_bmp, info_series);
+	ui_PutsInBox(ui_info_path_text_xpos, ui_info_path_text_ypos, ui_info_path_xpos, ui_info_path_ypos, ui_path_bmp, info_path);
 	gamedata = gamedata_head;
 	return UI_OK;
 }
\ No newline at end of file
@@ -36,7 +36,8 @@
 #define splash_progress_chunk_size	((splash_progress_width - 4) / splash_progress_chunks)
 #define splash_progress_complete (splash_progress_width - 4)
 
-#define ui_font_name				"assets\\font8x16.bmp"
+#define ui_font_name				"assets\\font8x16.fnt" // Packed font, made from the bmp by tools/mkfont
+#define ui_font_bmp_name			"assets\\font8x16.bmp" // Used if the packed font is missing
 #define ui_font_width			8  // Font symbol width
 #define ui_font_height			16 // Font symbol height
 #define ui_font_ascii_start		32 // Font table starts at ascii ' '
@@ -48,6 +49,7 @@
 #define ui_progress_font_y_pos	(splash_progress_y_pos - (ui_font_height + 2))
 
 // Dark metal theme
+#define ui_theme					"assets\\light.thm" // All of the bitmaps below, packed by tools/mkthm
 #define ui_main					"assets\\light\\light.bmp"
 #define ui_list_box				"assets\\light\\box_list.bmp"
 #define ui_art_box				"assets\\light\\box_art.bmp"
@@ -165,6 +167,41 @@
 #define ui_browser_footer_font_xpos 20
 #define ui_browser_footer_font_ypos 280
 #define ui_browser_cursor_xpos 	15
+#define ui_browser_right_margin	4	// Titles stop this many pixels before the right edge of the list box
+
+// Cache of rendered game titles in the browser pane
+#define ui_title_cache_entries	64		// Most titles held at once
+#define ui_title_cache_size		131072	// Most bytes of rendered titles held at once
+
+typedef struct titlestrip {
+	int			gameid;		// Game the title belongs to; -1 if the entry is unused
+	fontdata_t		*font;		// Font it was rendered in
+	unsigned short	width;		// Size of the rendered title, in pixels
+	unsigned short	height;
+	unsigned int	last_used;	// For finding the least recently used entry
+	unsigned char	*pixels;		// width x height pixels
+} titlestrip_t;
+
+// Pixels covered by each open popup, so they can be put back when it closes
+#define ui_popup_max_depth		4		// Most popups open on top of each other
+
+typedef struct popupsave {
+	int			x;			// Covered area of the screen
+	int			y;
+	int			width;
+	int			height;
+	unsigned char	*pixels;		// width x height pixels saved from under the popup
+} popupsave_t;
+
+// One of the UI bitmaps registered by ui_LoadAssets(); the pixels 
+// of most are only read the first time they are drawn
+typedef struct uiasset {
+	char			*name;		// Name of the image in the theme archive
+	char			*path;		// Bitmap it is loaded from, if there is no theme archive
+	bmpdata_t		**bmp;		// Where the loaded bitmap is kept
+	unsigned char	startup;		// Read by ui_LoadAssets(), rather than on first use
+	unsigned char	background;	// Only drawn into the background layer; freed once it is saved
+} uiasset_t;
 
 // Return codes
 #define UI_OK					0
@@ -189,6 +226,10 @@
 // Functions
 void	ui_Init();
 void	ui_Close();
+void	ui_TitleCacheFlush();
+void	ui_TitleCacheStats(unsigned int *hits, unsigned int *misses);
+int		ui_PopupCloseAll();
+void	ui_PopupDiscardAll();
 
 // These draw the basic UI elements
 int		ui_DrawInfoBox();
@@ -201,9 +242,11 @@ int		ui_DrawSplashProgress();
 int		ui_DrawStatusBar();
 int		ui_DrawTextPanel(int x, int y, int width);
 int		ui_DisplayArtwork(FILE *screenshot_file, bmpdata_t *screenshot_bmp, state_t *state, imagefile_t *imagefile);
+void	ui_ClearArtwork();
 
 // Asset loaders
 int		ui_LoadAssets();
+void	ui_AssetStats();
 int		ui_LoadFonts();
 int		ui_LoadScreenshot(char *c);
 
@@ -214,6 +257,7 @@ int		ui_StatusMessage(char *c);
 // Change focus or selected state of UI elements
 int		ui_SwitchPane(state_t *state);
 int		ui_ReselectCurrentGame(state_t *state);
+void	ui_BrowserScroll(state_t *state, int lines);
 
 // These refresh contents within the various UI elements
 int		ui_UpdateBrowserPane(state_t *state, gamedata_t *gamedata);